@@ -0,0 +1,410 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Binary envelope encoding, for hops where both ends use libsoup-soap.
+ *
+ *   envelope := "SSB2" varint(n_names) name* node(Header) node(Body)
+ *   name     := varint(length) bytes
+ *   node     := 'G' key varint(n_children) node*
+ *             | 'V' key varint(length) bytes
+ *             | 'N' key
+ *   key      := varint(name_index) varint(namespace_index + 1 or 0)
+ *
+ * Every element name and namespace URI is stored once in the table and
+ * referenced by index, and values are raw bytes with no escaping.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#define BINARY_MAGIC "SSB2"
+#define BINARY_MAX_DEPTH 256
+
+typedef struct
+{
+	GByteArray *out;
+	GHashTable *names;
+	GPtrArray *name_list;
+} BinaryWriter;
+
+typedef struct
+{
+	const guchar *data;
+	const guchar *end;
+	SoupSoapStringPool *pool;
+	const gchar **names;
+	guint n_names;
+} BinaryReader;
+
+
+static void
+write_varint (GByteArray *out,
+              guint64 value)
+{
+	guint8 buffer[10];
+	guint length = 0;
+
+	do
+	{
+		buffer[length] = value & 0x7f;
+		value >>= 7;
+		if (value)
+			buffer[length] |= 0x80;
+		length++;
+	} while (value);
+
+	g_byte_array_append (out, buffer, length);
+}
+
+static void
+add_name (BinaryWriter *writer,
+          const gchar *name)
+{
+	if (!g_hash_table_contains (writer->names, name))
+	{
+		g_hash_table_insert (writer->names, (gpointer) name,
+		                     GUINT_TO_POINTER (writer->name_list->len));
+		g_ptr_array_add (writer->name_list, (gpointer) name);
+	}
+}
+
+static void
+collect_names (BinaryWriter *writer,
+               SoupSoapParam *param)
+{
+	const gchar *namespace_uri = soup_soap_param_get_namespace_uri (param);
+	GList *elements;
+
+	add_name (writer, soup_soap_param_get_name (param));
+	if (namespace_uri)
+		add_name (writer, namespace_uri);
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+		return;
+
+	for (elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		collect_names (writer, elements->data);
+}
+
+static void
+write_key (BinaryWriter *writer,
+           SoupSoapParam *param)
+{
+	const gchar *namespace_uri = soup_soap_param_get_namespace_uri (param);
+
+	write_varint (writer->out,
+	              GPOINTER_TO_UINT (g_hash_table_lookup (writer->names,
+	                                                     soup_soap_param_get_name (param))));
+	write_varint (writer->out,
+	              namespace_uri ?
+	              GPOINTER_TO_UINT (g_hash_table_lookup (writer->names,
+	                                                     namespace_uri)) + 1 :
+	              0);
+}
+
+static void
+write_node (BinaryWriter *writer,
+            SoupSoapParam *param)
+{
+	if (SOUP_SOAP_IS_PARAM_GROUP (param))
+	{
+		GList *elements =
+			_soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+
+		g_byte_array_append (writer->out, (const guint8 *) "G", 1);
+		write_key (writer, param);
+		write_varint (writer->out, g_list_length (elements));
+
+		for (; elements != NULL; elements = g_list_next (elements))
+			write_node (writer, elements->data);
+	}
+	else
+	{
+		const gchar *value = soup_soap_param_get_value (param);
+
+		if (value == NULL)
+		{
+			g_byte_array_append (writer->out, (const guint8 *) "N", 1);
+			write_key (writer, param);
+			return;
+		}
+
+		g_byte_array_append (writer->out, (const guint8 *) "V", 1);
+		write_key (writer, param);
+		write_varint (writer->out, strlen (value));
+		g_byte_array_append (writer->out, (const guint8 *) value, strlen (value));
+	}
+}
+
+GByteArray *
+_soup_soap_binary_encode (SoupSoapParamGroup *header,
+                          SoupSoapParamGroup *body)
+{
+	BinaryWriter writer;
+	guint i;
+
+	writer.out = g_byte_array_sized_new (1024);
+	writer.names = g_hash_table_new (g_str_hash, g_str_equal);
+	writer.name_list = g_ptr_array_new ();
+
+	collect_names (&writer, SOUP_SOAP_PARAM (header));
+	collect_names (&writer, SOUP_SOAP_PARAM (body));
+
+	g_byte_array_append (writer.out, (const guint8 *) BINARY_MAGIC,
+	                     strlen (BINARY_MAGIC));
+	write_varint (writer.out, writer.name_list->len);
+
+	for (i = 0; i < writer.name_list->len; i++)
+	{
+		const gchar *name = g_ptr_array_index (writer.name_list, i);
+
+		write_varint (writer.out, strlen (name));
+		g_byte_array_append (writer.out, (const guint8 *) name, strlen (name));
+	}
+
+	write_node (&writer, SOUP_SOAP_PARAM (header));
+	write_node (&writer, SOUP_SOAP_PARAM (body));
+
+	g_ptr_array_unref (writer.name_list);
+	g_hash_table_unref (writer.names);
+
+	return writer.out;
+}
+
+static gboolean
+read_varint (BinaryReader *reader,
+             guint64 *value)
+{
+	guint shift = 0;
+
+	*value = 0;
+
+	while (reader->data < reader->end && shift < 64)
+	{
+		guint8 byte = *reader->data++;
+
+		*value |= (guint64) (byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return TRUE;
+
+		shift += 7;
+	}
+
+	return FALSE;
+}
+
+static gboolean
+read_key (BinaryReader *reader,
+          const gchar **name,
+          const gchar **namespace_uri)
+{
+	guint64 index;
+
+	if (!read_varint (reader, &index) || index >= reader->n_names ||
+	    *reader->names[index] == '\0')
+		return FALSE;
+
+	*name = reader->names[index];
+
+	if (!read_varint (reader, &index) || index > reader->n_names)
+		return FALSE;
+
+	*namespace_uri = index && *reader->names[index - 1] ?
+		reader->names[index - 1] : NULL;
+
+	return TRUE;
+}
+
+/* Children are collected in reverse and reversed once, instead of being
+ * appended one at a time.
+ */
+static SoupSoapParam *
+read_node (BinaryReader *reader,
+           guint depth)
+{
+	const gchar *name, *namespace_uri;
+	SoupSoapParam *param;
+	guint64 count, length;
+	guint8 tag;
+
+	if (reader->data >= reader->end || depth > BINARY_MAX_DEPTH)
+		return NULL;
+
+	tag = *reader->data++;
+
+	if (!read_key (reader, &name, &namespace_uri))
+		return NULL;
+
+	switch (tag)
+	{
+		case 'G':
+		{
+			SoupSoapParamGroup *group;
+			GList *elements = NULL;
+
+			/* Every child takes at least three bytes */
+			if (!read_varint (reader, &count) ||
+			    count > (guint64) (reader->end - reader->data) / 3)
+				return NULL;
+
+			group = SOUP_SOAP_PARAM_GROUP (
+				_soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM_GROUP,
+				                             namespace_uri, name));
+
+			while (count-- > 0)
+			{
+				SoupSoapParam *child = read_node (reader, depth + 1);
+
+				if (child == NULL)
+				{
+					g_list_free_full (elements, g_object_unref);
+					g_object_unref (g_object_ref_sink (group));
+					return NULL;
+				}
+
+				elements = g_list_prepend (elements, g_object_ref_sink (child));
+			}
+
+			_soup_soap_param_group_set_elements (group, g_list_reverse (elements));
+
+			param = SOUP_SOAP_PARAM (group);
+			break;
+		}
+		case 'V':
+		{
+			gchar *value;
+
+			/* A NUL would cut the value short, so it is refused as well */
+			if (!read_varint (reader, &length) ||
+			    length > (guint64) (reader->end - reader->data) ||
+			    !g_utf8_validate ((const gchar *) reader->data, length, NULL))
+				return NULL;
+
+			value = g_strndup ((const gchar *) reader->data, length);
+			reader->data += length;
+
+			param = _soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM,
+			                                     namespace_uri, name);
+			soup_soap_param_set_value (param, value);
+			g_free (value);
+			break;
+		}
+		case 'N':
+			param = _soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM,
+			                                     namespace_uri, name);
+			break;
+		default:
+			return NULL;
+	}
+
+	return param;
+}
+
+static void
+take_group (SoupSoapParamGroup *target,
+            SoupSoapParam *source)
+{
+	_soup_soap_param_copy_name (SOUP_SOAP_PARAM (target), source);
+	_soup_soap_param_group_set_elements (target,
+	                                     _soup_soap_param_group_steal_elements (SOUP_SOAP_PARAM_GROUP (source)));
+}
+
+/* Decodes data into the existing header and body groups of a message */
+gboolean
+_soup_soap_binary_decode (const guchar *data,
+                          gsize length,
+                          SoupSoapParamGroup *header,
+                          SoupSoapParamGroup *body,
+                          GError **error)
+{
+	BinaryReader reader;
+	SoupSoapParam *header_node = NULL, *body_node = NULL;
+	gboolean success = FALSE;
+	guint64 n_names, name_length;
+	gchar *name;
+	guint i;
+
+	reader.data = data;
+	reader.end = data + length;
+	reader.pool = _soup_soap_string_pool_new ();
+	reader.names = NULL;
+	reader.n_names = 0;
+
+	if (length < strlen (BINARY_MAGIC) ||
+	    memcmp (data, BINARY_MAGIC, strlen (BINARY_MAGIC)) != 0)
+		goto out;
+
+	reader.data += strlen (BINARY_MAGIC);
+
+	if (!read_varint (&reader, &n_names) ||
+	    n_names > (guint64) (reader.end - reader.data))
+		goto out;
+
+	reader.names = g_new0 (const gchar *, n_names);
+
+	for (i = 0; i < n_names; i++)
+	{
+		if (!read_varint (&reader, &name_length) ||
+		    name_length > (guint64) (reader.end - reader.data) ||
+		    !g_utf8_validate ((const gchar *) reader.data, name_length, NULL))
+			goto out;
+
+		name = g_strndup ((const gchar *) reader.data, name_length);
+		reader.names[i] = _soup_soap_string_pool_add (reader.pool, name);
+		reader.n_names++;
+		g_free (name);
+		reader.data += name_length;
+	}
+
+	header_node = read_node (&reader, 0);
+	body_node = header_node ? read_node (&reader, 0) : NULL;
+
+	if (body_node == NULL ||
+	    !SOUP_SOAP_IS_PARAM_GROUP (header_node) ||
+	    !SOUP_SOAP_IS_PARAM_GROUP (body_node) ||
+	    reader.data != reader.end)
+		goto out;
+
+	take_group (header, header_node);
+	take_group (body, body_node);
+	success = TRUE;
+
+out:
+	if (header_node)
+		g_object_unref (g_object_ref_sink (header_node));
+	if (body_node)
+		g_object_unref (g_object_ref_sink (body_node));
+	g_free (reader.names);
+	_soup_soap_string_pool_free (reader.pool);
+
+	if (!success)
+		g_set_error_literal (error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+		                     _("Malformed binary SOAP envelope"));
+
+	return success;
+}
@@ -0,0 +1,324 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+typedef struct
+{
+	const SoupSoapBindingField *field;
+	SoupSoapBinding *nested;
+} SoupSoapBindingSlot;
+
+struct _SoupSoapBinding
+{
+	gint ref_count;
+
+	SoupSoapBindingSlot *slots;
+	guint n_slots;
+
+	/* Maps element names to slots */
+	GHashTable *index;
+};
+
+
+
+G_DEFINE_BOXED_TYPE (SoupSoapBinding, soup_soap_binding, soup_soap_binding_ref, soup_soap_binding_unref);
+
+/* Compiles a descriptor table once, so that each element of a group costs
+ * one hash lookup instead of a linear soup_soap_param_group_get().  The
+ * table and its names must outlive the binding; they are normally static.
+ */
+SoupSoapBinding *
+soup_soap_binding_new (const SoupSoapBindingField *fields)
+{
+	SoupSoapBinding *binding;
+	guint i;
+
+	g_return_val_if_fail (fields != NULL, NULL);
+
+	binding = g_slice_new0 (SoupSoapBinding);
+	binding->ref_count = 1;
+
+	while (fields[binding->n_slots].name)
+		binding->n_slots++;
+
+	binding->slots = g_new0 (SoupSoapBindingSlot, binding->n_slots);
+	binding->index = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (i = 0; i < binding->n_slots; i++)
+	{
+		SoupSoapBindingSlot *slot = &binding->slots[i];
+
+		slot->field = &fields[i];
+
+		if (slot->field->type == SOUP_SOAP_BINDING_GROUP)
+		{
+			g_warn_if_fail (slot->field->nested != NULL);
+			if (slot->field->nested)
+				slot->nested = soup_soap_binding_new (slot->field->nested);
+		}
+
+		g_hash_table_insert (binding->index,
+		                     (gpointer) slot->field->name, slot);
+	}
+
+	return binding;
+}
+
+SoupSoapBinding *
+soup_soap_binding_ref (SoupSoapBinding *binding)
+{
+	g_return_val_if_fail (binding != NULL, NULL);
+
+	g_atomic_int_inc (&binding->ref_count);
+
+	return binding;
+}
+
+void
+soup_soap_binding_unref (SoupSoapBinding *binding)
+{
+	guint i;
+
+	g_return_if_fail (binding != NULL);
+
+	if (!g_atomic_int_dec_and_test (&binding->ref_count))
+		return;
+
+	for (i = 0; i < binding->n_slots; i++)
+		if (binding->slots[i].nested)
+			soup_soap_binding_unref (binding->slots[i].nested);
+
+	g_hash_table_unref (binding->index);
+	g_free (binding->slots);
+	g_slice_free (SoupSoapBinding, binding);
+}
+
+static gboolean
+fill_slot (SoupSoapBindingSlot *slot,
+           SoupSoapParam *param,
+           gpointer data,
+           GError **error)
+{
+	gpointer member = G_STRUCT_MEMBER_P (data, slot->field->offset);
+	GError *param_error = NULL;
+
+	switch (slot->field->type)
+	{
+		case SOUP_SOAP_BINDING_STRING:
+			g_free (*(gchar **) member);
+			*(gchar **) member = g_strdup (soup_soap_param_get_value (param));
+			break;
+		case SOUP_SOAP_BINDING_BOOLEAN:
+			*(gboolean *) member = soup_soap_param_get_boolean (param, &param_error);
+			break;
+		case SOUP_SOAP_BINDING_INTEGER:
+			*(gint *) member = soup_soap_param_get_integer (param, &param_error);
+			break;
+		case SOUP_SOAP_BINDING_DOUBLE:
+			*(gdouble *) member = soup_soap_param_get_double (param, &param_error);
+			break;
+		case SOUP_SOAP_BINDING_BASE64_BINARY:
+		{
+			gsize length;
+			guchar *value = soup_soap_param_get_base64_binary (param, &length,
+			                                                    &param_error);
+
+			if (param_error)
+				break;
+
+			if (*(GBytes **) member)
+				g_bytes_unref (*(GBytes **) member);
+			*(GBytes **) member = g_bytes_new_take (value, length);
+			break;
+		}
+		case SOUP_SOAP_BINDING_GROUP:
+			if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+			{
+				g_set_error (error, SOUP_SOAP_PARAM_ERROR,
+				             SOUP_SOAP_PARAM_ERROR_INVALID_VALUE,
+				             _("Element '%s' is not a group."),
+				             slot->field->name);
+				return FALSE;
+			}
+
+			if (slot->nested == NULL)
+				break;
+
+			return soup_soap_binding_fill (slot->nested,
+			                               SOUP_SOAP_PARAM_GROUP (param),
+			                               member, error);
+	}
+
+	if (param_error)
+	{
+		g_propagate_prefixed_error (error, param_error, "%s: ", slot->field->name);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Fills the struct at data from the elements of group in one pass over
+ * them.  Elements without a descriptor are skipped; when an element is
+ * repeated, the last one wins.  On error the struct is left partially
+ * filled and should be released with soup_soap_binding_clear().
+ */
+gboolean
+soup_soap_binding_fill (SoupSoapBinding *binding,
+                        SoupSoapParamGroup *group,
+                        gpointer data,
+                        GError **error)
+{
+	GList *elements;
+
+	g_return_val_if_fail (binding != NULL, FALSE);
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	for (elements = _soup_soap_param_group_peek_elements (group);
+	     elements != NULL;
+	     elements = g_list_next (elements))
+	{
+		SoupSoapParam *param = elements->data;
+		SoupSoapBindingSlot *slot;
+
+		slot = g_hash_table_lookup (binding->index,
+		                            soup_soap_param_get_name (param));
+		if (slot == NULL)
+			continue;
+
+		if (!fill_slot (slot, param, data, error))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static SoupSoapParam *
+build_slot (SoupSoapBindingSlot *slot,
+            gconstpointer data)
+{
+	gconstpointer member = G_STRUCT_MEMBER_P (data, slot->field->offset);
+	const gchar *name = slot->field->name;
+
+	switch (slot->field->type)
+	{
+		case SOUP_SOAP_BINDING_STRING:
+			if (*(gchar * const *) member == NULL)
+				return NULL;
+			return soup_soap_param_new_string (name, *(gchar * const *) member);
+		case SOUP_SOAP_BINDING_BOOLEAN:
+			return soup_soap_param_new_boolean (name, *(const gboolean *) member);
+		case SOUP_SOAP_BINDING_INTEGER:
+			return soup_soap_param_new_integer (name, *(const gint *) member);
+		case SOUP_SOAP_BINDING_DOUBLE:
+			return soup_soap_param_new_double (name, *(const gdouble *) member);
+		case SOUP_SOAP_BINDING_BASE64_BINARY:
+		{
+			GBytes *bytes = *(GBytes * const *) member;
+			gconstpointer value;
+			gsize length;
+
+			if (bytes == NULL)
+				return NULL;
+
+			value = g_bytes_get_data (bytes, &length);
+			return soup_soap_param_new_base64_binary (name, value, length);
+		}
+		case SOUP_SOAP_BINDING_GROUP:
+			if (slot->nested == NULL)
+				return NULL;
+			return SOUP_SOAP_PARAM (soup_soap_binding_build (slot->nested, name,
+			                                                 member));
+	}
+
+	return NULL;
+}
+
+/* Builds a group named name from the struct at data, with one element
+ * per descriptor in table order.  NULL strings and binaries are omitted.
+ */
+SoupSoapParamGroup *
+soup_soap_binding_build (SoupSoapBinding *binding,
+                         const gchar *name,
+                         gconstpointer data)
+{
+	SoupSoapParamGroup *group;
+	guint i;
+
+	g_return_val_if_fail (binding != NULL, NULL);
+	g_return_val_if_fail (name != NULL && *name != '\0', NULL);
+	g_return_val_if_fail (data != NULL, NULL);
+
+	group = soup_soap_param_group_new (name);
+
+	for (i = 0; i < binding->n_slots; i++)
+	{
+		SoupSoapParam *param = build_slot (&binding->slots[i], data);
+
+		if (param)
+			soup_soap_param_group_add (group, param);
+	}
+
+	return group;
+}
+
+/* Frees the strings and binaries owned by the struct at data and resets
+ * them to NULL; the struct itself is left to the caller.
+ */
+void
+soup_soap_binding_clear (SoupSoapBinding *binding,
+                         gpointer data)
+{
+	guint i;
+
+	g_return_if_fail (binding != NULL);
+	g_return_if_fail (data != NULL);
+
+	for (i = 0; i < binding->n_slots; i++)
+	{
+		SoupSoapBindingSlot *slot = &binding->slots[i];
+		gpointer member = G_STRUCT_MEMBER_P (data, slot->field->offset);
+
+		switch (slot->field->type)
+		{
+			case SOUP_SOAP_BINDING_STRING:
+				g_free (*(gchar **) member);
+				*(gchar **) member = NULL;
+				break;
+			case SOUP_SOAP_BINDING_BASE64_BINARY:
+				if (*(GBytes **) member)
+					g_bytes_unref (*(GBytes **) member);
+				*(GBytes **) member = NULL;
+				break;
+			case SOUP_SOAP_BINDING_GROUP:
+				if (slot->nested)
+					soup_soap_binding_clear (slot->nested, member);
+				break;
+			default:
+				break;
+		}
+	}
+}
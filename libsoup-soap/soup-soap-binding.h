@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_BINDING_H_
+#define _SOUP_SOAP_BINDING_H_
+
+#include <glib-object.h>
+#include <libsoup-soap/soup-soap-param-group.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_BINDING  (soup_soap_binding_get_type ())
+
+typedef enum
+{
+	SOUP_SOAP_BINDING_STRING,        /* gchar *, owned by the struct */
+	SOUP_SOAP_BINDING_BOOLEAN,       /* gboolean */
+	SOUP_SOAP_BINDING_INTEGER,       /* gint */
+	SOUP_SOAP_BINDING_DOUBLE,        /* gdouble */
+	SOUP_SOAP_BINDING_BASE64_BINARY, /* GBytes *, owned by the struct */
+	SOUP_SOAP_BINDING_GROUP          /* struct embedded at offset, see nested */
+} SoupSoapBindingType;
+
+typedef struct _SoupSoapBindingField SoupSoapBindingField;
+typedef struct _SoupSoapBinding SoupSoapBinding;
+
+/* Descriptor tables end with an entry whose name is NULL */
+struct _SoupSoapBindingField
+{
+	const gchar *name;
+	SoupSoapBindingType type;
+	gsize offset;
+	const SoupSoapBindingField *nested;
+};
+
+#define SOUP_SOAP_BINDING_FIELD(name, type, struct_type, member) \
+	{ (name), (type), G_STRUCT_OFFSET (struct_type, member), NULL }
+#define SOUP_SOAP_BINDING_NESTED(name, struct_type, member, nested) \
+	{ (name), SOUP_SOAP_BINDING_GROUP, G_STRUCT_OFFSET (struct_type, member), (nested) }
+
+GType soup_soap_binding_get_type (void) G_GNUC_CONST;
+SoupSoapBinding *soup_soap_binding_new (const SoupSoapBindingField *fields);
+SoupSoapBinding *soup_soap_binding_ref (SoupSoapBinding *binding);
+void soup_soap_binding_unref (SoupSoapBinding *binding);
+gboolean soup_soap_binding_fill (SoupSoapBinding *binding, SoupSoapParamGroup *group, gpointer data, GError **error);
+SoupSoapParamGroup *soup_soap_binding_build (SoupSoapBinding *binding, const gchar *name, gconstpointer data);
+void soup_soap_binding_clear (SoupSoapBinding *binding, gpointer data);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_BINDING_H_ */
@@ -0,0 +1,400 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+struct _SoupSoapCachePrivate
+{
+	GMutex lock;
+	GHashTable *entries;
+	GHashTable *ttls;
+	GQueue lru;
+	gsize size;
+	gsize max_size;
+};
+
+#define SOUP_SOAP_CACHE_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_CACHE, SoupSoapCachePrivate))
+
+enum
+{
+	PROP_0,
+
+	PROP_MAX_SIZE
+};
+
+typedef struct
+{
+	GList link;
+	gchar *key;
+	SoupSoapFrozenMessage *response;
+	gsize size;
+	gint64 expires;
+} SoupSoapCacheEntry;
+
+
+/* The same request sent to two endpoints may well get two answers */
+static gchar *
+compute_key (SoupURI *uri,
+             SoupSoapMessage *request)
+{
+	gchar *uri_string = soup_uri_to_string (uri, FALSE);
+	gchar *digest = soup_soap_message_get_digest (request);
+	gchar *key = g_strconcat (digest, " ", uri_string, NULL);
+
+	g_free (digest);
+	g_free (uri_string);
+
+	return key;
+}
+
+static void
+entry_free (SoupSoapCacheEntry *entry)
+{
+	soup_soap_frozen_message_unref (entry->response);
+	g_free (entry->key);
+	g_slice_free (SoupSoapCacheEntry, entry);
+}
+
+/* Must be called with the lock held */
+static void
+remove_entry (SoupSoapCachePrivate *priv,
+              SoupSoapCacheEntry *entry)
+{
+	g_hash_table_remove (priv->entries, entry->key);
+	g_queue_unlink (&priv->lru, &entry->link);
+	priv->size -= entry->size;
+
+	entry_free (entry);
+}
+
+/* Must be called with the lock held */
+static void
+evict (SoupSoapCachePrivate *priv,
+       gsize max_size)
+{
+	while (priv->size > max_size && priv->lru.tail)
+		remove_entry (priv, priv->lru.tail->data);
+}
+
+
+G_DEFINE_TYPE (SoupSoapCache, soup_soap_cache, G_TYPE_OBJECT);
+
+static void
+soup_soap_cache_init (SoupSoapCache *object)
+{
+	object->priv = SOUP_SOAP_CACHE_GET_PRIVATE (object);
+	SoupSoapCachePrivate *priv = object->priv;
+
+	g_mutex_init (&priv->lock);
+	priv->entries = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->ttls = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                    g_free, NULL);
+	g_queue_init (&priv->lru);
+	priv->size = 0;
+	priv->max_size = 0;
+}
+
+static void
+soup_soap_cache_finalize (GObject *object)
+{
+	SoupSoapCache *cache = SOUP_SOAP_CACHE (object);
+	SoupSoapCachePrivate *priv = cache->priv;
+
+	evict (priv, 0);
+
+	g_hash_table_unref (priv->entries);
+	g_hash_table_unref (priv->ttls);
+	g_mutex_clear (&priv->lock);
+
+	G_OBJECT_CLASS (soup_soap_cache_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_cache_set_property (GObject *object,
+                              guint prop_id,
+                              const GValue *value,
+                              GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (object));
+
+	SoupSoapCache *cache = SOUP_SOAP_CACHE (object);
+
+	switch (prop_id)
+	{
+		case PROP_MAX_SIZE:
+			soup_soap_cache_set_max_size (cache,
+			                              g_value_get_uint64 (value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_cache_get_property (GObject *object,
+                              guint prop_id,
+                              GValue *value,
+                              GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (object));
+
+	SoupSoapCache *cache = SOUP_SOAP_CACHE (object);
+
+	switch (prop_id)
+	{
+		case PROP_MAX_SIZE:
+			g_value_set_uint64 (value,
+			                    soup_soap_cache_get_max_size (cache));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_cache_class_init (SoupSoapCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	/*GObjectClass *parent_class = G_OBJECT_CLASS (klass);*/
+
+	g_type_class_add_private (klass, sizeof (SoupSoapCachePrivate));
+
+	object_class->finalize = soup_soap_cache_finalize;
+	object_class->set_property = soup_soap_cache_set_property;
+	object_class->get_property = soup_soap_cache_get_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_MAX_SIZE,
+	                                 g_param_spec_uint64 ("max-size",
+	                                                      "Maximum size",
+	                                                      "The memory budget of the cache in bytes",
+	                                                      0, G_MAXSIZE, 0,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT));
+}
+
+
+SoupSoapCache *
+soup_soap_cache_new (gsize max_size)
+{
+	return g_object_new (SOUP_SOAP_TYPE_CACHE,
+	                     "max-size", (guint64) max_size,
+	                     NULL);
+}
+
+gsize
+soup_soap_cache_get_max_size (SoupSoapCache *cache)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CACHE (cache), 0);
+
+	return cache->priv->max_size;
+}
+
+void
+soup_soap_cache_set_max_size (SoupSoapCache *cache,
+                              gsize max_size)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (cache));
+
+	SoupSoapCachePrivate *priv = cache->priv;
+
+	g_mutex_lock (&priv->lock);
+	priv->max_size = max_size;
+	evict (priv, max_size);
+	g_mutex_unlock (&priv->lock);
+}
+
+gsize
+soup_soap_cache_get_size (SoupSoapCache *cache)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CACHE (cache), 0);
+
+	SoupSoapCachePrivate *priv = cache->priv;
+	gsize size;
+
+	g_mutex_lock (&priv->lock);
+	size = priv->size;
+	g_mutex_unlock (&priv->lock);
+
+	return size;
+}
+
+guint
+soup_soap_cache_get_ttl (SoupSoapCache *cache,
+                         const gchar *operation)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CACHE (cache), 0);
+	g_return_val_if_fail (operation != NULL, 0);
+
+	SoupSoapCachePrivate *priv = cache->priv;
+	guint ttl;
+
+	g_mutex_lock (&priv->lock);
+	ttl = GPOINTER_TO_UINT (g_hash_table_lookup (priv->ttls, operation));
+	g_mutex_unlock (&priv->lock);
+
+	return ttl;
+}
+
+void
+soup_soap_cache_set_ttl (SoupSoapCache *cache,
+                         const gchar *operation,
+                         guint ttl)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (cache));
+	g_return_if_fail (operation != NULL && *operation != '\0');
+
+	SoupSoapCachePrivate *priv = cache->priv;
+
+	/* Only operations given a TTL are cached, as only the caller knows
+	 * which operations are free of side effects.
+	 */
+	g_mutex_lock (&priv->lock);
+	if (ttl > 0)
+		g_hash_table_replace (priv->ttls, g_strdup (operation),
+		                      GUINT_TO_POINTER (ttl));
+	else
+		g_hash_table_remove (priv->ttls, operation);
+	g_mutex_unlock (&priv->lock);
+}
+
+/* Every hit gets a message of its own, with a copy of the cached tree */
+SoupSoapMessage *
+soup_soap_cache_lookup (SoupSoapCache *cache,
+                        SoupURI *uri,
+                        SoupSoapMessage *request)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CACHE (cache), NULL);
+	g_return_val_if_fail (uri != NULL, NULL);
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (request), NULL);
+
+	SoupSoapCachePrivate *priv = cache->priv;
+	SoupSoapCacheEntry *entry;
+	SoupSoapFrozenMessage *frozen = NULL;
+	SoupSoapMessage *response;
+	gchar *key;
+
+	if (soup_soap_cache_get_ttl (cache, soup_soap_message_get_operation_name (request)) == 0)
+		return NULL;
+
+	key = compute_key (uri, request);
+
+	g_mutex_lock (&priv->lock);
+
+	entry = g_hash_table_lookup (priv->entries, key);
+
+	if (entry && entry->expires <= g_get_monotonic_time ())
+	{
+		remove_entry (priv, entry);
+		entry = NULL;
+	}
+
+	if (entry)
+	{
+		g_queue_unlink (&priv->lru, &entry->link);
+		g_queue_push_head_link (&priv->lru, &entry->link);
+
+		frozen = soup_soap_frozen_message_ref (entry->response);
+	}
+
+	g_mutex_unlock (&priv->lock);
+
+	g_free (key);
+
+	if (frozen == NULL)
+		return NULL;
+
+	response = _soup_soap_frozen_message_thaw (frozen);
+	soup_soap_frozen_message_unref (frozen);
+
+	return response;
+}
+
+void
+soup_soap_cache_store (SoupSoapCache *cache,
+                       SoupURI *uri,
+                       SoupSoapMessage *request,
+                       SoupSoapMessage *response)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (cache));
+	g_return_if_fail (uri != NULL);
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (request));
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (response));
+
+	SoupSoapCachePrivate *priv = cache->priv;
+	SoupSoapCacheEntry *entry, *old_entry;
+	SoupSoapFrozenMessage *frozen;
+	guint ttl;
+
+	ttl = soup_soap_cache_get_ttl (cache,
+	                               soup_soap_message_get_operation_name (request));
+
+	if (ttl == 0 || soup_soap_message_is_fault (response))
+		return;
+
+	/* Entries can be evicted on any thread, so they must not hold the
+	 * SoupMessage headers and body the response was parsed from.
+	 */
+	frozen = soup_soap_message_freeze (response);
+	if (soup_soap_frozen_message_get_size (frozen) > soup_soap_cache_get_max_size (cache))
+	{
+		soup_soap_frozen_message_unref (frozen);
+		return;
+	}
+
+	entry = g_slice_new (SoupSoapCacheEntry);
+	entry->link.data = entry;
+	entry->link.prev = entry->link.next = NULL;
+	entry->key = compute_key (uri, request);
+	entry->response = frozen;
+	entry->size = soup_soap_frozen_message_get_size (frozen);
+	entry->expires = g_get_monotonic_time () + ttl * G_TIME_SPAN_SECOND;
+
+	g_mutex_lock (&priv->lock);
+
+	old_entry = g_hash_table_lookup (priv->entries, entry->key);
+	if (old_entry)
+		remove_entry (priv, old_entry);
+
+	g_hash_table_insert (priv->entries, entry->key, entry);
+	g_queue_push_head_link (&priv->lru, &entry->link);
+	priv->size += entry->size;
+
+	evict (priv, priv->max_size);
+
+	g_mutex_unlock (&priv->lock);
+}
+
+void
+soup_soap_cache_clear (SoupSoapCache *cache)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CACHE (cache));
+
+	SoupSoapCachePrivate *priv = cache->priv;
+
+	g_mutex_lock (&priv->lock);
+	evict (priv, 0);
+	g_mutex_unlock (&priv->lock);
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_CACHE_H_
+#define _SOUP_SOAP_CACHE_H_
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap-message.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_CACHE             (soup_soap_cache_get_type ())
+#define SOUP_SOAP_CACHE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_CACHE, SoupSoapCache))
+#define SOUP_SOAP_CACHE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_CACHE, SoupSoapCacheClass))
+#define SOUP_SOAP_IS_CACHE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_CACHE))
+#define SOUP_SOAP_IS_CACHE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_CACHE))
+#define SOUP_SOAP_CACHE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_CACHE, SoupSoapCacheClass))
+
+typedef struct _SoupSoapCachePrivate SoupSoapCachePrivate;
+typedef struct _SoupSoapCacheClass SoupSoapCacheClass;
+typedef struct _SoupSoapCache SoupSoapCache;
+
+struct _SoupSoapCacheClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapCache
+{
+	GObject parent_instance;
+
+	SoupSoapCachePrivate *priv;
+};
+
+GType soup_soap_cache_get_type (void) G_GNUC_CONST;
+SoupSoapCache *soup_soap_cache_new (gsize max_size);
+gsize soup_soap_cache_get_max_size (SoupSoapCache *cache);
+void soup_soap_cache_set_max_size (SoupSoapCache *cache, gsize max_size);
+gsize soup_soap_cache_get_size (SoupSoapCache *cache);
+guint soup_soap_cache_get_ttl (SoupSoapCache *cache, const gchar *operation);
+void soup_soap_cache_set_ttl (SoupSoapCache *cache, const gchar *operation, guint ttl);
+SoupSoapMessage *soup_soap_cache_lookup (SoupSoapCache *cache, SoupURI *uri, SoupSoapMessage *request);
+void soup_soap_cache_store (SoupSoapCache *cache, SoupURI *uri, SoupSoapMessage *request, SoupSoapMessage *response);
+void soup_soap_cache_clear (SoupSoapCache *cache);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_CACHE_H_ */
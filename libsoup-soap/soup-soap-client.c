@@ -0,0 +1,705 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+struct _SoupSoapClientPrivate
+{
+	SoupSession *session;
+	SoupSoapCache *cache;
+	SoupSoapSchema *schema;
+	gboolean coalesce;
+
+	GMutex calls_lock;
+	GHashTable *calls;
+};
+
+#define SOUP_SOAP_CLIENT_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_CLIENT, SoupSoapClientPrivate))
+
+enum
+{
+	PROP_0,
+
+	PROP_SESSION,
+	PROP_CACHE,
+	PROP_SCHEMA,
+	PROP_COALESCE
+};
+
+/* One request on the wire, shared by every identical call made while it
+ * is in flight.  The waiters, the count of those still waiting and the
+ * completed flag are protected by the calls lock.
+ */
+typedef struct
+{
+	SoupSoapClient *client;
+	gchar *key;
+	SoupURI *uri;
+	SoupMessage *msg;
+	SoupSoapMessage *request;
+	GCancellable *cancellable;
+	GMainContext *context;
+	GQueue waiters;
+	guint n_waiting;
+	gboolean completed;
+
+	/* Monotonic times at which each stage ended, or 0 */
+	gint64 started;
+	gint64 persisted;
+	gint64 sent;
+	gint64 first_byte;
+	gint64 received;
+} SoupSoapClientCall;
+
+/* One caller of a call; task is cleared once the caller has gone */
+typedef struct
+{
+	SoupSoapClientCall *call;
+	GTask *task;
+	GCancellable *cancellable;
+	gulong cancelled_id;
+} SoupSoapClientWaiter;
+
+typedef struct
+{
+	SoupSession *session;
+	SoupMessage *msg;
+} SoupSoapClientAbort;
+
+
+static gchar *
+compute_call_key (SoupMessage *msg,
+                  SoupSoapMessage *request)
+{
+	gchar *uri = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
+	gchar *digest = soup_soap_message_get_digest (request);
+	gchar *key = g_strconcat (digest, " ", uri, NULL);
+
+	g_free (digest);
+	g_free (uri);
+
+	return key;
+}
+
+static gint64
+stage_duration (gint64 start,
+                gint64 end)
+{
+	return start && end ? end - start : -1;
+}
+
+static void
+call_record_latency (SoupSoapClientCall *call)
+{
+	gint64 times[SOUP_SOAP_LATENCY_N_STAGES];
+	gint64 completed = g_get_monotonic_time ();
+
+	times[SOUP_SOAP_LATENCY_STAGE_PERSIST] =
+		stage_duration (call->started, call->persisted);
+	times[SOUP_SOAP_LATENCY_STAGE_SEND] =
+		stage_duration (call->persisted, call->sent);
+	times[SOUP_SOAP_LATENCY_STAGE_FIRST_BYTE] =
+		stage_duration (call->sent, call->first_byte);
+	times[SOUP_SOAP_LATENCY_STAGE_RECEIVE] =
+		stage_duration (call->first_byte, call->received);
+	times[SOUP_SOAP_LATENCY_STAGE_PARSE] =
+		stage_duration (call->received, completed);
+	times[SOUP_SOAP_LATENCY_STAGE_TOTAL] =
+		stage_duration (call->started, completed);
+
+	_soup_soap_latency_record (soup_soap_message_get_operation_name (call->request),
+	                           times);
+}
+
+/* Must be called with the calls lock held */
+static void
+call_unregister (SoupSoapClientCall *call)
+{
+	SoupSoapClientPrivate *priv = call->client->priv;
+
+	/* An abandoned call may already have made way for a new one */
+	if (call->key && g_hash_table_lookup (priv->calls, call->key) == call)
+		g_hash_table_remove (priv->calls, call->key);
+}
+
+static gboolean
+call_abort (gpointer user_data)
+{
+	SoupSoapClientAbort *abort_data = user_data;
+
+	soup_session_cancel_message (abort_data->session, abort_data->msg,
+	                             SOUP_STATUS_CANCELLED);
+
+	g_object_unref (abort_data->msg);
+	g_object_unref (abort_data->session);
+	g_slice_free (SoupSoapClientAbort, abort_data);
+
+	return FALSE;
+}
+
+/* Detaches a caller whose cancellable fired, and drops the request on
+ * the wire once nobody is left waiting for it.
+ */
+static void
+call_waiter_cancelled (GCancellable *cancellable,
+                       gpointer user_data)
+{
+	SoupSoapClientWaiter *waiter = user_data;
+	SoupSoapClientCall *call = waiter->call;
+	SoupSoapClientPrivate *priv = call->client->priv;
+	SoupSoapClientAbort *abort_data = NULL;
+	GSource *source;
+	GTask *task = NULL;
+
+	g_mutex_lock (&priv->calls_lock);
+	if (!call->completed && waiter->task)
+	{
+		task = waiter->task;
+		waiter->task = NULL;
+
+		if (--call->n_waiting == 0)
+		{
+			call_unregister (call);
+
+			abort_data = g_slice_new (SoupSoapClientAbort);
+			abort_data->session = g_object_ref (priv->session);
+			abort_data->msg = g_object_ref (call->msg);
+		}
+	}
+	g_mutex_unlock (&priv->calls_lock);
+
+	if (task)
+	{
+		g_task_return_error_if_cancelled (task);
+		g_object_unref (task);
+	}
+
+	/* The session is not thread-safe, and this may run on any thread */
+	if (abort_data)
+	{
+		g_cancellable_cancel (call->cancellable);
+
+		source = g_idle_source_new ();
+		g_source_set_callback (source, call_abort, abort_data, NULL);
+		g_source_attach (source, call->context);
+		g_source_unref (source);
+	}
+}
+
+static void
+call_complete (SoupSoapClientCall *call,
+               SoupSoapMessage *response,
+               GError *error)
+{
+	SoupSoapClientPrivate *priv = call->client->priv;
+	SoupSoapClientWaiter *waiter;
+	SoupSoapFrozenMessage *frozen = NULL;
+	GQueue waiters;
+
+	g_mutex_lock (&priv->calls_lock);
+	call_unregister (call);
+	call->completed = TRUE;
+	waiters = call->waiters;
+	g_queue_init (&call->waiters);
+	g_mutex_unlock (&priv->calls_lock);
+
+	/* Only calls that got a response are timed, so that failures do not
+	 * skew the distribution.
+	 */
+	if (response)
+		call_record_latency (call);
+
+	if (response && priv->cache)
+		soup_soap_cache_store (priv->cache, call->uri, call->request,
+		                       response);
+
+	/* The first waiter gets the parsed response and every other one a
+	 * copy of its own, taken before the first can change it.
+	 */
+	if (response && waiters.length > 1)
+		frozen = soup_soap_message_freeze (response);
+
+	while ((waiter = g_queue_pop_head (&waiters)) != NULL)
+	{
+		/* Waits for a handler running on another thread to finish */
+		if (waiter->cancelled_id)
+			g_cancellable_disconnect (waiter->cancellable,
+			                          waiter->cancelled_id);
+
+		if (waiter->task && response)
+		{
+			g_task_return_pointer (waiter->task, g_object_ref (response),
+			                       g_object_unref);
+			response = NULL;
+		}
+		else if (waiter->task && frozen)
+			g_task_return_pointer (waiter->task,
+			                       _soup_soap_frozen_message_thaw (frozen),
+			                       g_object_unref);
+		else if (waiter->task)
+			g_task_return_error (waiter->task, g_error_copy (error));
+
+		if (waiter->task)
+			g_object_unref (waiter->task);
+		if (waiter->cancellable)
+			g_object_unref (waiter->cancellable);
+		g_slice_free (SoupSoapClientWaiter, waiter);
+	}
+
+	if (frozen)
+		soup_soap_frozen_message_unref (frozen);
+
+	soup_uri_free (call->uri);
+	g_object_unref (call->msg);
+	g_object_unref (call->request);
+	g_object_unref (call->cancellable);
+	g_main_context_unref (call->context);
+	g_object_unref (call->client);
+	g_free (call->key);
+	g_slice_free (SoupSoapClientCall, call);
+}
+
+static void
+call_parsed (GObject *source_object,
+             GAsyncResult *result,
+             gpointer user_data)
+{
+	SoupSoapClientCall *call = user_data;
+	SoupSoapMessage *response;
+	GError *error = NULL;
+
+	response = soup_soap_message_new_finish (result, &error);
+
+	call_complete (call, response, error);
+
+	if (response)
+		g_object_unref (response);
+	if (error)
+		g_error_free (error);
+}
+
+static void
+call_wrote_body (SoupMessage *msg,
+                 gpointer user_data)
+{
+	SoupSoapClientCall *call = user_data;
+
+	/* A resent message, after a redirect for example, starts again */
+	call->sent = g_get_monotonic_time ();
+	call->first_byte = 0;
+}
+
+static void
+call_got_headers (SoupMessage *msg,
+                  gpointer user_data)
+{
+	SoupSoapClientCall *call = user_data;
+
+	if (call->first_byte == 0)
+		call->first_byte = g_get_monotonic_time ();
+}
+
+static void
+call_finished (SoupSession *session,
+               SoupMessage *msg,
+               gpointer user_data)
+{
+	SoupSoapClientCall *call = user_data;
+	GError *error;
+
+	call->received = g_get_monotonic_time ();
+	g_signal_handlers_disconnect_by_data (msg, call);
+
+	/* Faults come back as 500 and still carry a SOAP envelope */
+	if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code) ||
+	    msg->status_code == SOUP_STATUS_INTERNAL_SERVER_ERROR)
+	{
+		_soup_soap_message_new_async_full (msg->response_headers,
+		                                   msg->response_body, msg,
+		                                   call->client->priv->schema,
+		                                   call->cancellable,
+		                                   call_parsed, call);
+		return;
+	}
+
+	error = g_error_new_literal (SOUP_HTTP_ERROR, msg->status_code,
+	                             msg->reason_phrase);
+	call_complete (call, NULL, error);
+	g_error_free (error);
+}
+
+
+G_DEFINE_TYPE (SoupSoapClient, soup_soap_client, G_TYPE_OBJECT);
+
+static void
+soup_soap_client_init (SoupSoapClient *object)
+{
+	object->priv = SOUP_SOAP_CLIENT_GET_PRIVATE (object);
+	SoupSoapClientPrivate *priv = object->priv;
+
+	priv->session = NULL;
+	priv->cache = NULL;
+	priv->schema = NULL;
+	priv->coalesce = TRUE;
+
+	g_mutex_init (&priv->calls_lock);
+	priv->calls = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static void
+soup_soap_client_finalize (GObject *object)
+{
+	SoupSoapClient *client = SOUP_SOAP_CLIENT (object);
+	SoupSoapClientPrivate *priv = client->priv;
+
+	if (priv->session)
+		g_object_unref (priv->session);
+	if (priv->cache)
+		g_object_unref (priv->cache);
+	if (priv->schema)
+		g_object_unref (priv->schema);
+
+	g_hash_table_unref (priv->calls);
+	g_mutex_clear (&priv->calls_lock);
+
+	G_OBJECT_CLASS (soup_soap_client_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_client_set_property (GObject *object,
+                               guint prop_id,
+                               const GValue *value,
+                               GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (object));
+
+	SoupSoapClient *client = SOUP_SOAP_CLIENT (object);
+	SoupSoapClientPrivate *priv = client->priv;
+
+	switch (prop_id)
+	{
+		case PROP_SESSION:
+			priv->session = g_value_dup_object (value);
+			break;
+		case PROP_CACHE:
+			soup_soap_client_set_cache (client,
+			                            g_value_get_object (value));
+			break;
+		case PROP_SCHEMA:
+			soup_soap_client_set_schema (client,
+			                             g_value_get_object (value));
+			break;
+		case PROP_COALESCE:
+			soup_soap_client_set_coalesce (client,
+			                               g_value_get_boolean (value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_client_get_property (GObject *object,
+                               guint prop_id,
+                               GValue *value,
+                               GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (object));
+
+	SoupSoapClient *client = SOUP_SOAP_CLIENT (object);
+	SoupSoapClientPrivate *priv = client->priv;
+
+	switch (prop_id)
+	{
+		case PROP_SESSION:
+			g_value_set_object (value, priv->session);
+			break;
+		case PROP_CACHE:
+			g_value_set_object (value, priv->cache);
+			break;
+		case PROP_SCHEMA:
+			g_value_set_object (value, priv->schema);
+			break;
+		case PROP_COALESCE:
+			g_value_set_boolean (value, priv->coalesce);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_client_class_init (SoupSoapClientClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	/*GObjectClass *parent_class = G_OBJECT_CLASS (klass);*/
+
+	g_type_class_add_private (klass, sizeof (SoupSoapClientPrivate));
+
+	object_class->finalize = soup_soap_client_finalize;
+	object_class->set_property = soup_soap_client_set_property;
+	object_class->get_property = soup_soap_client_get_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_SESSION,
+	                                 g_param_spec_object ("session",
+	                                                      "Session",
+	                                                      "The session used to send requests",
+	                                                      SOUP_TYPE_SESSION,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_CACHE,
+	                                 g_param_spec_object ("cache",
+	                                                      "Cache",
+	                                                      "The cache consulted before sending requests",
+	                                                      SOUP_SOAP_TYPE_CACHE,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_SCHEMA,
+	                                 g_param_spec_object ("schema",
+	                                                      "Schema",
+	                                                      "The schema responses are validated against while parsing",
+	                                                      SOUP_SOAP_TYPE_SCHEMA,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_COALESCE,
+	                                 g_param_spec_boolean ("coalesce",
+	                                                       "Coalesce",
+	                                                       "Whether identical calls in flight share one request",
+	                                                       TRUE,
+	                                                       G_PARAM_READABLE | G_PARAM_WRITABLE));
+}
+
+
+SoupSoapClient *
+soup_soap_client_new (SoupSession *session)
+{
+	g_return_val_if_fail (SOUP_IS_SESSION (session), NULL);
+
+	return g_object_new (SOUP_SOAP_TYPE_CLIENT,
+	                     "session", session,
+	                     NULL);
+}
+
+SoupSession *
+soup_soap_client_get_session (SoupSoapClient *client)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CLIENT (client), NULL);
+
+	return client->priv->session;
+}
+
+SoupSoapCache *
+soup_soap_client_get_cache (SoupSoapClient *client)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CLIENT (client), NULL);
+
+	return client->priv->cache;
+}
+
+void
+soup_soap_client_set_cache (SoupSoapClient *client,
+                            SoupSoapCache *cache)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (client));
+	g_return_if_fail (cache == NULL || SOUP_SOAP_IS_CACHE (cache));
+
+	SoupSoapClientPrivate *priv = client->priv;
+
+	if (cache)
+		g_object_ref (cache);
+	if (priv->cache)
+		g_object_unref (priv->cache);
+
+	priv->cache = cache;
+}
+
+SoupSoapSchema *
+soup_soap_client_get_schema (SoupSoapClient *client)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CLIENT (client), NULL);
+
+	return client->priv->schema;
+}
+
+void
+soup_soap_client_set_schema (SoupSoapClient *client,
+                             SoupSoapSchema *schema)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (client));
+	g_return_if_fail (schema == NULL || SOUP_SOAP_IS_SCHEMA (schema));
+
+	SoupSoapClientPrivate *priv = client->priv;
+
+	if (schema)
+		g_object_ref (schema);
+	if (priv->schema)
+		g_object_unref (priv->schema);
+
+	priv->schema = schema;
+}
+
+gboolean
+soup_soap_client_get_coalesce (SoupSoapClient *client)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CLIENT (client), FALSE);
+
+	return client->priv->coalesce;
+}
+
+void
+soup_soap_client_set_coalesce (SoupSoapClient *client,
+                               gboolean coalesce)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (client));
+
+	client->priv->coalesce = coalesce;
+}
+
+void
+soup_soap_client_call_async (SoupSoapClient *client,
+                             SoupMessage *msg,
+                             SoupSoapMessage *request,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+	g_return_if_fail (SOUP_SOAP_IS_CLIENT (client));
+	g_return_if_fail (SOUP_IS_MESSAGE (msg));
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (request));
+
+	SoupSoapClientPrivate *priv = client->priv;
+	SoupSoapClientCall *call = NULL;
+	SoupSoapClientWaiter *waiter;
+	SoupSoapMessage *response;
+	GTask *task;
+	gchar *key = NULL;
+	gboolean joined;
+
+	task = g_task_new (client, cancellable, callback, user_data);
+	g_task_set_source_tag (task, soup_soap_client_call_async);
+
+	if (priv->cache &&
+	    (response = soup_soap_cache_lookup (priv->cache,
+	                                        soup_message_get_uri (msg),
+	                                        request)) != NULL)
+	{
+		g_task_return_pointer (task, response, g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+
+	if (priv->coalesce)
+		key = compute_call_key (msg, request);
+
+	waiter = g_slice_new (SoupSoapClientWaiter);
+	waiter->task = task;
+	waiter->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	waiter->cancelled_id = 0;
+
+	/* Looking up and registering under one lock, so that two identical
+	 * calls made at once cannot both go on the wire.
+	 */
+	g_mutex_lock (&priv->calls_lock);
+
+	if (key)
+		call = g_hash_table_lookup (priv->calls, key);
+
+	joined = call != NULL;
+
+	if (joined)
+		g_free (key);
+	else
+	{
+		call = g_slice_new (SoupSoapClientCall);
+		call->client = g_object_ref (client);
+		call->key = key;
+		call->uri = soup_uri_copy (soup_message_get_uri (msg));
+		call->msg = g_object_ref (msg);
+		call->request = g_object_ref (request);
+		call->cancellable = g_cancellable_new ();
+		call->context = g_main_context_ref_thread_default ();
+		g_queue_init (&call->waiters);
+		call->n_waiting = 0;
+		call->completed = FALSE;
+		call->started = g_get_monotonic_time ();
+		call->persisted = 0;
+		call->sent = 0;
+		call->first_byte = 0;
+		call->received = 0;
+
+		if (key)
+			g_hash_table_insert (priv->calls, key, call);
+	}
+
+	waiter->call = call;
+	g_queue_push_tail (&call->waiters, waiter);
+	call->n_waiting++;
+
+	g_mutex_unlock (&priv->calls_lock);
+
+	/* May run the handler at once, which needs the lock */
+	if (cancellable)
+		waiter->cancelled_id = g_cancellable_connect (cancellable,
+		                                              G_CALLBACK (call_waiter_cancelled),
+		                                              waiter, NULL);
+
+	/* msg is never sent when joining a call already on the wire; the
+	 * caller gets the result of that call.
+	 */
+	if (joined)
+		return;
+
+	if (!soup_message_headers_get_one (msg->request_headers,
+	                                   "Accept-Encoding"))
+		soup_message_headers_append (msg->request_headers,
+		                             "Accept-Encoding", "gzip, deflate");
+
+	soup_soap_message_persist (request);
+	call->persisted = g_get_monotonic_time ();
+
+	g_signal_connect (msg, "wrote-body",
+	                  G_CALLBACK (call_wrote_body), call);
+	g_signal_connect (msg, "got-headers",
+	                  G_CALLBACK (call_got_headers), call);
+
+	soup_session_queue_message (priv->session, g_object_ref (msg),
+	                            call_finished, call);
+}
+
+SoupSoapMessage *
+soup_soap_client_call_finish (SoupSoapClient *client,
+                              GAsyncResult *result,
+                              GError **error)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_CLIENT (client), NULL);
+	g_return_val_if_fail (g_task_is_valid (result, client), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_CLIENT_H_
+#define _SOUP_SOAP_CLIENT_H_
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap-message.h>
+#include <libsoup-soap/soup-soap-cache.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_CLIENT             (soup_soap_client_get_type ())
+#define SOUP_SOAP_CLIENT(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_CLIENT, SoupSoapClient))
+#define SOUP_SOAP_CLIENT_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_CLIENT, SoupSoapClientClass))
+#define SOUP_SOAP_IS_CLIENT(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_CLIENT))
+#define SOUP_SOAP_IS_CLIENT_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_CLIENT))
+#define SOUP_SOAP_CLIENT_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_CLIENT, SoupSoapClientClass))
+
+typedef struct _SoupSoapClientPrivate SoupSoapClientPrivate;
+typedef struct _SoupSoapClientClass SoupSoapClientClass;
+typedef struct _SoupSoapClient SoupSoapClient;
+
+struct _SoupSoapClientClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapClient
+{
+	GObject parent_instance;
+
+	SoupSoapClientPrivate *priv;
+};
+
+GType soup_soap_client_get_type (void) G_GNUC_CONST;
+SoupSoapClient *soup_soap_client_new (SoupSession *session);
+SoupSession *soup_soap_client_get_session (SoupSoapClient *client);
+SoupSoapCache *soup_soap_client_get_cache (SoupSoapClient *client);
+void soup_soap_client_set_cache (SoupSoapClient *client, SoupSoapCache *cache);
+SoupSoapSchema *soup_soap_client_get_schema (SoupSoapClient *client);
+void soup_soap_client_set_schema (SoupSoapClient *client, SoupSoapSchema *schema);
+gboolean soup_soap_client_get_coalesce (SoupSoapClient *client);
+void soup_soap_client_set_coalesce (SoupSoapClient *client, gboolean coalesce);
+void soup_soap_client_call_async (SoupSoapClient *client, SoupMessage *msg, SoupSoapMessage *request, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+SoupSoapMessage *soup_soap_client_call_finish (SoupSoapClient *client, GAsyncResult *result, GError **error);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_CLIENT_H_ */
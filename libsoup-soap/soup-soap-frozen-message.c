@@ -0,0 +1,457 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Frozen messages keep the param tree in one block: the nodes, in
+ * breadth-first order so that the children of a node are contiguous,
+ * then the children of each node again, sorted by name for lookups,
+ * followed by a pool holding every string.  Names appear in the pool
+ * once each.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+struct _SoupSoapFrozenNode
+{
+	const gchar *name;
+	const gchar *namespace_uri;
+	const gchar *value;          /* NULL for groups */
+	const SoupSoapFrozenNode *children;
+	/* The children sorted by name, then by position */
+	const SoupSoapFrozenNode **by_name;
+	guint n_children;
+};
+
+struct _SoupSoapFrozenMessage
+{
+	gint ref_count;
+
+	const gchar *operation_name;
+	gboolean has_operation;
+	gboolean is_fault;
+	gsize size;
+
+	/* The header, then the params, then their descendants */
+	SoupSoapFrozenNode *nodes;
+	guint n_nodes;
+};
+
+/* Only group nodes have a value of NULL; leaves without one get this */
+static const gchar empty_value[] = "";
+
+
+
+G_DEFINE_BOXED_TYPE (SoupSoapFrozenMessage, soup_soap_frozen_message, soup_soap_frozen_message_ref, soup_soap_frozen_message_unref);
+
+static gsize
+pool_string_size (GHashTable *names,
+                  const gchar *string)
+{
+	if (string == NULL || g_hash_table_contains (names, string))
+		return 0;
+
+	g_hash_table_add (names, (gpointer) string);
+
+	return strlen (string) + 1;
+}
+
+/* Counts the nodes and pool bytes the tree below param needs */
+static void
+measure_tree (SoupSoapParam *param,
+              GHashTable *names,
+              guint *n_nodes,
+              gsize *pool_size)
+{
+	GList *elements;
+
+	(*n_nodes)++;
+	*pool_size += pool_string_size (names, soup_soap_param_get_name (param));
+	*pool_size += pool_string_size (names,
+	                                soup_soap_param_get_namespace_uri (param));
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+	{
+		const gchar *value = soup_soap_param_get_value (param);
+
+		*pool_size += value ? strlen (value) + 1 : 0;
+		return;
+	}
+
+	for (elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		measure_tree (elements->data, names, n_nodes, pool_size);
+}
+
+static const gchar *
+pool_add (gchar **pool,
+          const gchar *string)
+{
+	gsize length = strlen (string) + 1;
+	const gchar *copy = *pool;
+
+	memcpy (*pool, string, length);
+	*pool += length;
+
+	return copy;
+}
+
+static int
+compare_nodes_by_name (gconstpointer a,
+                       gconstpointer b)
+{
+	const SoupSoapFrozenNode *node_a = *(const SoupSoapFrozenNode **) a;
+	const SoupSoapFrozenNode *node_b = *(const SoupSoapFrozenNode **) b;
+	int result = strcmp (node_a->name, node_b->name);
+
+	if (result != 0)
+		return result;
+
+	return node_a < node_b ? -1 : node_a > node_b;
+}
+
+/* Equal names share one copy in the pool */
+static const gchar *
+pool_add_name (gchar **pool,
+               GHashTable *names,
+               const gchar *name)
+{
+	const gchar *copy;
+
+	if (name == NULL)
+		return NULL;
+
+	copy = g_hash_table_lookup (names, name);
+	if (copy == NULL)
+	{
+		copy = pool_add (pool, name);
+		g_hash_table_insert (names, (gpointer) name, (gpointer) copy);
+	}
+
+	return copy;
+}
+
+SoupSoapFrozenMessage *
+soup_soap_message_freeze (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+
+	SoupSoapParam *roots[2];
+	SoupSoapParam **params;
+	SoupSoapFrozenMessage *frozen;
+	const SoupSoapFrozenNode **index;
+	GHashTable *names;
+	const gchar *operation_name = soup_soap_message_get_operation_name (msg);
+	guint n_nodes = 0, next, i;
+	gsize pool_size = 0;
+	gchar *pool;
+
+	roots[0] = SOUP_SOAP_PARAM (soup_soap_message_get_header (msg));
+	roots[1] = SOUP_SOAP_PARAM (soup_soap_message_get_params (msg));
+
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (i = 0; i < G_N_ELEMENTS (roots); i++)
+		measure_tree (roots[i], names, &n_nodes, &pool_size);
+	if (operation_name)
+		pool_size += strlen (operation_name) + 1;
+
+	/* Nodes and the index hold pointers, so neither needs padding */
+	frozen = g_malloc (sizeof (SoupSoapFrozenMessage) +
+	                   n_nodes * (sizeof (SoupSoapFrozenNode) +
+	                              sizeof (SoupSoapFrozenNode *)) + pool_size);
+	frozen->ref_count = 1;
+	frozen->has_operation = soup_soap_message_has_operation (msg);
+	frozen->is_fault = soup_soap_message_is_fault (msg);
+	frozen->size = sizeof (SoupSoapFrozenMessage) +
+	               n_nodes * (sizeof (SoupSoapFrozenNode) +
+	                          sizeof (SoupSoapFrozenNode *)) + pool_size;
+	frozen->nodes = (SoupSoapFrozenNode *) (frozen + 1);
+	frozen->n_nodes = n_nodes;
+
+	index = (const SoupSoapFrozenNode **) (frozen->nodes + n_nodes);
+	pool = (gchar *) (index + n_nodes);
+	frozen->operation_name = operation_name ? pool_add (&pool, operation_name) : NULL;
+
+	g_hash_table_remove_all (names);
+
+	/* Laid out breadth-first: params[i] is the param of nodes[i], and the
+	 * children of each group are given the next free run of nodes.
+	 */
+	params = g_new (SoupSoapParam *, n_nodes);
+	params[0] = roots[0];
+	params[1] = roots[1];
+	next = G_N_ELEMENTS (roots);
+
+	for (i = 0; i < n_nodes; i++)
+	{
+		SoupSoapFrozenNode *node = &frozen->nodes[i];
+		SoupSoapParam *param = params[i];
+		GList *elements;
+
+		node->name = pool_add_name (&pool, names,
+		                            soup_soap_param_get_name (param));
+		node->namespace_uri = pool_add_name (&pool, names,
+		                                     soup_soap_param_get_namespace_uri (param));
+		node->children = NULL;
+		node->by_name = NULL;
+		node->n_children = 0;
+
+		if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+		{
+			const gchar *value = soup_soap_param_get_value (param);
+
+			node->value = value ? pool_add (&pool, value) : empty_value;
+			continue;
+		}
+
+		node->value = NULL;
+		node->children = &frozen->nodes[next];
+		node->by_name = &index[next];
+
+		for (elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+		     elements != NULL;
+		     elements = g_list_next (elements))
+		{
+			params[next++] = elements->data;
+			node->n_children++;
+		}
+	}
+
+	g_free (params);
+	g_hash_table_destroy (names);
+
+	/* Every child has a name by now, so the index can be sorted */
+	for (i = 0; i < n_nodes; i++)
+	{
+		SoupSoapFrozenNode *node = &frozen->nodes[i];
+		guint j;
+
+		for (j = 0; j < node->n_children; j++)
+			node->by_name[j] = &node->children[j];
+
+		if (node->n_children > 1)
+			qsort (node->by_name, node->n_children,
+			       sizeof (SoupSoapFrozenNode *), compare_nodes_by_name);
+	}
+
+	return frozen;
+}
+
+static const gchar *
+thaw_name (SoupSoapStringPool *names,
+           const gchar *name)
+{
+	return name ? _soup_soap_string_pool_add (names, name) : NULL;
+}
+
+/* Gives param the name of node, and its value or copies of its children */
+static void
+thaw_node (const SoupSoapFrozenNode *node,
+           SoupSoapParam *param,
+           SoupSoapStringPool *names)
+{
+	guint i;
+
+	_soup_soap_param_set_pooled_name (param,
+	                                  thaw_name (names, node->namespace_uri),
+	                                  thaw_name (names, node->name));
+
+	if (node->value)
+	{
+		if (node->value != empty_value)
+			soup_soap_param_set_value (param, node->value);
+		return;
+	}
+
+	for (i = 0; i < node->n_children; i++)
+	{
+		const SoupSoapFrozenNode *child = &node->children[i];
+		SoupSoapParam *element =
+			g_object_new (child->value ? SOUP_SOAP_TYPE_PARAM : SOUP_SOAP_TYPE_PARAM_GROUP,
+			              NULL);
+
+		thaw_node (child, element, names);
+		soup_soap_param_group_add (SOUP_SOAP_PARAM_GROUP (param), element);
+	}
+}
+
+/* Returns a new message with its own copy of the tree, and no SoupMessage
+ * headers or body; it can be changed but not persisted.
+ */
+SoupSoapMessage *
+_soup_soap_frozen_message_thaw (SoupSoapFrozenMessage *frozen)
+{
+	SoupSoapMessage *msg = g_object_new (SOUP_SOAP_TYPE_MESSAGE, NULL);
+	SoupSoapStringPool *names = _soup_soap_string_pool_new ();
+
+	thaw_node (&frozen->nodes[0],
+	           SOUP_SOAP_PARAM (soup_soap_message_get_header (msg)), names);
+	thaw_node (&frozen->nodes[1],
+	           SOUP_SOAP_PARAM (soup_soap_message_get_params (msg)), names);
+	if (frozen->has_operation)
+		soup_soap_message_set_operation_name (msg, frozen->nodes[1].name);
+
+	_soup_soap_string_pool_free (names);
+
+	return msg;
+}
+
+SoupSoapFrozenMessage *
+soup_soap_frozen_message_ref (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, NULL);
+
+	g_atomic_int_inc (&frozen->ref_count);
+
+	return frozen;
+}
+
+void
+soup_soap_frozen_message_unref (SoupSoapFrozenMessage *frozen)
+{
+	g_return_if_fail (frozen != NULL);
+
+	if (g_atomic_int_dec_and_test (&frozen->ref_count))
+		g_free (frozen);
+}
+
+const gchar *
+soup_soap_frozen_message_get_operation_name (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, NULL);
+
+	return frozen->operation_name;
+}
+
+gboolean
+soup_soap_frozen_message_is_fault (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, FALSE);
+
+	return frozen->is_fault;
+}
+
+const SoupSoapFrozenNode *
+soup_soap_frozen_message_get_header (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, NULL);
+
+	return &frozen->nodes[0];
+}
+
+const SoupSoapFrozenNode *
+soup_soap_frozen_message_get_params (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, NULL);
+
+	return &frozen->nodes[1];
+}
+
+/* Bytes taken by the message, in a single allocation */
+gsize
+soup_soap_frozen_message_get_size (SoupSoapFrozenMessage *frozen)
+{
+	g_return_val_if_fail (frozen != NULL, 0);
+
+	return frozen->size;
+}
+
+const gchar *
+soup_soap_frozen_node_get_name (const SoupSoapFrozenNode *node)
+{
+	g_return_val_if_fail (node != NULL, NULL);
+
+	return node->name;
+}
+
+const gchar *
+soup_soap_frozen_node_get_namespace_uri (const SoupSoapFrozenNode *node)
+{
+	g_return_val_if_fail (node != NULL, NULL);
+
+	return node->namespace_uri;
+}
+
+const gchar *
+soup_soap_frozen_node_get_value (const SoupSoapFrozenNode *node)
+{
+	g_return_val_if_fail (node != NULL, NULL);
+
+	return node->value;
+}
+
+gboolean
+soup_soap_frozen_node_is_group (const SoupSoapFrozenNode *node)
+{
+	g_return_val_if_fail (node != NULL, FALSE);
+
+	return node->value == NULL;
+}
+
+guint
+soup_soap_frozen_node_get_n_children (const SoupSoapFrozenNode *node)
+{
+	g_return_val_if_fail (node != NULL, 0);
+
+	return node->n_children;
+}
+
+const SoupSoapFrozenNode *
+soup_soap_frozen_node_get_child (const SoupSoapFrozenNode *node,
+                                 guint index)
+{
+	g_return_val_if_fail (node != NULL, NULL);
+	g_return_val_if_fail (index < node->n_children, NULL);
+
+	return &node->children[index];
+}
+
+/* Returns the first child called name, or NULL */
+const SoupSoapFrozenNode *
+soup_soap_frozen_node_get_child_by_name (const SoupSoapFrozenNode *node,
+                                         const gchar *name)
+{
+	g_return_val_if_fail (node != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	guint low = 0, high = node->n_children;
+
+	/* Finds the first entry of the index not before name */
+	while (low < high)
+	{
+		guint middle = low + (high - low) / 2;
+
+		if (strcmp (node->by_name[middle]->name, name) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low < node->n_children && strcmp (node->by_name[low]->name, name) == 0)
+		return node->by_name[low];
+
+	return NULL;
+}
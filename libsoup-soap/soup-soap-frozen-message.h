@@ -0,0 +1,56 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_FROZEN_MESSAGE_H_
+#define _SOUP_SOAP_FROZEN_MESSAGE_H_
+
+#include <glib-object.h>
+#include <libsoup-soap/soup-soap-message.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_FROZEN_MESSAGE  (soup_soap_frozen_message_get_type ())
+
+typedef struct _SoupSoapFrozenMessage SoupSoapFrozenMessage;
+typedef struct _SoupSoapFrozenNode SoupSoapFrozenNode;
+
+/* A frozen message never changes, so any number of threads may read it
+ * at once.  Nodes belong to the message and need no references.
+ */
+GType soup_soap_frozen_message_get_type (void) G_GNUC_CONST;
+SoupSoapFrozenMessage *soup_soap_message_freeze (SoupSoapMessage *msg);
+SoupSoapFrozenMessage *soup_soap_frozen_message_ref (SoupSoapFrozenMessage *frozen);
+void soup_soap_frozen_message_unref (SoupSoapFrozenMessage *frozen);
+const gchar *soup_soap_frozen_message_get_operation_name (SoupSoapFrozenMessage *frozen);
+gboolean soup_soap_frozen_message_is_fault (SoupSoapFrozenMessage *frozen);
+const SoupSoapFrozenNode *soup_soap_frozen_message_get_header (SoupSoapFrozenMessage *frozen);
+const SoupSoapFrozenNode *soup_soap_frozen_message_get_params (SoupSoapFrozenMessage *frozen);
+gsize soup_soap_frozen_message_get_size (SoupSoapFrozenMessage *frozen);
+
+const gchar *soup_soap_frozen_node_get_name (const SoupSoapFrozenNode *node);
+const gchar *soup_soap_frozen_node_get_namespace_uri (const SoupSoapFrozenNode *node);
+const gchar *soup_soap_frozen_node_get_value (const SoupSoapFrozenNode *node);
+gboolean soup_soap_frozen_node_is_group (const SoupSoapFrozenNode *node);
+guint soup_soap_frozen_node_get_n_children (const SoupSoapFrozenNode *node);
+const SoupSoapFrozenNode *soup_soap_frozen_node_get_child (const SoupSoapFrozenNode *node, guint index);
+const SoupSoapFrozenNode *soup_soap_frozen_node_get_child_by_name (const SoupSoapFrozenNode *node, const gchar *name);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_FROZEN_MESSAGE_H_ */
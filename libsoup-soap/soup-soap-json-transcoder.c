@@ -0,0 +1,1025 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#define OUTPUT_CHUNK_SIZE 16384
+
+#define ENVELOPE_START \
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" \
+	"<SOAP-ENV:Envelope xmlns:SOAP-ENV=\"http://schemas.xmlsoap.org/soap/envelope/\">" \
+	"<SOAP-ENV:Body>"
+#define ENVELOPE_END "</SOAP-ENV:Body></SOAP-ENV:Envelope>"
+
+struct _SoupSoapJsonTranscoderPrivate
+{
+	GHashTable *array_elements;
+};
+
+#define SOUP_SOAP_JSON_TRANSCODER_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_JSON_TRANSCODER, SoupSoapJsonTranscoderPrivate))
+
+/* Output is gathered in a buffer that is handed to the body, without a
+ * copy, whenever it fills up.
+ */
+typedef struct
+{
+	SoupMessageBody *body;
+	GString *buffer;
+} TranscoderOutput;
+
+typedef struct
+{
+	gboolean opened;
+	gboolean has_members;
+	gchar *array_name;
+} SoapToJsonFrame;
+
+typedef struct
+{
+	GHashTable *array_elements;
+	TranscoderOutput output;
+	GArray *frames;
+	GString *text;
+	gint depth;
+	gint body_depth;
+} SoapToJsonState;
+
+typedef enum
+{
+	JSON_FRAME_TOP,
+	JSON_FRAME_OBJECT,
+	JSON_FRAME_ARRAY
+} JsonFrameType;
+
+typedef enum
+{
+	JSON_EXPECT_VALUE,
+	JSON_EXPECT_KEY,
+	JSON_EXPECT_COLON,
+	JSON_EXPECT_COMMA,
+	JSON_EXPECT_NOTHING
+} JsonExpect;
+
+typedef struct
+{
+	JsonFrameType type;
+	JsonExpect expect;
+	gchar *name;
+	gchar *key;
+} JsonToSoapFrame;
+
+typedef enum
+{
+	JSON_LEX_NONE,
+	JSON_LEX_STRING,
+	JSON_LEX_ESCAPE,
+	JSON_LEX_UNICODE,
+	JSON_LEX_LITERAL
+} JsonLexState;
+
+typedef struct
+{
+	TranscoderOutput output;
+	GArray *frames;
+
+	JsonLexState lex_state;
+	GString *token;
+	gunichar unicode;
+	guint unicode_digits;
+	gunichar high_surrogate;
+
+	GError *error;
+} JsonToSoapState;
+
+
+static void
+output_init (TranscoderOutput *output,
+             SoupMessageBody *body)
+{
+	output->body = body;
+	output->buffer = g_string_sized_new (OUTPUT_CHUNK_SIZE);
+}
+
+static void
+output_flush (TranscoderOutput *output,
+              gboolean force)
+{
+	gsize length = output->buffer->len;
+
+	if (length == 0 || (!force && length < OUTPUT_CHUNK_SIZE))
+		return;
+
+	soup_message_body_append (output->body, SOUP_MEMORY_TAKE,
+	                          g_string_free (output->buffer, FALSE), length);
+	output->buffer = g_string_sized_new (OUTPUT_CHUNK_SIZE);
+}
+
+static void
+output_finish (TranscoderOutput *output,
+               gboolean success)
+{
+	if (success)
+	{
+		output_flush (output, TRUE);
+		soup_message_body_complete (output->body);
+	}
+
+	g_string_free (output->buffer, TRUE);
+}
+
+static void
+append_json_string (GString *out,
+                    const gchar *text,
+                    gsize length)
+{
+	const gchar *p, *end = text + length;
+
+	g_string_append_c (out, '"');
+
+	for (p = text; p < end; p++)
+	{
+		switch (*p)
+		{
+			case '"':
+				g_string_append (out, "\\\"");
+				break;
+			case '\\':
+				g_string_append (out, "\\\\");
+				break;
+			case '\n':
+				g_string_append (out, "\\n");
+				break;
+			case '\r':
+				g_string_append (out, "\\r");
+				break;
+			case '\t':
+				g_string_append (out, "\\t");
+				break;
+			default:
+				if ((guchar) *p < 0x20)
+					g_string_append_printf (out, "\\u%04x", (guchar) *p);
+				else
+					g_string_append_c (out, *p);
+				break;
+		}
+	}
+
+	g_string_append_c (out, '"');
+}
+
+static void
+append_xml_text (GString *out,
+                 const gchar *text,
+                 gsize length)
+{
+	const gchar *p, *end = text + length;
+
+	for (p = text; p < end; p++)
+	{
+		switch (*p)
+		{
+			case '&':
+				g_string_append (out, "&amp;");
+				break;
+			case '<':
+				g_string_append (out, "&lt;");
+				break;
+			case '>':
+				g_string_append (out, "&gt;");
+				break;
+			default:
+				g_string_append_c (out, *p);
+				break;
+		}
+	}
+}
+
+
+/* SOAP to JSON.  Each element's value is opened lazily: its key is written
+ * when the element starts, but whether the value is an object or a string
+ * is only known once a child element or the end tag shows up.
+ */
+
+static SoapToJsonFrame *
+soap_frame_top (SoapToJsonState *state)
+{
+	return &g_array_index (state->frames, SoapToJsonFrame, state->frames->len - 1);
+}
+
+static void
+soap_frame_push (SoapToJsonState *state,
+                 gboolean opened)
+{
+	SoapToJsonFrame frame = { opened, FALSE, NULL };
+
+	g_array_append_val (state->frames, frame);
+}
+
+static void
+soap_frame_close_array (SoapToJsonState *state,
+                        SoapToJsonFrame *frame)
+{
+	if (frame->array_name == NULL)
+		return;
+
+	g_string_append_c (state->output.buffer, ']');
+	g_free (frame->array_name);
+	frame->array_name = NULL;
+}
+
+static void
+soap_start_element (void *ctx,
+                    const xmlChar *localname,
+                    const xmlChar *prefix,
+                    const xmlChar *uri,
+                    int nb_namespaces,
+                    const xmlChar **namespaces,
+                    int nb_attributes,
+                    int nb_defaulted,
+                    const xmlChar **attributes)
+{
+	SoapToJsonState *state = ctx;
+	const gchar *name = (const gchar *) localname;
+	GString *out = state->output.buffer;
+	SoapToJsonFrame *parent;
+	gboolean is_array;
+
+	state->depth++;
+
+	if (state->body_depth <= 0)
+	{
+		if (state->body_depth == 0 && state->depth == 2 &&
+		    strcmp (name, "Body") == 0)
+		{
+			state->body_depth = state->depth;
+			g_string_append_c (out, '{');
+			soap_frame_push (state, TRUE);
+		}
+		return;
+	}
+
+	parent = soap_frame_top (state);
+	g_string_truncate (state->text, 0);
+
+	if (!parent->opened)
+	{
+		g_string_append_c (out, '{');
+		parent->opened = TRUE;
+	}
+
+	is_array = g_hash_table_contains (state->array_elements, name);
+
+	if (is_array && g_strcmp0 (parent->array_name, name) == 0)
+		g_string_append_c (out, ',');
+	else
+	{
+		soap_frame_close_array (state, parent);
+
+		if (parent->has_members)
+			g_string_append_c (out, ',');
+		parent->has_members = TRUE;
+
+		append_json_string (out, name, strlen (name));
+		g_string_append_c (out, ':');
+
+		if (is_array)
+		{
+			g_string_append_c (out, '[');
+			parent->array_name = g_strdup (name);
+		}
+	}
+
+	soap_frame_push (state, FALSE);
+}
+
+static void
+soap_end_element (void *ctx,
+                  const xmlChar *localname,
+                  const xmlChar *prefix,
+                  const xmlChar *uri)
+{
+	SoapToJsonState *state = ctx;
+	GString *out = state->output.buffer;
+	SoapToJsonFrame *frame;
+
+	if (state->body_depth <= 0)
+	{
+		state->depth--;
+		return;
+	}
+
+	frame = soap_frame_top (state);
+
+	if (frame->opened)
+	{
+		soap_frame_close_array (state, frame);
+		g_string_append_c (out, '}');
+	}
+	else
+		append_json_string (out, state->text->str, state->text->len);
+
+	g_array_set_size (state->frames, state->frames->len - 1);
+
+	/* Leaving the Body closes the document; nothing after it is read */
+	if (state->depth == state->body_depth)
+		state->body_depth = -1;
+
+	state->depth--;
+
+	output_flush (&state->output, FALSE);
+}
+
+static void
+soap_characters (void *ctx,
+                 const xmlChar *ch,
+                 int len)
+{
+	SoapToJsonState *state = ctx;
+
+	/* Mixed content is dropped once an element turns out to be an object */
+	if (state->body_depth > 0 && state->depth > state->body_depth &&
+	    !soap_frame_top (state)->opened)
+		g_string_append_len (state->text, (const gchar *) ch, len);
+}
+
+
+/* JSON to SOAP.  A hand-written lexer works character by character, so a
+ * token may straddle any number of chunks of the input body.
+ */
+
+static void
+json_set_error (JsonToSoapState *state,
+                gint code,
+                const gchar *message)
+{
+	if (state->error == NULL)
+		g_set_error_literal (&state->error, SOUP_SOAP_JSON_TRANSCODER_ERROR,
+		                     code, message);
+}
+
+static JsonToSoapFrame *
+json_frame_top (JsonToSoapState *state)
+{
+	return &g_array_index (state->frames, JsonToSoapFrame, state->frames->len - 1);
+}
+
+static void
+json_frame_push (JsonToSoapState *state,
+                 JsonFrameType type,
+                 const gchar *name)
+{
+	JsonToSoapFrame frame = { type,
+	                          type == JSON_FRAME_OBJECT ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE,
+	                          g_strdup (name), NULL };
+
+	g_array_append_val (state->frames, frame);
+}
+
+static void
+json_frame_pop (JsonToSoapState *state)
+{
+	JsonToSoapFrame *frame = json_frame_top (state);
+
+	g_free (frame->name);
+	g_free (frame->key);
+	g_array_set_size (state->frames, state->frames->len - 1);
+
+	frame = json_frame_top (state);
+	frame->expect = frame->type == JSON_FRAME_TOP ? JSON_EXPECT_NOTHING : JSON_EXPECT_COMMA;
+}
+
+/* Returns the element name a value in the current position maps to, or
+ * NULL (with the error set) when no value is acceptable here.
+ */
+static const gchar *
+json_value_name (JsonToSoapState *state,
+                 gboolean is_object)
+{
+	JsonToSoapFrame *frame = json_frame_top (state);
+
+	if (frame->expect != JSON_EXPECT_VALUE)
+	{
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Unexpected value"));
+		return NULL;
+	}
+
+	switch (frame->type)
+	{
+		case JSON_FRAME_TOP:
+			/* The document must be an object whose members are the
+			 * Body's children.
+			 */
+			if (!is_object)
+			{
+				json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+				                _("Document is not an object"));
+				return NULL;
+			}
+			return "";
+		case JSON_FRAME_OBJECT:
+			return frame->key;
+		default:
+			return frame->name;
+	}
+}
+
+static void
+json_value_done (JsonToSoapState *state)
+{
+	JsonToSoapFrame *frame = json_frame_top (state);
+
+	frame->expect = frame->type == JSON_FRAME_TOP ? JSON_EXPECT_NOTHING : JSON_EXPECT_COMMA;
+}
+
+static void
+json_scalar (JsonToSoapState *state,
+             const gchar *text,
+             gsize length,
+             gboolean is_null)
+{
+	GString *out = state->output.buffer;
+	const gchar *name = json_value_name (state, FALSE);
+
+	if (name == NULL)
+		return;
+
+	if (is_null)
+		g_string_append_printf (out, "<%s/>", name);
+	else
+	{
+		g_string_append_printf (out, "<%s>", name);
+		append_xml_text (out, text, length);
+		g_string_append_printf (out, "</%s>", name);
+	}
+
+	json_value_done (state);
+	output_flush (&state->output, FALSE);
+}
+
+/* The characters XML 1.0 documents may carry at all */
+static gboolean
+is_xml_char (gunichar c)
+{
+	return c == '\t' || c == '\n' || c == '\r' ||
+	       (c >= 0x20 && c < 0xd800) ||
+	       (c >= 0xe000 && c < 0xfffe) ||
+	       (c >= 0x10000 && c < 0x110000);
+}
+
+static gboolean
+json_literal_is_number (const gchar *text)
+{
+	gchar *end;
+
+	if (!(g_ascii_isdigit (*text) || *text == '-'))
+		return FALSE;
+
+	g_ascii_strtod (text, &end);
+
+	return *end == '\0';
+}
+
+static void
+json_literal (JsonToSoapState *state)
+{
+	const gchar *text = state->token->str;
+
+	if (strcmp (text, "true") == 0 || strcmp (text, "false") == 0 ||
+	    json_literal_is_number (text))
+		json_scalar (state, text, state->token->len, FALSE);
+	else if (strcmp (text, "null") == 0)
+		json_scalar (state, NULL, 0, TRUE);
+	else
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Invalid literal"));
+
+	g_string_truncate (state->token, 0);
+}
+
+static void
+json_string (JsonToSoapState *state)
+{
+	JsonToSoapFrame *frame = json_frame_top (state);
+	const gchar *p, *end = state->token->str + state->token->len;
+
+	if (state->high_surrogate)
+	{
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Unpaired surrogate"));
+		return;
+	}
+
+	if (!g_utf8_validate (state->token->str, state->token->len, NULL))
+	{
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("String is not valid UTF-8"));
+		return;
+	}
+
+	/* Unescaped text may still hold what XML cannot */
+	for (p = state->token->str; p < end; p = g_utf8_next_char (p))
+	{
+		if (!is_xml_char (g_utf8_get_char (p)))
+		{
+			json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+			                _("Character cannot be represented in XML"));
+			return;
+		}
+	}
+
+	if (frame->type == JSON_FRAME_OBJECT && frame->expect == JSON_EXPECT_KEY)
+	{
+		if (xmlValidateNCName (BAD_CAST state->token->str, 0) != 0)
+		{
+			json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_NAME,
+			                _("Member name is not a valid element name"));
+			return;
+		}
+
+		g_free (frame->key);
+		frame->key = g_strdup (state->token->str);
+		frame->expect = JSON_EXPECT_COLON;
+	}
+	else
+		json_scalar (state, state->token->str, state->token->len, FALSE);
+
+	g_string_truncate (state->token, 0);
+}
+
+static void
+json_punctuation (JsonToSoapState *state,
+                  gchar c)
+{
+	JsonToSoapFrame *frame = json_frame_top (state);
+	GString *out = state->output.buffer;
+	const gchar *name;
+
+	switch (c)
+	{
+		case '{':
+			if ((name = json_value_name (state, TRUE)) == NULL)
+				return;
+			if (*name)
+				g_string_append_printf (out, "<%s>", name);
+			json_frame_push (state, JSON_FRAME_OBJECT, name);
+			return;
+		case '[':
+			if ((name = json_value_name (state, FALSE)) == NULL)
+				return;
+			json_frame_push (state, JSON_FRAME_ARRAY, name);
+			return;
+		case '}':
+			if (frame->type != JSON_FRAME_OBJECT ||
+			    (frame->expect != JSON_EXPECT_KEY && frame->expect != JSON_EXPECT_COMMA))
+				break;
+			if (*frame->name)
+				g_string_append_printf (out, "</%s>", frame->name);
+			json_frame_pop (state);
+			output_flush (&state->output, FALSE);
+			return;
+		case ']':
+			if (frame->type != JSON_FRAME_ARRAY ||
+			    (frame->expect != JSON_EXPECT_VALUE && frame->expect != JSON_EXPECT_COMMA))
+				break;
+			json_frame_pop (state);
+			return;
+		case ':':
+			if (frame->expect != JSON_EXPECT_COLON)
+				break;
+			frame->expect = JSON_EXPECT_VALUE;
+			return;
+		case ',':
+			if (frame->expect != JSON_EXPECT_COMMA)
+				break;
+			frame->expect = frame->type == JSON_FRAME_OBJECT ?
+				JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+			return;
+	}
+
+	json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+	                _("Unexpected character"));
+}
+
+static gint
+hex_value (gchar c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static void
+json_unicode_done (JsonToSoapState *state)
+{
+	gunichar c = state->unicode;
+
+	if (state->high_surrogate && !(c >= 0xdc00 && c < 0xe000))
+	{
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Unpaired surrogate"));
+		return;
+	}
+
+	if (c >= 0xd800 && c < 0xdc00)
+	{
+		state->high_surrogate = c;
+		return;
+	}
+
+	if (c >= 0xdc00 && c < 0xe000)
+	{
+		if (state->high_surrogate == 0)
+		{
+			json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+			                _("Unpaired surrogate"));
+			return;
+		}
+
+		c = 0x10000 + ((state->high_surrogate - 0xd800) << 10) + (c - 0xdc00);
+		state->high_surrogate = 0;
+	}
+
+	if (!is_xml_char (c))
+	{
+		json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Character cannot be represented in XML"));
+		return;
+	}
+
+	g_string_append_unichar (state->token, c);
+}
+
+static void
+json_feed (JsonToSoapState *state,
+           const gchar *data,
+           gsize length)
+{
+	const gchar *p, *end = data + length;
+
+	for (p = data; p < end && state->error == NULL; p++)
+	{
+		gchar c = *p;
+
+		switch (state->lex_state)
+		{
+			case JSON_LEX_STRING:
+				if (state->high_surrogate && c != '\\')
+				{
+					json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+					                _("Unpaired surrogate"));
+				}
+				else if (c == '"')
+				{
+					state->lex_state = JSON_LEX_NONE;
+					json_string (state);
+				}
+				else if (c == '\\')
+					state->lex_state = JSON_LEX_ESCAPE;
+				else if ((guchar) c < 0x20)
+					json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+					                _("Control character in string"));
+				else
+					g_string_append_c (state->token, c);
+				continue;
+			case JSON_LEX_ESCAPE:
+				state->lex_state = JSON_LEX_STRING;
+				if (state->high_surrogate && c != 'u')
+				{
+					json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+					                _("Unpaired surrogate"));
+					continue;
+				}
+				switch (c)
+				{
+					case '"':
+					case '\\':
+					case '/':
+						g_string_append_c (state->token, c);
+						break;
+					case 'b':
+					case 'f':
+						json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+						                _("Character cannot be represented in XML"));
+						break;
+					case 'n':
+						g_string_append_c (state->token, '\n');
+						break;
+					case 'r':
+						g_string_append_c (state->token, '\r');
+						break;
+					case 't':
+						g_string_append_c (state->token, '\t');
+						break;
+					case 'u':
+						state->lex_state = JSON_LEX_UNICODE;
+						state->unicode = 0;
+						state->unicode_digits = 0;
+						break;
+					default:
+						json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+						                _("Invalid escape sequence"));
+						break;
+				}
+				continue;
+			case JSON_LEX_UNICODE:
+				if (hex_value (c) < 0)
+				{
+					json_set_error (state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+					                _("Invalid escape sequence"));
+					continue;
+				}
+				state->unicode = (state->unicode << 4) | hex_value (c);
+				if (++state->unicode_digits == 4)
+				{
+					state->lex_state = JSON_LEX_STRING;
+					json_unicode_done (state);
+				}
+				continue;
+			case JSON_LEX_LITERAL:
+				if (g_ascii_isalnum (c) || c == '+' || c == '-' || c == '.')
+				{
+					g_string_append_c (state->token, c);
+					continue;
+				}
+				state->lex_state = JSON_LEX_NONE;
+				json_literal (state);
+				if (state->error)
+					continue;
+				break;
+			default:
+				break;
+		}
+
+		switch (c)
+		{
+			case ' ':
+			case '\t':
+			case '\n':
+			case '\r':
+				break;
+			case '"':
+				state->lex_state = JSON_LEX_STRING;
+				break;
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ':':
+			case ',':
+				json_punctuation (state, c);
+				break;
+			default:
+				state->lex_state = JSON_LEX_LITERAL;
+				g_string_append_c (state->token, c);
+				break;
+		}
+	}
+}
+
+
+GQuark
+soup_soap_json_transcoder_error_quark (void)
+{
+	return g_quark_from_static_string ("soup-soap-json-transcoder-error-quark");
+}
+
+
+G_DEFINE_TYPE (SoupSoapJsonTranscoder, soup_soap_json_transcoder, G_TYPE_OBJECT);
+
+static void
+soup_soap_json_transcoder_init (SoupSoapJsonTranscoder *object)
+{
+	object->priv = SOUP_SOAP_JSON_TRANSCODER_GET_PRIVATE (object);
+	SoupSoapJsonTranscoderPrivate *priv = object->priv;
+
+	priv->array_elements = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                              g_free, NULL);
+}
+
+static void
+soup_soap_json_transcoder_finalize (GObject *object)
+{
+	SoupSoapJsonTranscoder *transcoder = SOUP_SOAP_JSON_TRANSCODER (object);
+	SoupSoapJsonTranscoderPrivate *priv = transcoder->priv;
+
+	g_hash_table_unref (priv->array_elements);
+
+	G_OBJECT_CLASS (soup_soap_json_transcoder_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_json_transcoder_class_init (SoupSoapJsonTranscoderClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (SoupSoapJsonTranscoderPrivate));
+
+	object_class->finalize = soup_soap_json_transcoder_finalize;
+
+	xmlInitParser ();
+}
+
+
+SoupSoapJsonTranscoder *
+soup_soap_json_transcoder_new (void)
+{
+	return g_object_new (SOUP_SOAP_TYPE_JSON_TRANSCODER, NULL);
+}
+
+/* Elements named name always become JSON arrays, even when they occur
+ * once, and consecutive ones are gathered into the same array.  Other
+ * elements become plain members.  Configure the transcoder before sharing
+ * it between threads.
+ *
+ * Repeated elements that are not registered here, and registered ones
+ * separated by other elements, are written as repeated members of the
+ * same object; the JSON stays valid but most readers keep only the last
+ * of them.
+ */
+void
+soup_soap_json_transcoder_add_array_element (SoupSoapJsonTranscoder *transcoder,
+                                             const gchar *name)
+{
+	g_return_if_fail (SOUP_SOAP_IS_JSON_TRANSCODER (transcoder));
+	g_return_if_fail (name != NULL && *name != '\0');
+
+	g_hash_table_add (transcoder->priv->array_elements, g_strdup (name));
+}
+
+gboolean
+soup_soap_json_transcoder_is_array_element (SoupSoapJsonTranscoder *transcoder,
+                                            const gchar *name)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_JSON_TRANSCODER (transcoder), FALSE);
+	g_return_val_if_fail (name != NULL, FALSE);
+
+	return g_hash_table_contains (transcoder->priv->array_elements, name);
+}
+
+/* Writes the children of the SOAP Body in soap_body as one JSON object
+ * appended to json_body.  Leaves become strings and elements with
+ * children become objects.  The body must already be decoded.  On
+ * failure json_body is left incomplete and should be discarded.
+ */
+gboolean
+soup_soap_json_transcoder_soap_to_json (SoupSoapJsonTranscoder *transcoder,
+                                        SoupMessageBody *soap_body,
+                                        SoupMessageBody *json_body,
+                                        GError **error)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_JSON_TRANSCODER (transcoder), FALSE);
+	g_return_val_if_fail (soap_body != NULL, FALSE);
+	g_return_val_if_fail (json_body != NULL, FALSE);
+
+	SoapToJsonState state;
+	xmlSAXHandler sax;
+	xmlParserCtxtPtr ctxt;
+	SoupBuffer *chunk;
+	goffset offset = 0;
+	gboolean success = TRUE;
+	guint i;
+
+	memset (&sax, 0, sizeof (sax));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = soap_start_element;
+	sax.endElementNs = soap_end_element;
+	sax.characters = soap_characters;
+
+	state.array_elements = transcoder->priv->array_elements;
+	output_init (&state.output, json_body);
+	state.frames = g_array_new (FALSE, FALSE, sizeof (SoapToJsonFrame));
+	state.text = g_string_new (NULL);
+	state.depth = 0;
+	state.body_depth = 0;
+
+	/* No tree is built; only the callbacks above see the document */
+	ctxt = xmlCreatePushParserCtxt (&sax, &state, NULL, 0, NULL);
+	xmlCtxtUseOptions (ctxt, XML_PARSE_NONET);
+
+	while (success &&
+	       (chunk = soup_message_body_get_chunk (soap_body, offset)) != NULL)
+	{
+		success = xmlParseChunk (ctxt, chunk->data, chunk->length, 0) == 0;
+		offset += chunk->length;
+		soup_buffer_free (chunk);
+	}
+
+	if (success)
+		success = xmlParseChunk (ctxt, NULL, 0, 1) == 0;
+
+	success = success && ctxt->wellFormed && state.body_depth == -1;
+	xmlFreeParserCtxt (ctxt);
+
+	if (!success)
+		g_set_error_literal (error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+		                     _("Message body is not a SOAP envelope"));
+
+	for (i = 0; i < state.frames->len; i++)
+		g_free (g_array_index (state.frames, SoapToJsonFrame, i).array_name);
+	g_array_unref (state.frames);
+	g_string_free (state.text, TRUE);
+	output_finish (&state.output, success);
+
+	return success;
+}
+
+/* Writes a SOAP envelope to soap_body whose Body holds one element per
+ * member of the JSON object in json_body.  Arrays become repeated
+ * elements, null becomes an empty element, and numbers and booleans are
+ * written as they appear.  On failure soap_body is left incomplete and
+ * should be discarded.
+ */
+gboolean
+soup_soap_json_transcoder_json_to_soap (SoupSoapJsonTranscoder *transcoder,
+                                        SoupMessageBody *json_body,
+                                        SoupMessageBody *soap_body,
+                                        GError **error)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_JSON_TRANSCODER (transcoder), FALSE);
+	g_return_val_if_fail (json_body != NULL, FALSE);
+	g_return_val_if_fail (soap_body != NULL, FALSE);
+
+	JsonToSoapState state;
+	SoupBuffer *chunk;
+	goffset offset = 0;
+	guint i;
+
+	output_init (&state.output, soap_body);
+	state.frames = g_array_new (FALSE, FALSE, sizeof (JsonToSoapFrame));
+	state.lex_state = JSON_LEX_NONE;
+	state.token = g_string_new (NULL);
+	state.unicode = 0;
+	state.unicode_digits = 0;
+	state.high_surrogate = 0;
+	state.error = NULL;
+
+	json_frame_push (&state, JSON_FRAME_TOP, NULL);
+	g_string_append (state.output.buffer, ENVELOPE_START);
+
+	while (state.error == NULL &&
+	       (chunk = soup_message_body_get_chunk (json_body, offset)) != NULL)
+	{
+		json_feed (&state, chunk->data, chunk->length);
+		offset += chunk->length;
+		soup_buffer_free (chunk);
+	}
+
+	if (state.error == NULL && state.lex_state == JSON_LEX_LITERAL)
+	{
+		state.lex_state = JSON_LEX_NONE;
+		json_literal (&state);
+	}
+
+	if (state.error == NULL &&
+	    (state.lex_state != JSON_LEX_NONE ||
+	     json_frame_top (&state)->expect != JSON_EXPECT_NOTHING))
+		json_set_error (&state, SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+		                _("Unexpected end of document"));
+
+	if (state.error == NULL)
+		g_string_append (state.output.buffer, ENVELOPE_END);
+	else
+		g_propagate_error (error, state.error);
+
+	for (i = 0; i < state.frames->len; i++)
+	{
+		g_free (g_array_index (state.frames, JsonToSoapFrame, i).name);
+		g_free (g_array_index (state.frames, JsonToSoapFrame, i).key);
+	}
+	g_array_unref (state.frames);
+	g_string_free (state.token, TRUE);
+	output_finish (&state.output, state.error == NULL);
+
+	return state.error == NULL;
+}
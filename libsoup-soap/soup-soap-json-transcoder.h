@@ -0,0 +1,70 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_JSON_TRANSCODER_H_
+#define _SOUP_SOAP_JSON_TRANSCODER_H_
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_JSON_TRANSCODER             (soup_soap_json_transcoder_get_type ())
+#define SOUP_SOAP_JSON_TRANSCODER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_JSON_TRANSCODER, SoupSoapJsonTranscoder))
+#define SOUP_SOAP_JSON_TRANSCODER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_JSON_TRANSCODER, SoupSoapJsonTranscoderClass))
+#define SOUP_SOAP_IS_JSON_TRANSCODER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_JSON_TRANSCODER))
+#define SOUP_SOAP_IS_JSON_TRANSCODER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_JSON_TRANSCODER))
+#define SOUP_SOAP_JSON_TRANSCODER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_JSON_TRANSCODER, SoupSoapJsonTranscoderClass))
+
+typedef struct _SoupSoapJsonTranscoderPrivate SoupSoapJsonTranscoderPrivate;
+typedef struct _SoupSoapJsonTranscoderClass SoupSoapJsonTranscoderClass;
+typedef struct _SoupSoapJsonTranscoder SoupSoapJsonTranscoder;
+
+struct _SoupSoapJsonTranscoderClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapJsonTranscoder
+{
+	GObject parent_instance;
+
+	SoupSoapJsonTranscoderPrivate *priv;
+};
+
+GType soup_soap_json_transcoder_get_type (void) G_GNUC_CONST;
+SoupSoapJsonTranscoder *soup_soap_json_transcoder_new (void);
+void soup_soap_json_transcoder_add_array_element (SoupSoapJsonTranscoder *transcoder, const gchar *name);
+gboolean soup_soap_json_transcoder_is_array_element (SoupSoapJsonTranscoder *transcoder, const gchar *name);
+gboolean soup_soap_json_transcoder_soap_to_json (SoupSoapJsonTranscoder *transcoder, SoupMessageBody *soap_body, SoupMessageBody *json_body, GError **error);
+gboolean soup_soap_json_transcoder_json_to_soap (SoupSoapJsonTranscoder *transcoder, SoupMessageBody *json_body, SoupMessageBody *soap_body, GError **error);
+
+typedef enum
+{
+	SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_JSON,
+	SOUP_SOAP_JSON_TRANSCODER_ERROR_INVALID_NAME
+} SoupSoapJsonTranscoderError;
+
+#define SOUP_SOAP_JSON_TRANSCODER_ERROR soup_soap_json_transcoder_error_quark()
+
+GQuark soup_soap_json_transcoder_error_quark (void);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_JSON_TRANSCODER_H_ */
@@ -0,0 +1,471 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Latency histograms per operation.  Buckets are log-linear, as in
+ * HdrHistogram: exact below 64 microseconds, then 32 buckets for each
+ * power of two, so a recorded value is off by at most about 3%.  Like
+ * the counters in soup-soap-stats.c, each thread records into its own
+ * histograms under a sequence count and snapshots merge them, so
+ * recording never takes a lock.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#define SUB_BUCKET_BITS  6
+#define SUB_BUCKET_HALF  (1 << (SUB_BUCKET_BITS - 1))
+#define N_BUCKETS        ((32 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF)
+
+/* Longer durations, about 71 minutes, land in the last bucket */
+#define MAX_VALUE        G_MAXUINT32
+
+typedef struct
+{
+	guint64 count;
+	guint64 sum;
+	guint64 max;
+	guint64 buckets[N_BUCKETS];
+} Histogram;
+
+typedef struct _OperationHistograms OperationHistograms;
+
+struct _OperationHistograms
+{
+	OperationHistograms *next;
+	gchar *operation;
+	Histogram stages[SOUP_SOAP_LATENCY_N_STAGES];
+};
+
+/* Operations are only ever prepended, so readers holding the registry
+ * lock can walk the list while the owning thread adds to it.
+ */
+typedef struct
+{
+	volatile gint sequence;
+	gint generation;
+	OperationHistograms *operations;
+} LatencySlot;
+
+struct _SoupSoapLatencySnapshot
+{
+	GHashTable *operations;
+};
+
+static GMutex latency_lock;
+static GSList *latency_slots = NULL;
+static GHashTable *latency_retired = NULL;
+
+/* Bumped by reset; histograms of an older generation count as empty */
+static volatile gint latency_generation = 0;
+
+static void latency_slot_free (gpointer data);
+
+static GPrivate latency_slot = G_PRIVATE_INIT (latency_slot_free);
+
+
+static guint
+bucket_index (guint64 value)
+{
+	guint shift;
+
+	if (value > MAX_VALUE)
+		value = MAX_VALUE;
+
+	if (value < 2 * SUB_BUCKET_HALF)
+		return value;
+
+	shift = g_bit_nth_msf ((gulong) value, -1) - (SUB_BUCKET_BITS - 1);
+
+	return shift * SUB_BUCKET_HALF + (value >> shift);
+}
+
+/* Highest value that falls in the bucket */
+static guint64
+bucket_upper_value (guint index)
+{
+	guint shift, sub_bucket;
+
+	if (index < 2 * SUB_BUCKET_HALF)
+		return index;
+
+	shift = index / SUB_BUCKET_HALF - 1;
+	sub_bucket = index % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+
+	return (((guint64) sub_bucket + 1) << shift) - 1;
+}
+
+static void
+histogram_record (Histogram *histogram,
+                  guint64 value)
+{
+	histogram->count++;
+	histogram->sum += value;
+	histogram->max = MAX (histogram->max, value);
+	histogram->buckets[bucket_index (value)]++;
+}
+
+static void
+histogram_merge (Histogram *total,
+                 const Histogram *histogram)
+{
+	guint i;
+
+	if (histogram->count == 0)
+		return;
+
+	total->count += histogram->count;
+	total->sum += histogram->sum;
+	total->max = MAX (total->max, histogram->max);
+
+	for (i = 0; i < N_BUCKETS; i++)
+		total->buckets[i] += histogram->buckets[i];
+}
+
+static OperationHistograms *
+operation_histograms_new (const gchar *operation)
+{
+	OperationHistograms *histograms = g_new0 (OperationHistograms, 1);
+
+	histograms->operation = g_strdup (operation);
+
+	return histograms;
+}
+
+static void
+operation_histograms_free (gpointer data)
+{
+	OperationHistograms *histograms = data;
+
+	g_free (histograms->operation);
+	g_free (histograms);
+}
+
+static void
+operation_histograms_merge (GHashTable *operations,
+                            const OperationHistograms *histograms)
+{
+	OperationHistograms *total;
+	guint stage;
+
+	total = g_hash_table_lookup (operations, histograms->operation);
+	if (total == NULL)
+	{
+		total = operation_histograms_new (histograms->operation);
+		g_hash_table_insert (operations, total->operation, total);
+	}
+
+	for (stage = 0; stage < SOUP_SOAP_LATENCY_N_STAGES; stage++)
+		histogram_merge (&total->stages[stage], &histograms->stages[stage]);
+}
+
+static GHashTable *
+operations_table_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal,
+	                              NULL, operation_histograms_free);
+}
+
+/* Folds the histograms of an exiting thread into the retired totals */
+static void
+latency_slot_free (gpointer data)
+{
+	LatencySlot *slot = data;
+	OperationHistograms *histograms, *next;
+
+	g_mutex_lock (&latency_lock);
+
+	latency_slots = g_slist_remove (latency_slots, slot);
+
+	for (histograms = slot->operations; histograms != NULL; histograms = next)
+	{
+		next = histograms->next;
+
+		if (slot->generation == g_atomic_int_get (&latency_generation))
+			operation_histograms_merge (latency_retired, histograms);
+
+		operation_histograms_free (histograms);
+	}
+
+	g_mutex_unlock (&latency_lock);
+
+	g_slice_free (LatencySlot, slot);
+}
+
+static LatencySlot *
+latency_get_slot (void)
+{
+	LatencySlot *slot = g_private_get (&latency_slot);
+
+	if (slot == NULL)
+	{
+		slot = g_slice_new0 (LatencySlot);
+		g_private_set (&latency_slot, slot);
+
+		g_mutex_lock (&latency_lock);
+		if (latency_retired == NULL)
+			latency_retired = operations_table_new ();
+		slot->generation = g_atomic_int_get (&latency_generation);
+		latency_slots = g_slist_prepend (latency_slots, slot);
+		g_mutex_unlock (&latency_lock);
+	}
+
+	return slot;
+}
+
+/* times holds a duration in microseconds for each stage, negative for
+ * stages that were not timed.
+ */
+void
+_soup_soap_latency_record (const gchar *operation,
+                           const gint64 *times)
+{
+	LatencySlot *slot = latency_get_slot ();
+	gint generation = g_atomic_int_get (&latency_generation);
+	OperationHistograms *histograms;
+	guint stage;
+
+	if (operation == NULL)
+		operation = "";
+
+	for (histograms = slot->operations;
+	     histograms != NULL;
+	     histograms = histograms->next)
+	{
+		if (strcmp (histograms->operation, operation) == 0)
+			break;
+	}
+
+	if (histograms == NULL)
+	{
+		histograms = operation_histograms_new (operation);
+		histograms->next = slot->operations;
+		g_atomic_pointer_set (&slot->operations, histograms);
+	}
+
+	g_atomic_int_inc (&slot->sequence);
+
+	if (slot->generation != generation)
+	{
+		OperationHistograms *stale;
+
+		for (stale = slot->operations; stale != NULL; stale = stale->next)
+			memset (stale->stages, 0, sizeof (stale->stages));
+
+		slot->generation = generation;
+	}
+
+	for (stage = 0; stage < SOUP_SOAP_LATENCY_N_STAGES; stage++)
+	{
+		if (times[stage] >= 0)
+			histogram_record (&histograms->stages[stage], times[stage]);
+	}
+
+	g_atomic_int_inc (&slot->sequence);
+}
+
+/* Takes a copy of the histograms recorded so far.  Recording carries on
+ * while the copy is taken.
+ */
+SoupSoapLatencySnapshot *
+soup_soap_latency_snapshot_new (void)
+{
+	SoupSoapLatencySnapshot *snapshot = g_slice_new (SoupSoapLatencySnapshot);
+	OperationHistograms *copy = g_new (OperationHistograms, 1);
+	GSList *slots;
+	gint generation;
+
+	snapshot->operations = operations_table_new ();
+
+	g_mutex_lock (&latency_lock);
+
+	generation = g_atomic_int_get (&latency_generation);
+
+	if (latency_retired)
+	{
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, latency_retired);
+		while (g_hash_table_iter_next (&iter, NULL, &value))
+			operation_histograms_merge (snapshot->operations, value);
+	}
+
+	for (slots = latency_slots; slots != NULL; slots = g_slist_next (slots))
+	{
+		LatencySlot *slot = slots->data;
+		OperationHistograms *histograms;
+		gint sequence, slot_generation;
+
+		for (histograms = g_atomic_pointer_get (&slot->operations);
+		     histograms != NULL;
+		     histograms = histograms->next)
+		{
+			do
+			{
+				sequence = g_atomic_int_get (&slot->sequence);
+				slot_generation = slot->generation;
+				memcpy (copy->stages, histograms->stages,
+				        sizeof (copy->stages));
+			} while ((sequence & 1) ||
+			         sequence != g_atomic_int_get (&slot->sequence));
+
+			if (slot_generation != generation)
+				break;
+
+			copy->operation = histograms->operation;
+			operation_histograms_merge (snapshot->operations, copy);
+		}
+	}
+
+	g_mutex_unlock (&latency_lock);
+
+	g_free (copy);
+
+	return snapshot;
+}
+
+void
+soup_soap_latency_snapshot_free (SoupSoapLatencySnapshot *snapshot)
+{
+	g_return_if_fail (snapshot != NULL);
+
+	g_hash_table_destroy (snapshot->operations);
+	g_slice_free (SoupSoapLatencySnapshot, snapshot);
+}
+
+/* Returns the names of the operations in the snapshot, owned by it */
+GList *
+soup_soap_latency_snapshot_get_operations (SoupSoapLatencySnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+
+	return g_hash_table_get_keys (snapshot->operations);
+}
+
+static const Histogram *
+snapshot_get_histogram (SoupSoapLatencySnapshot *snapshot,
+                        const gchar *operation,
+                        SoupSoapLatencyStage stage)
+{
+	OperationHistograms *histograms;
+
+	histograms = g_hash_table_lookup (snapshot->operations,
+	                                  operation ? operation : "");
+
+	return histograms ? &histograms->stages[stage] : NULL;
+}
+
+guint64
+soup_soap_latency_snapshot_get_count (SoupSoapLatencySnapshot *snapshot,
+                                      const gchar *operation,
+                                      SoupSoapLatencyStage stage)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (stage < SOUP_SOAP_LATENCY_N_STAGES, 0);
+
+	const Histogram *histogram =
+		snapshot_get_histogram (snapshot, operation, stage);
+
+	return histogram ? histogram->count : 0;
+}
+
+gint64
+soup_soap_latency_snapshot_get_mean (SoupSoapLatencySnapshot *snapshot,
+                                     const gchar *operation,
+                                     SoupSoapLatencyStage stage)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (stage < SOUP_SOAP_LATENCY_N_STAGES, 0);
+
+	const Histogram *histogram =
+		snapshot_get_histogram (snapshot, operation, stage);
+
+	if (histogram == NULL || histogram->count == 0)
+		return 0;
+
+	return histogram->sum / histogram->count;
+}
+
+gint64
+soup_soap_latency_snapshot_get_max (SoupSoapLatencySnapshot *snapshot,
+                                    const gchar *operation,
+                                    SoupSoapLatencyStage stage)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (stage < SOUP_SOAP_LATENCY_N_STAGES, 0);
+
+	const Histogram *histogram =
+		snapshot_get_histogram (snapshot, operation, stage);
+
+	return histogram ? histogram->max : 0;
+}
+
+/* Returns the duration, in microseconds, that percentile percent of the
+ * calls did not exceed; 99.9 gives the 99.9th percentile.
+ */
+gint64
+soup_soap_latency_snapshot_get_percentile (SoupSoapLatencySnapshot *snapshot,
+                                           const gchar *operation,
+                                           SoupSoapLatencyStage stage,
+                                           gdouble percentile)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (stage < SOUP_SOAP_LATENCY_N_STAGES, 0);
+	g_return_val_if_fail (percentile >= 0.0 && percentile <= 100.0, 0);
+
+	const Histogram *histogram =
+		snapshot_get_histogram (snapshot, operation, stage);
+	guint64 target, seen = 0;
+	guint i;
+
+	if (histogram == NULL || histogram->count == 0)
+		return 0;
+
+	target = (guint64) (percentile / 100.0 * histogram->count + 0.5);
+	target = CLAMP (target, 1, histogram->count);
+
+	for (i = 0; i < N_BUCKETS; i++)
+	{
+		seen += histogram->buckets[i];
+		if (seen >= target)
+			break;
+	}
+
+	return MIN (bucket_upper_value (i), histogram->max);
+}
+
+/* Drops everything recorded so far.  Threads clear their own histograms
+ * the next time they record, so this does not wait for them.
+ */
+void
+soup_soap_latency_reset (void)
+{
+	g_mutex_lock (&latency_lock);
+
+	g_atomic_int_inc (&latency_generation);
+	if (latency_retired)
+		g_hash_table_remove_all (latency_retired);
+
+	g_mutex_unlock (&latency_lock);
+}
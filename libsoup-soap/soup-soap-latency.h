@@ -0,0 +1,53 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_LATENCY_H_
+#define _SOUP_SOAP_LATENCY_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Stages of a call made with SoupSoapClient, each timed separately */
+typedef enum
+{
+	SOUP_SOAP_LATENCY_STAGE_PERSIST,     /* building the request body */
+	SOUP_SOAP_LATENCY_STAGE_SEND,        /* until the request is written */
+	SOUP_SOAP_LATENCY_STAGE_FIRST_BYTE,  /* until the response headers */
+	SOUP_SOAP_LATENCY_STAGE_RECEIVE,     /* until the response body */
+	SOUP_SOAP_LATENCY_STAGE_PARSE,       /* parsing the response */
+	SOUP_SOAP_LATENCY_STAGE_TOTAL,       /* the whole call */
+
+	SOUP_SOAP_LATENCY_N_STAGES
+} SoupSoapLatencyStage;
+
+typedef struct _SoupSoapLatencySnapshot SoupSoapLatencySnapshot;
+
+SoupSoapLatencySnapshot *soup_soap_latency_snapshot_new (void);
+void soup_soap_latency_snapshot_free (SoupSoapLatencySnapshot *snapshot);
+GList *soup_soap_latency_snapshot_get_operations (SoupSoapLatencySnapshot *snapshot);
+guint64 soup_soap_latency_snapshot_get_count (SoupSoapLatencySnapshot *snapshot, const gchar *operation, SoupSoapLatencyStage stage);
+gint64 soup_soap_latency_snapshot_get_mean (SoupSoapLatencySnapshot *snapshot, const gchar *operation, SoupSoapLatencyStage stage);
+gint64 soup_soap_latency_snapshot_get_max (SoupSoapLatencySnapshot *snapshot, const gchar *operation, SoupSoapLatencyStage stage);
+gint64 soup_soap_latency_snapshot_get_percentile (SoupSoapLatencySnapshot *snapshot, const gchar *operation, SoupSoapLatencyStage stage, gdouble percentile);
+void soup_soap_latency_reset (void);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_LATENCY_H_ */
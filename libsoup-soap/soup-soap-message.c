@@ -20,9 +20,15 @@
 #include <config.h>
 #include <glib/gi18n.h>
 
+#include <string.h>
+
 #include <libsoup/soup.h>
 #include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+#include <libsoup-soap/soup-soap-probes.h>
 
+#include <libxml/parser.h>
+#include <libxml/xmlsave.h>
 #include <libxml/tree.h>
 
 #define XSD_NAMESPACE "http://www.w3.org/1999/XMLSchema"
@@ -32,12 +38,32 @@
 
 #define SOAP_ENCODING_STYLE "http://schemas.xmlsoap.org/soap/encoding/"
 
+#define CONVERT_BUFFER_SIZE 16384
+
+/* Chunks a streaming persist may have queued but not yet written */
+#define STREAM_WINDOW_CHUNKS 4
+
 struct _SoupSoapMessagePrivate
 {
 	SoupSoapParamGroup *header;
 	SoupSoapParamGroup *body;
+	gboolean has_operation;
 	SoupMessageHeaders *message_headers;
 	SoupMessageBody *message_body;
+	SoupSoapContentEncoding content_encoding;
+	SoupSoapWireFormat wire_format;
+	SoupSoapSchema *schema;
+	GPtrArray *paths;
+	GError *parse_error;
+	GCancellable *cancellable;
+	SoupSoapMessageProducer producer;
+	gpointer producer_data;
+	GDestroyNotify producer_destroy;
+	SoupSoapMessageStats stats;
+	gsize memory_limit;
+	gsize memory_charged;
+	gsize memory_inflated;
+	SoupSoapStringPool *names;
 };
 
 #define SOUP_SOAP_MESSAGE_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_MESSAGE, SoupSoapMessagePrivate))
@@ -47,49 +73,238 @@ enum
 	PROP_0,
 
 	PROP_MESSAGE_HEADERS,
-	PROP_MESSAGE_BODY
+	PROP_MESSAGE_BODY,
+	PROP_CONTENT_ENCODING,
+	PROP_WIRE_FORMAT,
+	PROP_SCHEMA,
+	PROP_PATHS,
+	PROP_MEMORY_LIMIT
+};
+
+typedef struct
+{
+	SoupMessageHeaders *headers;
+	SoupMessageBody *body;
+	SoupMessage *msg;
+	SoupSoapSchema *schema;
+	GMainContext *context;
+} SoupSoapMessageParseData;
+
+typedef struct
+{
+	SoupMessageBody *body;
+	GConverter *converter;
+	gchar *buffer;
+	gsize buffer_len;
+	guint chunks;
+	gsize bytes;
+	GError *error;
+} SoupSoapMessagePersistSink;
+
+typedef struct
+{
+	SoupSoapParam *param;
+	GList *cursor;          /* next element to write */
+	const gchar *prefix;    /* inherited by unqualified elements */
+	xmlNsPtr declared;      /* declared on the element itself, or NULL */
+} SoupSoapMessageStreamFrame;
+
+enum
+{
+	STREAM_HEADER,
+	STREAM_BODY
 };
 
+/* A persist in progress, writing the tree as the body is sent */
+struct _SoupSoapMessageStream
+{
+	SoupSoapMessage *msg;
+	SoupSoapMessagePersistSink sink;
+	GHashTable *namespaces;
+	guint next_prefix;
+	xmlNodePtr envelope_node;
+	GArray *frames;
+	guint section;
+	gboolean producer_done;
+	guint records;
+	gboolean done;
+	gint64 wall_time;
+	gint64 cpu_time;
+
+	/* Used by soup_soap_message_persist_chunked() only */
+	SoupMessage *message;
+	gulong wrote_chunk_id;
+	guint chunks_written;
+};
+
+
+/* Declares every namespace used in the tree once, on the envelope, and
+ * maps each URI to its declaration.
+ */
+static void
+collect_namespaces (SoupSoapParam *param,
+                    xmlNodePtr envelope_node,
+                    GHashTable *namespaces)
+{
+	const gchar *namespace_uri = soup_soap_param_get_namespace_uri (param);
+	GList *elements;
+
+	if (namespace_uri && !g_hash_table_contains (namespaces, namespace_uri))
+	{
+		/* The four envelope namespaces are always present */
+		gchar *prefix = g_strdup_printf ("ns%u",
+		                                 g_hash_table_size (namespaces) - 3);
+
+		g_hash_table_insert (namespaces, (gpointer) namespace_uri,
+		                     xmlNewNs (envelope_node, BAD_CAST namespace_uri,
+		                               BAD_CAST prefix));
+		g_free (prefix);
+	}
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+		return;
+
+	for (elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		collect_namespaces (elements->data, envelope_node, namespaces);
+}
 
-xmlNodePtr
+static xmlNodePtr
 create_param_node (xmlDocPtr doc,
                    SoupSoapParam *param,
-                   xmlNodePtr parent_node)
+                   xmlNodePtr parent_node,
+                   GHashTable *namespaces)
 {
-	xmlNodePtr node = xmlNewChild (parent_node, NULL,
-	                               BAD_CAST soup_soap_param_get_name (param),
-	                               NULL);
+	const gchar *namespace_uri = soup_soap_param_get_namespace_uri (param);
+	gboolean is_group = SOUP_SOAP_IS_PARAM_GROUP (param);
+	/* xmlNewTextChild escapes the value itself, without an extra copy */
+	xmlNodePtr node = xmlNewTextChild (parent_node,
+	                                   namespace_uri ?
+	                                   g_hash_table_lookup (namespaces, namespace_uri) :
+	                                   NULL,
+	                                   BAD_CAST soup_soap_param_get_name (param),
+	                                   is_group ?
+	                                   NULL :
+	                                   BAD_CAST soup_soap_param_get_value (param));
+
+	GList *curr_element;
+
+	SOUP_SOAP_PROBE1 (param__serialize, node->name);
+
+	if (is_group)
+	{
+		for (curr_element = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+		     curr_element != NULL;
+		     curr_element = g_list_next (curr_element))
+			create_param_node (doc, curr_element->data, node, namespaces);
+	}
 
-	SoupSoapParam *param_child;
+	return node;
+}
 
-	if (SOUP_SOAP_IS_PARAM_GROUP (param))
-	{
-		GList *elements =
-			soup_soap_param_group_get_elements (SOUP_SOAP_PARAM_GROUP (param));
-		GList *curr_element = elements;
+/* Budgets are read atomically, since they may be changed while messages
+ * are parsed in worker threads.
+ */
+static volatile gsize default_memory_limit = 0;
+static volatile gsize global_memory_limit = 0;
+static volatile gsize global_memory_usage = 0;
 
-		while (curr_element)
-		{
-			param_child = curr_element->data;
+/* Charges size bytes to the message and to the process, failing the
+ * parse once either budget is exceeded.
+ */
+static gboolean
+memory_charge (SoupSoapMessagePrivate *priv,
+               gsize size)
+{
+	gsize global_limit = (gsize) g_atomic_pointer_get (&global_memory_limit);
+	gsize global_usage;
 
-			create_param_node (doc, param_child, node);
+	if (priv->parse_error)
+		return FALSE;
 
-			curr_element = g_list_next (curr_element);
-		}
+	priv->memory_charged += size;
+	global_usage = (gsize) g_atomic_pointer_add (&global_memory_usage, size) + size;
+
+	if (priv->memory_limit && priv->memory_charged > priv->memory_limit)
+	{
+		g_set_error (&priv->parse_error, SOUP_SOAP_MESSAGE_ERROR,
+		             SOUP_SOAP_MESSAGE_ERROR_TOO_LARGE,
+		             _("Message exceeds its memory limit of %" G_GSIZE_FORMAT " bytes"),
+		             priv->memory_limit);
+		return FALSE;
 	}
-	else
+
+	if (global_limit && global_usage > global_limit)
 	{
-		xmlChar *content = xmlEncodeEntitiesReentrant (doc,
-		                                               BAD_CAST soup_soap_param_get_value (param));
-		xmlNodeSetContent (node, content);
-		xmlFree (content);
+		g_set_error (&priv->parse_error, SOUP_SOAP_MESSAGE_ERROR,
+		             SOUP_SOAP_MESSAGE_ERROR_TOO_LARGE,
+		             _("Messages exceed the global memory limit of %" G_GSIZE_FORMAT " bytes"),
+		             global_limit);
+		return FALSE;
 	}
 
-	return node;
+	return TRUE;
 }
 
 static void
-parse_param (SoupSoapParamGroup *group,
+memory_release (SoupSoapMessagePrivate *priv,
+                gsize size)
+{
+	priv->memory_charged -= size;
+	g_atomic_pointer_add (&global_memory_usage, -(gssize) size);
+}
+
+/* Inflated data only lives while parsing, so parse_message() releases
+ * it again afterwards; charging it as it is produced is what stops a
+ * small compressed body from expanding without bound.
+ */
+static gboolean
+memory_charge_inflated (gsize size,
+                        gpointer user_data)
+{
+	SoupSoapMessagePrivate *priv = user_data;
+
+	if (priv->parse_error)
+		return FALSE;
+
+	priv->memory_inflated += size;
+
+	return memory_charge (priv, size);
+}
+
+static gboolean
+memory_charge_param (SoupSoapMessagePrivate *priv,
+                     SoupSoapParam *param)
+{
+	return memory_charge (priv, sizeof (GList) +
+	                      _soup_soap_param_tree_get_memory_usage (param, NULL));
+}
+
+/* Names read from a message are pooled for the parse instead of
+ * interned, so that a peer cannot grow the intern table without bound.
+ */
+static const gchar *
+pool_name (SoupSoapStringPool *names,
+           const xmlChar *name)
+{
+	return name && *name ?
+		_soup_soap_string_pool_add (names, (const gchar *) name) : NULL;
+}
+
+static SoupSoapParam *
+param_new_pooled (SoupSoapStringPool *names,
+                  GType type,
+                  const xmlChar *namespace_uri,
+                  const xmlChar *name)
+{
+	return _soup_soap_param_new_pooled (type, pool_name (names, namespace_uri),
+	                                    pool_name (names, name));
+}
+
+static gboolean
+parse_param (SoupSoapMessagePrivate *priv,
+             SoupSoapParamGroup *group,
              xmlNodePtr node)
 {
 	xmlNodePtr current_node, child_node;
@@ -120,22 +335,390 @@ parse_param (SoupSoapParamGroup *group,
 
 			if (have_element)
 			{
-				param_group =
-					soup_soap_param_group_new ((gchar *) current_node->name);
+				param_group = SOUP_SOAP_PARAM_GROUP (
+					param_new_pooled (priv->names, SOUP_SOAP_TYPE_PARAM_GROUP,
+					                  current_node->ns ? current_node->ns->href : NULL,
+					                  current_node->name));
 				soup_soap_param_group_add (group,
 				                           SOUP_SOAP_PARAM (param_group));
-				parse_param (param_group, current_node);
+				if (!memory_charge_param (priv, SOUP_SOAP_PARAM (param_group)) ||
+				    !parse_param (priv, param_group, current_node))
+					return FALSE;
 			}
 			else
 			{
-				temp = xmlNodeGetContent (current_node);
-				param = soup_soap_param_new_value ((gchar *) current_node->name,
-				                                   (gchar *) temp);
+				/* A single text child is by far the common case, and
+				 * its content can be used without concatenating.
+				 */
+				child_node = current_node->children;
+				if (child_node == NULL)
+					temp = NULL;
+				else if (child_node->next == NULL &&
+				         child_node->type == XML_TEXT_NODE)
+					temp = child_node->content;
+				else
+					temp = xmlNodeGetContent (current_node);
+
+				param = param_new_pooled (priv->names, SOUP_SOAP_TYPE_PARAM,
+				                          current_node->ns ? current_node->ns->href : NULL,
+				                          current_node->name);
+				soup_soap_param_set_value (param, temp ? (gchar *) temp : "");
 				soup_soap_param_group_add (group, param);
-				xmlFree (temp);
+				if (temp && temp != child_node->content)
+					xmlFree (temp);
+
+				if (!memory_charge_param (priv, param))
+					return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+
+static xmlDocPtr
+parse_body (SoupSoapMessagePrivate *priv)
+{
+	xmlParserCtxtPtr ctxt;
+	xmlDocPtr doc;
+	gboolean success;
+
+	ctxt = xmlCreatePushParserCtxt (NULL, NULL, NULL, 0, NULL);
+	success = _soup_soap_sax_parse_body (ctxt, priv->message_headers,
+	                                     priv->message_body, TRUE,
+	                                     memory_charge_inflated, priv,
+	                                     priv->cancellable, NULL);
+
+	doc = ctxt->myDoc;
+	ctxt->myDoc = NULL;
+	xmlFreeParserCtxt (ctxt);
+
+	if (!success)
+	{
+		xmlFreeDoc (doc);
+		doc = NULL;
+	}
+
+	return doc;
+}
+
+/* Inflates a whole compressed body, for formats that are decoded in one go */
+static GByteArray *
+inflate_buffer (SoupSoapMessagePrivate *priv,
+                GConverter *converter,
+                SoupBuffer *buffer)
+{
+	GByteArray *out = g_byte_array_new ();
+	const gchar *data = buffer->data;
+	gsize length = buffer->length;
+	gsize bytes_read, bytes_written, used = 0;
+	GConverterResult result;
+
+	do
+	{
+		g_byte_array_set_size (out, used + CONVERT_BUFFER_SIZE);
+
+		result = g_converter_convert (converter, data, length,
+		                              out->data + used, CONVERT_BUFFER_SIZE,
+		                              G_CONVERTER_INPUT_AT_END,
+		                              &bytes_read, &bytes_written,
+		                              &priv->parse_error);
+		if (result == G_CONVERTER_ERROR ||
+		    !memory_charge_inflated (bytes_written, priv))
+		{
+			g_byte_array_unref (out);
+			return NULL;
+		}
+
+		data += bytes_read;
+		length -= bytes_read;
+		used += bytes_written;
+	} while (result != G_CONVERTER_FINISHED);
+
+	g_byte_array_set_size (out, used);
+
+	return out;
+}
+
+static gboolean
+persist_sink_flush (SoupSoapMessagePersistSink *sink)
+{
+	if (sink->buffer_len == 0)
+		return FALSE;
+
+	soup_message_body_append (sink->body, SOUP_MEMORY_TAKE,
+	                          sink->buffer, sink->buffer_len);
+	sink->chunks++;
+	sink->bytes += sink->buffer_len;
+
+	sink->buffer = g_malloc (CONVERT_BUFFER_SIZE);
+	sink->buffer_len = 0;
+
+	return TRUE;
+}
+
+static gboolean
+persist_sink_write (SoupSoapMessagePersistSink *sink,
+                    const gchar *data,
+                    gsize length,
+                    gboolean at_end)
+{
+	gsize bytes_read, bytes_written;
+	GConverterResult result;
+	GError *error = NULL;
+
+	if (sink->converter == NULL && sink->buffer == NULL)
+	{
+		if (length > 0)
+		{
+			soup_message_body_append (sink->body, SOUP_MEMORY_COPY,
+			                          data, length);
+			sink->chunks++;
+			sink->bytes += length;
+		}
+		return TRUE;
+	}
+
+	/* Without a converter, a buffer means small writes are gathered
+	 * into chunks of the buffer size.
+	 */
+	if (sink->converter == NULL)
+	{
+		while (length > 0)
+		{
+			gsize count = MIN (length, CONVERT_BUFFER_SIZE - sink->buffer_len);
+
+			memcpy (sink->buffer + sink->buffer_len, data, count);
+			sink->buffer_len += count;
+			data += count;
+			length -= count;
+
+			if (sink->buffer_len == CONVERT_BUFFER_SIZE)
+				persist_sink_flush (sink);
+		}
+
+		if (at_end)
+			persist_sink_flush (sink);
+
+		return TRUE;
+	}
+
+	if (length == 0 && !at_end)
+		return TRUE;
+
+	do
+	{
+		result = g_converter_convert (sink->converter, data, length,
+		                              sink->buffer + sink->buffer_len,
+		                              CONVERT_BUFFER_SIZE - sink->buffer_len,
+		                              at_end ? G_CONVERTER_INPUT_AT_END : 0,
+		                              &bytes_read, &bytes_written,
+		                              &error);
+		if (result == G_CONVERTER_ERROR)
+		{
+			if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE) &&
+			    persist_sink_flush (sink))
+			{
+				g_clear_error (&error);
+				continue;
 			}
+
+			g_propagate_error (&sink->error, error);
+			return FALSE;
 		}
+
+		data += bytes_read;
+		length -= bytes_read;
+		sink->buffer_len += bytes_written;
+
+		if (sink->buffer_len == CONVERT_BUFFER_SIZE)
+			persist_sink_flush (sink);
+	} while (result != G_CONVERTER_FINISHED && (length > 0 || at_end));
+
+	if (at_end)
+		persist_sink_flush (sink);
+
+	return TRUE;
+}
+
+static int
+persist_sink_io_write (void *context,
+                       const char *buffer,
+                       int len)
+{
+	return persist_sink_write (context, buffer, len, FALSE) ? len : -1;
+}
+
+static int
+persist_sink_io_close (void *context)
+{
+	return persist_sink_write (context, NULL, 0, TRUE) ? 0 : -1;
+}
+
+static gboolean
+parse_data_release (gpointer user_data)
+{
+	SoupSoapMessageParseData *data = user_data;
+
+	if (data->headers)
+		soup_message_headers_free (data->headers);
+	if (data->body)
+		soup_message_body_free (data->body);
+	if (data->msg)
+		g_object_unref (data->msg);
+	if (data->schema)
+		g_object_unref (data->schema);
+
+	g_main_context_unref (data->context);
+	g_slice_free (SoupSoapMessageParseData, data);
+
+	return FALSE;
+}
+
+/* libsoup counts references to headers and bodies without atomics, so
+ * they are dropped on the context of the thread that took them.
+ */
+static void
+parse_data_free (SoupSoapMessageParseData *data)
+{
+	GSource *source;
+
+	if (g_main_context_is_owner (data->context))
+	{
+		parse_data_release (data);
+		return;
+	}
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, parse_data_release, data, NULL);
+	g_source_attach (source, data->context);
+	g_source_unref (source);
+}
+
+static void parse_message (SoupSoapMessage *msg);
+
+static void
+parse_thread (gpointer task_data,
+              gpointer user_data)
+{
+	GTask *task = task_data;
+	SoupSoapMessageParseData *data = g_task_get_task_data (task);
+	SoupSoapMessage *msg;
+	SoupSoapMessagePrivate *priv;
+
+	if (g_task_return_error_if_cancelled (task))
+	{
+		g_object_unref (task);
+		return;
+	}
+
+	msg = g_object_new (SOUP_SOAP_TYPE_MESSAGE,
+	                    "schema", data->schema,
+	                    NULL);
+	priv = msg->priv;
+
+	/* The message adopts the references taken on the calling thread,
+	 * rather than taking its own here.
+	 */
+	priv->message_headers = data->headers;
+	priv->message_body = data->body;
+	data->headers = NULL;
+	data->body = NULL;
+
+	priv->cancellable = g_task_get_cancellable (task);
+	parse_message (msg);
+	priv->cancellable = NULL;
+
+	if (g_task_return_error_if_cancelled (task) || priv->parse_error)
+	{
+		if (!g_task_had_error (task))
+			g_task_return_error (task, g_error_copy (priv->parse_error));
+
+		/* Hand them back, to be released on the calling context */
+		data->headers = priv->message_headers;
+		data->body = priv->message_body;
+		priv->message_headers = NULL;
+		priv->message_body = NULL;
+
+		g_object_unref (msg);
+	}
+	else
+		g_task_return_pointer (task, msg, g_object_unref);
+
+	g_object_unref (task);
+}
+
+static GThreadPool *
+get_parse_pool (void)
+{
+	static gsize initialized = 0;
+	static GThreadPool *parse_pool = NULL;
+
+	if (g_once_init_enter (&initialized))
+	{
+		xmlInitParser ();
+
+		parse_pool = g_thread_pool_new (parse_thread, NULL,
+		                                g_get_num_processors (), FALSE,
+		                                NULL);
+
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return parse_pool;
+}
+
+
+GQuark
+soup_soap_message_error_quark (void)
+{
+	return g_quark_from_static_string ("soup-soap-message-error-quark");
+}
+
+GType
+soup_soap_content_encoding_get_type (void)
+{
+	static gsize type_id = 0;
+
+	if (g_once_init_enter (&type_id))
+	{
+		static const GEnumValue values[] =
+		{
+			{ SOUP_SOAP_CONTENT_ENCODING_IDENTITY, "SOUP_SOAP_CONTENT_ENCODING_IDENTITY", "identity" },
+			{ SOUP_SOAP_CONTENT_ENCODING_GZIP, "SOUP_SOAP_CONTENT_ENCODING_GZIP", "gzip" },
+			{ SOUP_SOAP_CONTENT_ENCODING_DEFLATE, "SOUP_SOAP_CONTENT_ENCODING_DEFLATE", "deflate" },
+			{ 0, NULL, NULL }
+		};
+
+		g_once_init_leave (&type_id,
+		                   g_enum_register_static (g_intern_static_string ("SoupSoapContentEncoding"),
+		                                           values));
+	}
+
+	return type_id;
+}
+
+GType
+soup_soap_wire_format_get_type (void)
+{
+	static gsize type_id = 0;
+
+	if (g_once_init_enter (&type_id))
+	{
+		static const GEnumValue values[] =
+		{
+			{ SOUP_SOAP_WIRE_FORMAT_XML, "SOUP_SOAP_WIRE_FORMAT_XML", "xml" },
+			{ SOUP_SOAP_WIRE_FORMAT_BINARY, "SOUP_SOAP_WIRE_FORMAT_BINARY", "binary" },
+			{ 0, NULL, NULL }
+		};
+
+		g_once_init_leave (&type_id,
+		                   g_enum_register_static (g_intern_static_string ("SoupSoapWireFormat"),
+		                                           values));
 	}
+
+	return type_id;
 }
 
 
@@ -149,26 +732,54 @@ soup_soap_message_init (SoupSoapMessage *object)
 
 	priv->header = g_object_ref_sink (soup_soap_param_group_new ("Header"));
 	priv->body = g_object_ref_sink (soup_soap_param_group_new ("Body"));
+	priv->has_operation = FALSE;
 	priv->message_headers = NULL;
 	priv->message_body = NULL;
+	priv->content_encoding = SOUP_SOAP_CONTENT_ENCODING_IDENTITY;
+	priv->wire_format = SOUP_SOAP_WIRE_FORMAT_XML;
+	priv->schema = NULL;
+	priv->paths = NULL;
+	priv->parse_error = NULL;
+	priv->cancellable = NULL;
+	priv->producer = NULL;
+	priv->producer_data = NULL;
+	priv->producer_destroy = NULL;
+	memset (&priv->stats, 0, sizeof (priv->stats));
+	priv->memory_limit = (gsize) g_atomic_pointer_get (&default_memory_limit);
+	priv->memory_charged = 0;
+	priv->memory_inflated = 0;
 }
 
 static void
-soup_soap_message_constructed (GObject *object)
+parse_envelope (SoupSoapMessagePrivate *priv)
 {
-	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
-	SoupSoapMessagePrivate *priv = msg->priv;
+	xmlNodePtr current_node, op_node;
 
-	soup_buffer_free (soup_message_body_flatten (priv->message_body));
+	xmlDocPtr doc = parse_body (priv);
 
-	xmlNodePtr current_node, op_node;
+	/* Building the tree is the other half of the work */
+	if (priv->parse_error ||
+	    g_cancellable_set_error_if_cancelled (priv->cancellable,
+	                                          &priv->parse_error))
+	{
+		xmlFreeDoc (doc);
+		return;
+	}
 
-	xmlDocPtr doc = xmlParseDoc (BAD_CAST priv->message_body->data);
+	current_node = doc ? xmlDocGetRootElement (doc) : NULL;
 
-	if (doc)
+	/* An empty body is how new requests start out, so it is not an error */
+	if (priv->message_body->length > 0 && priv->parse_error == NULL &&
+	    (current_node == NULL ||
+	     !xmlStrEqual (current_node->name, BAD_CAST "Envelope")))
 	{
-		current_node = xmlDocGetRootElement (doc);
+		g_set_error_literal (&priv->parse_error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+		                     _("Message body is not a SOAP envelope"));
+	}
 
+	if (doc)
+	{
 		if (current_node &&
 		    current_node->name &&
 		    xmlStrEqual (current_node->name, BAD_CAST "Envelope"))
@@ -180,17 +791,42 @@ soup_soap_message_constructed (GObject *object)
 				if (current_node->type == XML_ELEMENT_NODE)
 				{
 					if (xmlStrEqual (current_node->name, BAD_CAST "Header"))
-						parse_param (priv->header,
+					{
+						SOUP_SOAP_PROBE1 (section__parse__start, "Header");
+						parse_param (priv, priv->header,
 						             current_node);
+						SOUP_SOAP_PROBE1 (section__parse__done, "Header");
+					}
 					else if (xmlStrEqual (current_node->name, BAD_CAST "Body"))
 					{
 						op_node = current_node->children;
+						while (op_node && op_node->type != XML_ELEMENT_NODE)
+							op_node = op_node->next;
+
+						/* Validate the operation element on the document
+						 * already parsed, and do not build a tree from an
+						 * element that failed.
+						 */
+						if (op_node && priv->schema && priv->parse_error == NULL &&
+						    !_soup_soap_schema_validate_element (priv->schema,
+						                                         op_node,
+						                                         &priv->parse_error))
+							op_node = NULL;
+
 						if (op_node)
 						{
-							soup_soap_param_set_name (SOUP_SOAP_PARAM (priv->body),
-							                          (gchar *) op_node->name);
-							parse_param (priv->body,
+							priv->has_operation = TRUE;
+							_soup_soap_param_set_pooled_name (SOUP_SOAP_PARAM (priv->body),
+							                                  pool_name (priv->names,
+							                                             op_node->ns ?
+							                                             op_node->ns->href :
+							                                             NULL),
+							                                  pool_name (priv->names,
+							                                             op_node->name));
+							SOUP_SOAP_PROBE1 (section__parse__start, "Body");
+							parse_param (priv, priv->body,
 							             op_node);
+							SOUP_SOAP_PROBE1 (section__parse__done, "Body");
 						}
 					}
 				}
@@ -199,60 +835,646 @@ soup_soap_message_constructed (GObject *object)
 	}
 
 	xmlFreeDoc (doc);
-
-	G_OBJECT_CLASS (soup_soap_message_parent_class)->constructed (object);
 }
 
 static void
-soup_soap_message_finalize (GObject *object)
+parse_binary (SoupSoapMessagePrivate *priv)
 {
-	G_OBJECT_CLASS (soup_soap_message_parent_class)->finalize (object);
+	GConverter *converter;
+	SoupBuffer *buffer;
+
+	converter = _soup_soap_create_decompressor (priv->message_headers,
+	                                            priv->message_body);
+	buffer = soup_message_body_flatten (priv->message_body);
+
+	if (converter == NULL)
+		_soup_soap_binary_decode ((const guchar *) buffer->data, buffer->length,
+		                          priv->header, priv->body,
+		                          &priv->parse_error);
+	else
+	{
+		GByteArray *data = inflate_buffer (priv, converter, buffer);
+
+		if (data)
+		{
+			_soup_soap_binary_decode (data->data, data->len,
+			                          priv->header, priv->body,
+			                          &priv->parse_error);
+			g_byte_array_unref (data);
+		}
+
+		g_object_unref (converter);
+	}
+
+	soup_buffer_free (buffer);
+
+	/* The Body node of a binary envelope is the operation element */
+	priv->has_operation = priv->parse_error == NULL;
+
+	/* The decoder builds the whole tree, so its budget is checked once */
+	if (priv->parse_error == NULL)
+		memory_charge (priv,
+		               _soup_soap_param_tree_get_memory_usage (SOUP_SOAP_PARAM (priv->header), NULL) +
+		               _soup_soap_param_tree_get_memory_usage (SOUP_SOAP_PARAM (priv->body), NULL));
 }
 
-static void
-soup_soap_message_set_property (GObject *object,
-                                guint prop_id,
-                                const GValue *value,
-                                GParamSpec *pspec)
+/* Selective parsing: elements outside the requested paths are skipped
+ * as the tokenizer reports them, so no node, param or text buffer is
+ * ever built for them.  Ancestors of a match are kept as groups holding
+ * only what matched, so the same paths still work on the result.
+ */
+
+typedef struct
 {
-	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (object));
+	guint path;
+	guint step;
+	guint seen;
+} SelectiveState;
 
-	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
-	SoupSoapMessagePrivate *priv = msg->priv;
+typedef struct
+{
+	SoupSoapSaxFrame base;
+	guint states_start;
+} SelectiveFrame;
 
-	switch (prop_id)
-	{
-		case PROP_MESSAGE_HEADERS:
-			priv->message_headers = g_value_get_boxed (value);
-			break;
-		case PROP_MESSAGE_BODY:
-			priv->message_body = g_value_get_boxed (value);
-			break;
-		default:
-			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-			break;
-	}
+typedef struct
+{
+	SoupSoapSaxBuilder builder;
+	SoupSoapMessagePrivate *priv;
+	GArray *states;
+	gboolean have_envelope;
+	gboolean have_operation;
+} SelectiveParser;
+
+static gboolean
+selective_charge (SoupSoapParam *param,
+                  gpointer user_data)
+{
+	return memory_charge_param (user_data, param);
 }
 
 static void
-soup_soap_message_get_property (GObject *object,
-                                guint prop_id,
-                                GValue *value,
-                                GParamSpec *pspec)
+selective_push (SelectiveParser *parser,
+                const xmlChar *namespace_uri,
+                const xmlChar *name,
+                SoupSoapParamGroup *group,
+                gboolean capture,
+                guint states_start)
 {
-	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (object));
+	SelectiveFrame *frame;
 
-	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
-	SoupSoapMessagePrivate *priv = msg->priv;
+	frame = (SelectiveFrame *) _soup_soap_sax_builder_push (&parser->builder,
+	                                                        namespace_uri, name,
+	                                                        group, capture);
+	frame->states_start = states_start;
+}
 
-	switch (prop_id)
+static void
+selective_start_element (void *ctx,
+                         const xmlChar *localname,
+                         const xmlChar *prefix,
+                         const xmlChar *URI,
+                         int nb_namespaces,
+                         const xmlChar **namespaces,
+                         int nb_attributes,
+                         int nb_defaulted,
+                         const xmlChar **attributes)
+{
+	SelectiveParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+	SoupSoapSaxBuilder *builder = &parser->builder;
+	SoupSoapMessagePrivate *priv = parser->priv;
+	SelectiveFrame *top;
+	gboolean matched = FALSE;
+	guint states_start, i, n;
+
+	if (!_soup_soap_sax_builder_start (builder))
+		return;
+
+	switch (builder->depth)
 	{
-		case PROP_MESSAGE_HEADERS:
-			g_value_set_boxed (value, priv->message_headers);
-			break;
+		case 1:
+			parser->have_envelope = xmlStrEqual (localname, BAD_CAST "Envelope");
+			if (!parser->have_envelope)
+				_soup_soap_sax_builder_skip (builder);
+			return;
+		case 2:
+			if (xmlStrEqual (localname, BAD_CAST "Header"))
+				selective_push (parser, NULL, NULL, priv->header, TRUE, 0);
+			else if (xmlStrEqual (localname, BAD_CAST "Body"))
+				selective_push (parser, NULL, NULL, priv->body, FALSE, 0);
+			else
+				_soup_soap_sax_builder_skip (builder);
+			return;
+		case 3:
+			top = (SelectiveFrame *) _soup_soap_sax_builder_top (builder);
+			if (top->base.group == priv->body)
+			{
+				/* Only the first element of the body is the operation */
+				if (parser->have_operation)
+				{
+					_soup_soap_sax_builder_skip (builder);
+					return;
+				}
+
+				parser->have_operation = TRUE;
+				priv->has_operation = TRUE;
+				_soup_soap_param_set_pooled_name (SOUP_SOAP_PARAM (priv->body),
+				                                  pool_name (priv->names, URI),
+				                                  pool_name (priv->names, localname));
+
+				g_array_set_size (parser->states, 0);
+				for (i = 0; i < priv->paths->len; i++)
+				{
+					SelectiveState state = { i, 0, 0 };
+
+					g_array_append_val (parser->states, state);
+				}
+
+				selective_push (parser, NULL, NULL, priv->body, FALSE, 0);
+				return;
+			}
+			break;
+	}
+
+	top = (SelectiveFrame *) _soup_soap_sax_builder_top (builder);
+
+	if (top->base.capture)
+	{
+		_soup_soap_sax_builder_ensure_group (builder, builder->frames->len - 1);
+		selective_push (parser, URI, localname, NULL, TRUE, parser->states->len);
+		return;
+	}
+
+	/* Advance every state of the parent over this element */
+	states_start = parser->states->len;
+
+	for (i = top->states_start; i < states_start; i++)
+	{
+		SelectiveState *state = &g_array_index (parser->states, SelectiveState, i);
+		const SoupSoapPathStep *steps =
+			_soup_soap_path_get_steps (g_ptr_array_index (priv->paths, state->path), &n);
+		const SoupSoapPathStep *step = &steps[state->step];
+
+		if (step->name && strcmp (step->name, (const gchar *) localname) != 0)
+			continue;
+
+		if (step->index != -1 && state->seen++ != (guint) step->index)
+			continue;
+
+		if (state->step == n - 1)
+			matched = TRUE;
+		else
+		{
+			SelectiveState next = { state->path, state->step + 1, 0 };
+
+			g_array_append_val (parser->states, next);
+		}
+	}
+
+	if (!matched && parser->states->len == states_start)
+	{
+		_soup_soap_sax_builder_skip (builder);
+		return;
+	}
+
+	selective_push (parser, URI, localname, NULL, matched, states_start);
+}
+
+static void
+selective_end_element (void *ctx,
+                       const xmlChar *localname,
+                       const xmlChar *prefix,
+                       const xmlChar *URI)
+{
+	SelectiveParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+	SelectiveFrame frame;
+
+	/* Nothing above the Header and Body has a frame */
+	if (!_soup_soap_sax_builder_end (&parser->builder) ||
+	    parser->builder.depth == 0)
+		return;
+
+	_soup_soap_sax_builder_pop (&parser->builder, &frame);
+	g_array_set_size (parser->states, frame.states_start);
+}
+
+static void
+selective_characters (void *ctx,
+                      const xmlChar *ch,
+                      int len)
+{
+	SelectiveParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+
+	_soup_soap_sax_builder_characters (&parser->builder, ch, len);
+}
+
+static void
+parse_selective (SoupSoapMessagePrivate *priv)
+{
+	xmlSAXHandler sax;
+	xmlParserCtxtPtr ctxt;
+	SelectiveParser parser;
+	gboolean success;
+
+	memset (&sax, 0, sizeof (sax));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = selective_start_element;
+	sax.endElementNs = selective_end_element;
+	sax.characters = selective_characters;
+	sax.cdataBlock = selective_characters;
+
+	_soup_soap_sax_builder_init (&parser.builder, sizeof (SelectiveFrame),
+	                             priv->names, selective_charge, priv);
+	parser.priv = priv;
+	parser.states = g_array_new (FALSE, FALSE, sizeof (SelectiveState));
+	parser.have_envelope = FALSE;
+	parser.have_operation = FALSE;
+
+	ctxt = xmlCreatePushParserCtxt (&sax, NULL, NULL, 0, NULL);
+	ctxt->_private = &parser;
+	parser.builder.ctxt = ctxt;
+
+	success = _soup_soap_sax_parse_body (ctxt, priv->message_headers,
+	                                     priv->message_body, TRUE,
+	                                     memory_charge_inflated, priv,
+	                                     priv->cancellable, &priv->parse_error);
+
+	xmlFreeParserCtxt (ctxt);
+
+	_soup_soap_sax_builder_clear (&parser.builder);
+	g_array_unref (parser.states);
+
+	/* A parser stopped by a budget has already set its error */
+	if ((!success || !parser.have_envelope) && priv->parse_error == NULL)
+		g_set_error_literal (&priv->parse_error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+		                     _("Message body is not a SOAP envelope"));
+}
+
+/* Peeking: reads only as far as the operation element, keeping just
+ * the requested header entries.
+ */
+
+typedef struct
+{
+	SoupSoapSaxBuilder builder;
+	const gchar * const *header_names;
+	SoupSoapParamGroup *header;
+	gboolean have_envelope;
+	gboolean envelope_done;
+	gboolean in_body;
+	gchar *operation_name;
+} PeekParser;
+
+/* A wanted name is either "{namespace}name", which only matches in that
+ * namespace ("{}name" in none), or a bare name, which matches in any.
+ */
+static gboolean
+peek_wants_header (PeekParser *parser,
+                   const xmlChar *namespace_uri,
+                   const xmlChar *name)
+{
+	const gchar * const *names;
+	const gchar *wanted, *end;
+
+	if (parser->header_names == NULL)
+		return TRUE;
+
+	for (names = parser->header_names; *names; names++)
+	{
+		wanted = *names;
+
+		if (*wanted == '{')
+		{
+			end = strchr (wanted, '}');
+			if (end == NULL)
+				continue;
+
+			if (namespace_uri == NULL ?
+			    end != wanted + 1 :
+			    (xmlStrlen (namespace_uri) != end - wanted - 1 ||
+			     strncmp (wanted + 1, (const gchar *) namespace_uri,
+			              end - wanted - 1) != 0))
+				continue;
+
+			wanted = end + 1;
+		}
+
+		if (strcmp (wanted, (const gchar *) name) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+peek_start_element (void *ctx,
+                    const xmlChar *localname,
+                    const xmlChar *prefix,
+                    const xmlChar *URI,
+                    int nb_namespaces,
+                    const xmlChar **namespaces,
+                    int nb_attributes,
+                    int nb_defaulted,
+                    const xmlChar **attributes)
+{
+	PeekParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+	SoupSoapSaxBuilder *builder = &parser->builder;
+	gboolean active = _soup_soap_sax_builder_start (builder);
+
+	/* The body is skipped, apart from its first element */
+	if (parser->in_body && builder->depth == 3)
+	{
+		parser->operation_name = g_strdup ((const gchar *) localname);
+		xmlStopParser (builder->ctxt);
+		return;
+	}
+
+	if (!active)
+		return;
+
+	switch (builder->depth)
+	{
+		case 1:
+			parser->have_envelope = xmlStrEqual (localname, BAD_CAST "Envelope");
+			if (!parser->have_envelope)
+				xmlStopParser (builder->ctxt);
+			return;
+		case 2:
+			if (xmlStrEqual (localname, BAD_CAST "Header"))
+				_soup_soap_sax_builder_push (builder, NULL, NULL, parser->header, TRUE);
+			else
+			{
+				parser->in_body = xmlStrEqual (localname, BAD_CAST "Body");
+				_soup_soap_sax_builder_skip (builder);
+			}
+			return;
+		case 3:
+			if (!peek_wants_header (parser, URI, localname))
+			{
+				_soup_soap_sax_builder_skip (builder);
+				return;
+			}
+			break;
+	}
+
+	_soup_soap_sax_builder_ensure_group (builder, builder->frames->len - 1);
+	_soup_soap_sax_builder_push (builder, URI, localname, NULL, TRUE);
+}
+
+static void
+peek_end_element (void *ctx,
+                  const xmlChar *localname,
+                  const xmlChar *prefix,
+                  const xmlChar *URI)
+{
+	PeekParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+	SoupSoapSaxBuilder *builder = &parser->builder;
+
+	if (_soup_soap_sax_builder_end (builder))
+	{
+		if (builder->depth > 0)
+			_soup_soap_sax_builder_pop (builder, NULL);
+		else
+		{
+			/* The whole envelope has been read, whatever the encoding */
+			parser->envelope_done = TRUE;
+			xmlStopParser (builder->ctxt);
+		}
+	}
+	else if (builder->skip_depth == 0)
+		parser->in_body = FALSE;
+}
+
+static void
+peek_characters (void *ctx,
+                 const xmlChar *ch,
+                 int len)
+{
+	PeekParser *parser = ((xmlParserCtxtPtr) ctx)->_private;
+
+	_soup_soap_sax_builder_characters (&parser->builder, ch, len);
+}
+
+static void
+count_params (SoupSoapParam *param,
+              guint depth,
+              SoupSoapMessageStats *stats)
+{
+	GList *elements;
+
+	stats->elements++;
+	stats->max_depth = MAX (stats->max_depth, depth);
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+		return;
+
+	for (elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		count_params (elements->data, depth + 1, stats);
+}
+
+static void
+count_tree (SoupSoapMessagePrivate *priv)
+{
+	GList *elements;
+
+	priv->stats.elements = 0;
+	priv->stats.max_depth = 0;
+
+	for (elements = _soup_soap_param_group_peek_elements (priv->header);
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		count_params (elements->data, 1, &priv->stats);
+
+	for (elements = _soup_soap_param_group_peek_elements (priv->body);
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		count_params (elements->data, 1, &priv->stats);
+}
+
+static void
+parse_message (SoupSoapMessage *msg)
+{
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	gint64 wall_time = g_get_monotonic_time ();
+	gint64 cpu_time = _soup_soap_stats_get_cpu_time ();
+	SOUP_SOAP_MARK_BEGIN (mark_begin);
+
+	const gchar *content_type =
+		soup_message_headers_get_content_type (priv->message_headers, NULL);
+
+	/* The format a message arrived in is the one it is persisted in */
+	if (content_type &&
+	    g_ascii_strcasecmp (content_type, SOUP_SOAP_BINARY_CONTENT_TYPE) == 0)
+		priv->wire_format = SOUP_SOAP_WIRE_FORMAT_BINARY;
+
+	if (priv->message_body->length > 0)
+	{
+		SOUP_SOAP_PROBE1 (message__parse__start, priv->message_body->length);
+
+		/* The message keeps its raw body, so that counts as well */
+		priv->names = _soup_soap_string_pool_new ();
+		if (memory_charge (priv, priv->message_body->length))
+		{
+			if (priv->wire_format == SOUP_SOAP_WIRE_FORMAT_BINARY)
+				parse_binary (priv);
+			else if (priv->paths && priv->paths->len > 0)
+				parse_selective (priv);
+			else
+				parse_envelope (priv);
+		}
+		_soup_soap_string_pool_free (priv->names);
+		priv->names = NULL;
+
+		memory_release (priv, priv->memory_inflated);
+		priv->memory_inflated = 0;
+
+		/* Nothing of a parse over budget is kept but the body */
+		if (g_error_matches (priv->parse_error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_TOO_LARGE))
+		{
+			_soup_soap_param_group_set_elements (priv->header, NULL);
+			_soup_soap_param_group_set_elements (priv->body, NULL);
+			memory_release (priv, priv->memory_charged -
+			                MIN (priv->memory_charged, priv->message_body->length));
+		}
+
+		count_tree (priv);
+		priv->stats.parse_wall_time = g_get_monotonic_time () - wall_time;
+		priv->stats.parse_cpu_time = _soup_soap_stats_get_cpu_time () - cpu_time;
+		priv->stats.input_bytes = priv->message_body->length;
+		priv->stats.parse_params = priv->stats.elements;
+		_soup_soap_stats_add_parse (&priv->stats);
+
+		SOUP_SOAP_PROBE3 (message__parse__done, priv->stats.input_bytes,
+		                  priv->stats.elements, priv->stats.max_depth);
+		SOUP_SOAP_MARK_END (mark_begin, "parse",
+		                    "%" G_GSIZE_FORMAT " bytes, %u elements",
+		                    priv->stats.input_bytes, priv->stats.elements);
+	}
+}
+
+static void
+soup_soap_message_constructed (GObject *object)
+{
+	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	/* Parsing on a worker, the body is only handed over afterwards */
+	if (priv->message_headers && priv->message_body)
+		parse_message (msg);
+
+	G_OBJECT_CLASS (soup_soap_message_parent_class)->constructed (object);
+}
+
+static void
+soup_soap_message_finalize (GObject *object)
+{
+	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	g_object_unref (priv->header);
+	g_object_unref (priv->body);
+
+	if (priv->message_headers)
+		soup_message_headers_free (priv->message_headers);
+	if (priv->message_body)
+		soup_message_body_free (priv->message_body);
+
+	if (priv->schema)
+		g_object_unref (priv->schema);
+
+	if (priv->paths)
+		g_ptr_array_unref (priv->paths);
+
+	if (priv->producer_destroy)
+		priv->producer_destroy (priv->producer_data);
+
+	memory_release (priv, priv->memory_charged);
+
+	if (priv->parse_error)
+		g_error_free (priv->parse_error);
+
+	G_OBJECT_CLASS (soup_soap_message_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_message_set_property (GObject *object,
+                                guint prop_id,
+                                const GValue *value,
+                                GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (object));
+
+	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	switch (prop_id)
+	{
+		case PROP_MESSAGE_HEADERS:
+			priv->message_headers = g_value_dup_boxed (value);
+			break;
+		case PROP_MESSAGE_BODY:
+			priv->message_body = g_value_dup_boxed (value);
+			break;
+		case PROP_CONTENT_ENCODING:
+			priv->content_encoding = g_value_get_enum (value);
+			break;
+		case PROP_WIRE_FORMAT:
+			priv->wire_format = g_value_get_enum (value);
+			break;
+		case PROP_SCHEMA:
+			priv->schema = g_value_dup_object (value);
+			break;
+		case PROP_PATHS:
+			priv->paths = g_value_dup_boxed (value);
+			break;
+		case PROP_MEMORY_LIMIT:
+			priv->memory_limit = g_value_get_uint64 (value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_message_get_property (GObject *object,
+                                guint prop_id,
+                                GValue *value,
+                                GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (object));
+
+	SoupSoapMessage *msg = SOUP_SOAP_MESSAGE (object);
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	switch (prop_id)
+	{
+		case PROP_MESSAGE_HEADERS:
+			g_value_set_boxed (value, priv->message_headers);
+			break;
 		case PROP_MESSAGE_BODY:
 			g_value_set_boxed (value, priv->message_body);
 			break;
+		case PROP_CONTENT_ENCODING:
+			g_value_set_enum (value, priv->content_encoding);
+			break;
+		case PROP_WIRE_FORMAT:
+			g_value_set_enum (value, priv->wire_format);
+			break;
+		case PROP_SCHEMA:
+			g_value_set_object (value, priv->schema);
+			break;
+		case PROP_PATHS:
+			g_value_set_boxed (value, priv->paths);
+			break;
+		case PROP_MEMORY_LIMIT:
+			g_value_set_uint64 (value, priv->memory_limit);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 			break;
@@ -287,6 +1509,49 @@ soup_soap_message_class_init (SoupSoapMessageClass *klass)
 	                                                     "Set the raw message body to manipulate",
 	                                                     SOUP_TYPE_MESSAGE_BODY,
 	                                                     G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_CONTENT_ENCODING,
+	                                 g_param_spec_enum ("content-encoding",
+	                                                    "Content encoding",
+	                                                    "The compression applied to the body when persisting",
+	                                                    SOUP_SOAP_TYPE_CONTENT_ENCODING,
+	                                                    SOUP_SOAP_CONTENT_ENCODING_IDENTITY,
+	                                                    G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_WIRE_FORMAT,
+	                                 g_param_spec_enum ("wire-format",
+	                                                    "Wire format",
+	                                                    "The encoding of the envelope when persisting",
+	                                                    SOUP_SOAP_TYPE_WIRE_FORMAT,
+	                                                    SOUP_SOAP_WIRE_FORMAT_XML,
+	                                                    G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_SCHEMA,
+	                                 g_param_spec_object ("schema",
+	                                                      "Schema",
+	                                                      "The schema the operation element is validated against",
+	                                                      SOUP_SOAP_TYPE_SCHEMA,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_PATHS,
+	                                 g_param_spec_boxed ("paths",
+	                                                     "Paths",
+	                                                     "A GPtrArray of SoupSoapPath selecting the operation parameters to parse",
+	                                                     G_TYPE_PTR_ARRAY,
+	                                                     G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	/* Only set when given, otherwise the process default applies */
+	g_object_class_install_property (object_class,
+	                                 PROP_MEMORY_LIMIT,
+	                                 g_param_spec_uint64 ("memory-limit",
+	                                                      "Memory limit",
+	                                                      "The most memory in bytes the parsed message may hold, or 0 for no limit",
+	                                                      0, G_MAXSIZE, 0,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
 }
 
 
@@ -303,6 +1568,60 @@ soup_soap_message_new (SoupMessageHeaders *headers,
 	                     NULL);
 }
 
+/* Like soup_soap_message_new(), but also validates the operation element
+ * against schema, reporting violations through the parse error.  The
+ * envelope is parsed whole before it is validated, so an invalid message
+ * is not rejected any sooner.
+ */
+SoupSoapMessage *
+soup_soap_message_new_with_schema (SoupMessageHeaders *headers,
+                                   SoupMessageBody *body,
+                                   SoupSoapSchema *schema)
+{
+	g_return_val_if_fail (headers != NULL, NULL);
+	g_return_val_if_fail (body != NULL, NULL);
+	g_return_val_if_fail (schema == NULL || SOUP_SOAP_IS_SCHEMA (schema), NULL);
+
+	return g_object_new (SOUP_SOAP_TYPE_MESSAGE,
+	                     "message-headers", headers,
+	                     "message-body", body,
+	                     "schema", schema,
+	                     NULL);
+}
+
+/* Parses only the operation parameters selected by paths, and whatever
+ * groups lead to them; the header is parsed whole.  Schema validation
+ * needs the whole operation element, so it is not available here.
+ */
+SoupSoapMessage *
+soup_soap_message_new_selective (SoupMessageHeaders *headers,
+                                 SoupMessageBody *body,
+                                 SoupSoapPath **paths,
+                                 guint n_paths)
+{
+	g_return_val_if_fail (headers != NULL, NULL);
+	g_return_val_if_fail (body != NULL, NULL);
+	g_return_val_if_fail (paths != NULL || n_paths == 0, NULL);
+
+	SoupSoapMessage *msg;
+	GPtrArray *array;
+	guint i;
+
+	array = g_ptr_array_new_full (n_paths, (GDestroyNotify) soup_soap_path_unref);
+	for (i = 0; i < n_paths; i++)
+		g_ptr_array_add (array, soup_soap_path_ref (paths[i]));
+
+	msg = g_object_new (SOUP_SOAP_TYPE_MESSAGE,
+	                    "message-headers", headers,
+	                    "message-body", body,
+	                    "paths", array,
+	                    NULL);
+
+	g_ptr_array_unref (array);
+
+	return msg;
+}
+
 SoupSoapMessage *
 soup_soap_message_new_request (SoupMessage *msg)
 {
@@ -321,26 +1640,248 @@ soup_soap_message_new_response (SoupMessage *msg)
 	                              msg->response_body);
 }
 
-const gchar *
-soup_soap_message_get_operation_name (SoupSoapMessage *msg)
+/* Like soup_soap_message_new(), but taking over references to headers
+ * and body that the caller took, for a message made on another thread;
+ * see parse_data_free().  _soup_soap_message_detach() hands them back.
+ */
+SoupSoapMessage *
+_soup_soap_message_new_adopting (SoupMessageHeaders *headers,
+                                 SoupMessageBody *body)
 {
-	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+	SoupSoapMessage *msg = g_object_new (SOUP_SOAP_TYPE_MESSAGE, NULL);
 
-	return soup_soap_param_get_name (SOUP_SOAP_PARAM (msg->priv->body));
+	msg->priv->message_headers = headers;
+	msg->priv->message_body = body;
+	parse_message (msg);
+
+	return msg;
 }
 
+/* Lets go of the headers and body without dropping the references */
 void
-soup_soap_message_set_operation_name (SoupSoapMessage *msg,
-                                      const gchar *name)
+_soup_soap_message_detach (SoupSoapMessage *msg)
 {
-	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
-
-	soup_soap_param_set_name (SOUP_SOAP_PARAM (msg->priv->body),
-	                          name);
+	msg->priv->message_headers = NULL;
+	msg->priv->message_body = NULL;
 }
 
-SoupSoapParamGroup *
-soup_soap_message_get_header (SoupSoapMessage *msg)
+void
+_soup_soap_message_new_async_full (SoupMessageHeaders *headers,
+                                   SoupMessageBody *body,
+                                   SoupMessage *msg,
+                                   SoupSoapSchema *schema,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data)
+{
+	SoupSoapMessageParseData *data = g_slice_new (SoupSoapMessageParseData);
+	GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+
+	/* Referenced here rather than on the worker; see parse_data_free() */
+	data->headers = g_boxed_copy (SOUP_TYPE_MESSAGE_HEADERS, headers);
+	data->body = g_boxed_copy (SOUP_TYPE_MESSAGE_BODY, body);
+	data->msg = msg ? g_object_ref (msg) : NULL;
+	data->schema = schema ? g_object_ref (schema) : NULL;
+	data->context = g_main_context_ref_thread_default ();
+
+	g_task_set_source_tag (task, soup_soap_message_new_async);
+	g_task_set_task_data (task, data, (GDestroyNotify) parse_data_free);
+
+	g_thread_pool_push (get_parse_pool (), task, NULL);
+}
+
+void
+soup_soap_message_new_async (SoupMessageHeaders *headers,
+                             SoupMessageBody *body,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+	g_return_if_fail (headers != NULL);
+	g_return_if_fail (body != NULL);
+
+	_soup_soap_message_new_async_full (headers, body, NULL, NULL,
+	                                   cancellable, callback, user_data);
+}
+
+void
+soup_soap_message_new_request_async (SoupMessage *msg,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+	g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+	_soup_soap_message_new_async_full (msg->request_headers,
+	                                   msg->request_body, msg, NULL,
+	                                   cancellable, callback, user_data);
+}
+
+void
+soup_soap_message_new_response_async (SoupMessage *msg,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data)
+{
+	g_return_if_fail (SOUP_IS_MESSAGE (msg));
+
+	_soup_soap_message_new_async_full (msg->response_headers,
+	                                   msg->response_body, msg, NULL,
+	                                   cancellable, callback, user_data);
+}
+
+SoupSoapMessage *
+soup_soap_message_new_finish (GAsyncResult *result,
+                              GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/* Reads the body only as far as the first element inside Body, so that
+ * a request can be routed before it is parsed, or even fully received.
+ * Returns the name of that element, the operation, in operation_name,
+ * and the entries of the SOAP header named in header_names (all of them
+ * if NULL) in header; see peek_wants_header() for the names.  If the body
+ * ends before the operation element and the envelope is still open, fails
+ * with SOUP_SOAP_MESSAGE_ERROR_INCOMPLETE.  Bodies in the binary wire
+ * format fail with SOUP_SOAP_MESSAGE_ERROR_UNSUPPORTED.
+ */
+gboolean
+soup_soap_message_peek (SoupMessageHeaders *headers,
+                        SoupMessageBody *body,
+                        const gchar * const *header_names,
+                        gchar **operation_name,
+                        SoupSoapParamGroup **header,
+                        GError **error)
+{
+	g_return_val_if_fail (headers != NULL, FALSE);
+	g_return_val_if_fail (body != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	xmlSAXHandler sax;
+	xmlParserCtxtPtr ctxt;
+	PeekParser parser;
+	SoupSoapStringPool *names;
+	const gchar *content_type;
+	gboolean success;
+
+	/* The binary format has no incremental decoder to stop early with */
+	content_type = soup_message_headers_get_content_type (headers, NULL);
+	if (content_type &&
+	    g_ascii_strcasecmp (content_type, SOUP_SOAP_BINARY_CONTENT_TYPE) == 0)
+	{
+		g_set_error_literal (error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_UNSUPPORTED,
+		                     _("Binary SOAP envelopes cannot be peeked"));
+		return FALSE;
+	}
+
+	memset (&sax, 0, sizeof (sax));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = peek_start_element;
+	sax.endElementNs = peek_end_element;
+	sax.characters = peek_characters;
+	sax.cdataBlock = peek_characters;
+
+	names = _soup_soap_string_pool_new ();
+	_soup_soap_sax_builder_init (&parser.builder, sizeof (SoupSoapSaxFrame),
+	                             names, NULL, NULL);
+	parser.header_names = header_names;
+	parser.header = g_object_ref_sink (soup_soap_param_group_new ("Header"));
+	parser.have_envelope = FALSE;
+	parser.envelope_done = FALSE;
+	parser.in_body = FALSE;
+	parser.operation_name = NULL;
+
+	ctxt = xmlCreatePushParserCtxt (&sax, NULL, NULL, 0, NULL);
+	ctxt->_private = &parser;
+	parser.builder.ctxt = ctxt;
+
+	/* The document is never ended here: the end of the envelope is what
+	 * tells that the body is complete, with or without a Content-Length.
+	 */
+	success = _soup_soap_sax_parse_body (ctxt, headers, body, FALSE,
+	                                     NULL, NULL, NULL, NULL);
+
+	/* The root element was seen and is not an envelope */
+	if (parser.builder.depth > 0 && !parser.have_envelope)
+		success = FALSE;
+
+	xmlFreeParserCtxt (ctxt);
+
+	_soup_soap_sax_builder_clear (&parser.builder);
+	_soup_soap_string_pool_free (names);
+
+	if (parser.operation_name == NULL)
+	{
+		if (success && !parser.envelope_done)
+			g_set_error_literal (error, SOUP_SOAP_MESSAGE_ERROR,
+			                     SOUP_SOAP_MESSAGE_ERROR_INCOMPLETE,
+			                     _("Message body ends before the operation"));
+		else
+			g_set_error_literal (error, SOUP_SOAP_MESSAGE_ERROR,
+			                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+			                     _("Message body is not a SOAP envelope"));
+
+		g_object_unref (parser.header);
+		return FALSE;
+	}
+
+	if (operation_name)
+		*operation_name = parser.operation_name;
+	else
+		g_free (parser.operation_name);
+
+	if (header)
+		*header = parser.header;
+	else
+		g_object_unref (parser.header);
+
+	return TRUE;
+}
+
+const GError *
+soup_soap_message_get_parse_error (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+
+	return msg->priv->parse_error;
+}
+
+const gchar *
+soup_soap_message_get_operation_name (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+
+	return soup_soap_param_get_name (SOUP_SOAP_PARAM (msg->priv->body));
+}
+
+void
+soup_soap_message_set_operation_name (SoupSoapMessage *msg,
+                                      const gchar *name)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
+
+	soup_soap_param_set_name (SOUP_SOAP_PARAM (msg->priv->body),
+	                          name);
+	msg->priv->has_operation = TRUE;
+}
+
+/* Whether the Body holds an operation element.  Until it does, the
+ * operation name is that of the Body itself.
+ */
+gboolean
+soup_soap_message_has_operation (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), FALSE);
+
+	return msg->priv->has_operation;
+}
+
+SoupSoapParamGroup *
+soup_soap_message_get_header (SoupSoapMessage *msg)
 {
 	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
 
@@ -355,58 +1896,934 @@ soup_soap_message_get_params (SoupSoapMessage *msg)
 	return msg->priv->body;
 }
 
+static void
+checksum_update_string (GChecksum *checksum,
+                        const gchar *string)
+{
+	guint32 length;
+
+	/* Length-prefix every string so that no two trees share a stream */
+	if (string == NULL)
+	{
+		length = GUINT32_TO_BE (G_MAXUINT32);
+		g_checksum_update (checksum, (const guchar *) &length, sizeof (length));
+		return;
+	}
+
+	length = GUINT32_TO_BE (strlen (string));
+	g_checksum_update (checksum, (const guchar *) &length, sizeof (length));
+	g_checksum_update (checksum, (const guchar *) string, strlen (string));
+}
+
+static void
+checksum_update_param (GChecksum *checksum,
+                       SoupSoapParam *param)
+{
+	if (SOUP_SOAP_IS_PARAM_GROUP (param))
+	{
+		GList *elements =
+			_soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+		GList *curr_element;
+		guint32 length = GUINT32_TO_BE (g_list_length (elements));
+
+		g_checksum_update (checksum, (const guchar *) "G", 1);
+		checksum_update_string (checksum, soup_soap_param_get_namespace_uri (param));
+		checksum_update_string (checksum, soup_soap_param_get_name (param));
+		g_checksum_update (checksum, (const guchar *) &length, sizeof (length));
+
+		for (curr_element = elements;
+		     curr_element != NULL;
+		     curr_element = g_list_next (curr_element))
+			checksum_update_param (checksum, curr_element->data);
+	}
+	else
+	{
+		g_checksum_update (checksum, (const guchar *) "V", 1);
+		checksum_update_string (checksum, soup_soap_param_get_namespace_uri (param));
+		checksum_update_string (checksum, soup_soap_param_get_name (param));
+		checksum_update_string (checksum, soup_soap_param_get_value (param));
+	}
+}
+
+gchar *
+soup_soap_message_get_digest (SoupSoapMessage *msg)
+{
+	GChecksum *checksum;
+	gchar *digest;
+
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	/* Header entries can change the result as much as the parameters,
+	 * and the body group carries the operation name.
+	 */
+	checksum_update_param (checksum, SOUP_SOAP_PARAM (msg->priv->header));
+	checksum_update_param (checksum, SOUP_SOAP_PARAM (msg->priv->body));
+
+	digest = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return digest;
+}
+
+gboolean
+soup_soap_message_is_fault (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), FALSE);
+
+	SoupSoapParam *body = SOUP_SOAP_PARAM (msg->priv->body);
+
+	return g_strcmp0 (soup_soap_param_get_name (body), "Fault") == 0 &&
+	       g_strcmp0 (soup_soap_param_get_namespace_uri (body),
+	                  SOAP_ENV_NAMESPACE) == 0;
+}
+
 void
-soup_soap_message_persist (SoupSoapMessage *msg)
+soup_soap_message_set_fault (SoupSoapMessage *msg,
+                             const gchar *code,
+                             const gchar *string)
 {
 	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
-
-	xmlChar *buffer;
-	const gchar *contents;
+	g_return_if_fail (code != NULL);
+	g_return_if_fail (string != NULL);
 
 	SoupSoapMessagePrivate *priv = msg->priv;
 
-	xmlDocPtr doc = xmlNewDoc (BAD_CAST "1.0");
+	/* The Fault element replaces whatever the body held so far.  The
+	 * group is changed in place, as callers may still hold it from
+	 * soup_soap_message_get_params().
+	 */
+	_soup_soap_param_group_set_elements (priv->body, NULL);
+	soup_soap_param_set_name (SOUP_SOAP_PARAM (priv->body), "Fault");
+	soup_soap_param_set_namespace_uri (SOUP_SOAP_PARAM (priv->body),
+	                                   SOAP_ENV_NAMESPACE);
+	priv->has_operation = TRUE;
+
+	soup_soap_param_group_add_multiple (priv->body,
+	                                    soup_soap_param_new_value ("faultcode", code),
+	                                    soup_soap_param_new_value ("faultstring", string),
+	                                    NULL);
+}
+
+SoupSoapContentEncoding
+soup_soap_message_get_content_encoding (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg),
+	                      SOUP_SOAP_CONTENT_ENCODING_IDENTITY);
+
+	return msg->priv->content_encoding;
+}
+
+void
+soup_soap_message_set_content_encoding (SoupSoapMessage *msg,
+                                        SoupSoapContentEncoding encoding)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
 
+	msg->priv->content_encoding = encoding;
+}
+
+SoupSoapWireFormat
+soup_soap_message_get_wire_format (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg),
+	                      SOUP_SOAP_WIRE_FORMAT_XML);
+
+	return msg->priv->wire_format;
+}
+
+/* Only use the binary format when the peer is known to be libsoup-soap */
+void
+soup_soap_message_set_wire_format (SoupSoapMessage *msg,
+                                   SoupSoapWireFormat format)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
+
+	msg->priv->wire_format = format;
+}
+
+SoupSoapContentEncoding
+soup_soap_content_encoding_negotiate (SoupMessageHeaders *request_headers)
+{
+	g_return_val_if_fail (request_headers != NULL,
+	                      SOUP_SOAP_CONTENT_ENCODING_IDENTITY);
+
+	SoupSoapContentEncoding encoding = SOUP_SOAP_CONTENT_ENCODING_IDENTITY;
+	const gchar *header;
+	GSList *codings, *coding;
+
+	header = soup_message_headers_get_list (request_headers,
+	                                        "Accept-Encoding");
+	if (header == NULL)
+		return encoding;
+
+	/* The list comes back sorted by preference, without q=0 entries */
+	codings = soup_header_parse_quality_list (header, NULL);
+
+	for (coding = codings; coding != NULL; coding = coding->next)
+	{
+		if (g_ascii_strcasecmp (coding->data, "gzip") == 0 ||
+		    g_ascii_strcasecmp (coding->data, "x-gzip") == 0)
+		{
+			encoding = SOUP_SOAP_CONTENT_ENCODING_GZIP;
+			break;
+		}
+		else if (g_ascii_strcasecmp (coding->data, "deflate") == 0)
+		{
+			encoding = SOUP_SOAP_CONTENT_ENCODING_DEFLATE;
+			break;
+		}
+		else if (g_ascii_strcasecmp (coding->data, "identity") == 0)
+			break;
+	}
+
+	soup_header_free_list (codings);
+
+	return encoding;
+}
+
+/* Creates the Envelope element with the standard namespaces and those
+ * used in the tree, all declared on it.  Declarations are hoisted there
+ * so that elements carry only a prefix.
+ */
+static xmlNodePtr
+create_envelope_node (SoupSoapMessagePrivate *priv,
+                      GHashTable *namespaces)
+{
+	xmlNsPtr ns;
 
 	xmlNodePtr envelope_node = xmlNewNode (NULL, BAD_CAST "Envelope");
-	xmlSetNs (envelope_node,
-	          xmlNewNs (envelope_node,
-	                    BAD_CAST SOAP_ENV_NAMESPACE,
-	                    BAD_CAST "SOAP-ENV"));
-	xmlNewNs (envelope_node,
-	          BAD_CAST XSD_NAMESPACE,
-	          BAD_CAST "xsd");
-	xmlNewNs (envelope_node,
-	          BAD_CAST XSI_NAMESPACE,
-	          BAD_CAST "xsi");
-	xmlNewNs (envelope_node,
-	          BAD_CAST SOAP_ENC_NAMESPACE,
-	          BAD_CAST "SOAP-ENC");
+	ns = xmlNewNs (envelope_node,
+	               BAD_CAST SOAP_ENV_NAMESPACE,
+	               BAD_CAST "SOAP-ENV");
+	xmlSetNs (envelope_node, ns);
+	g_hash_table_insert (namespaces, (gpointer) g_intern_static_string (SOAP_ENV_NAMESPACE), ns);
+	ns = xmlNewNs (envelope_node,
+	               BAD_CAST XSD_NAMESPACE,
+	               BAD_CAST "xsd");
+	g_hash_table_insert (namespaces, (gpointer) g_intern_static_string (XSD_NAMESPACE), ns);
+	ns = xmlNewNs (envelope_node,
+	               BAD_CAST XSI_NAMESPACE,
+	               BAD_CAST "xsi");
+	g_hash_table_insert (namespaces, (gpointer) g_intern_static_string (XSI_NAMESPACE), ns);
+	ns = xmlNewNs (envelope_node,
+	               BAD_CAST SOAP_ENC_NAMESPACE,
+	               BAD_CAST "SOAP-ENC");
+	g_hash_table_insert (namespaces, (gpointer) g_intern_static_string (SOAP_ENC_NAMESPACE), ns);
 	xmlSetProp (envelope_node,
 	            BAD_CAST "SOAP-ENV:encodingStyle",
 	            BAD_CAST SOAP_ENCODING_STYLE);
+
+	collect_namespaces (SOUP_SOAP_PARAM (priv->header), envelope_node, namespaces);
+	collect_namespaces (SOUP_SOAP_PARAM (priv->body), envelope_node, namespaces);
+
+	return envelope_node;
+}
+
+static void
+persist_xml (SoupSoapMessagePrivate *priv,
+             SoupSoapMessagePersistSink *sink)
+{
+	xmlSaveCtxtPtr save_ctxt;
+	GHashTable *namespaces;
+
+	xmlDocPtr doc = xmlNewDoc (BAD_CAST "1.0");
+
+	namespaces = g_hash_table_new (g_str_hash, g_str_equal);
+
+	xmlNodePtr envelope_node = create_envelope_node (priv, namespaces);
 	xmlDocSetRootElement (doc, envelope_node);
 
-	create_param_node (doc, SOUP_SOAP_PARAM (priv->header), envelope_node);
+	create_param_node (doc, SOUP_SOAP_PARAM (priv->header), envelope_node,
+	                   namespaces);
 
 	xmlNodePtr body_node = xmlNewChild (envelope_node, NULL, BAD_CAST "Body", NULL);
-	create_param_node (doc, SOUP_SOAP_PARAM (priv->body), body_node);
+	create_param_node (doc, SOUP_SOAP_PARAM (priv->body), body_node,
+	                   namespaces);
+
+	g_hash_table_unref (namespaces);
+
+	/* Stream the serialized envelope straight into the body (through the
+	 * compressor if any) instead of dumping it to memory and copying it.
+	 */
+	save_ctxt = xmlSaveToIO (persist_sink_io_write, persist_sink_io_close,
+	                         sink, "UTF-8", 0);
+	xmlSaveDoc (save_ctxt, doc);
+	xmlSaveClose (save_ctxt);
+
+	xmlFreeDoc (doc);
+}
+
+static void
+persist_binary (SoupSoapMessagePrivate *priv,
+                SoupSoapMessagePersistSink *sink)
+{
+	GByteArray *data = _soup_soap_binary_encode (priv->header, priv->body);
+
+	if (sink->converter)
+	{
+		persist_sink_write (sink, (const gchar *) data->data, data->len, FALSE);
+		persist_sink_write (sink, NULL, 0, TRUE);
+		g_byte_array_unref (data);
+	}
+	else
+	{
+		guint length = data->len;
+
+		soup_message_body_append (sink->body, SOUP_MEMORY_TAKE,
+		                          g_byte_array_free (data, FALSE), length);
+		sink->chunks++;
+		sink->bytes += length;
+	}
+}
 
+/* Sets up the sink and the headers describing the body.  A buffered sink
+ * gathers output into chunks even when it is not compressed.
+ */
+static void
+persist_sink_init (SoupSoapMessagePrivate *priv,
+                   SoupSoapMessagePersistSink *sink,
+                   gboolean buffered)
+{
+	sink->body = priv->message_body;
+	sink->converter = NULL;
+	sink->buffer = NULL;
+	sink->buffer_len = 0;
+	sink->chunks = 0;
+	sink->bytes = 0;
+	sink->error = NULL;
+
+	switch (priv->content_encoding)
+	{
+		case SOUP_SOAP_CONTENT_ENCODING_GZIP:
+			sink->converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+			soup_message_headers_replace (priv->message_headers,
+			                              "Content-Encoding", "gzip");
+			break;
+		case SOUP_SOAP_CONTENT_ENCODING_DEFLATE:
+			sink->converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1));
+			soup_message_headers_replace (priv->message_headers,
+			                              "Content-Encoding", "deflate");
+			break;
+		default:
+			soup_message_headers_remove (priv->message_headers,
+			                             "Content-Encoding");
+			break;
+	}
+
+	if (sink->converter || buffered)
+		sink->buffer = g_malloc (CONVERT_BUFFER_SIZE);
+
+	soup_message_headers_set_content_type (priv->message_headers,
+	                                       priv->wire_format == SOUP_SOAP_WIRE_FORMAT_BINARY ?
+	                                       SOUP_SOAP_BINARY_CONTENT_TYPE : "text/xml",
+	                                       NULL);
+}
+
+static void
+persist_sink_clear (SoupSoapMessagePersistSink *sink)
+{
+	if (sink->error)
+	{
+		g_warning ("Failed to compress SOAP message: %s", sink->error->message);
+		g_clear_error (&sink->error);
+	}
+
+	if (sink->converter)
+		g_object_unref (sink->converter);
+	sink->converter = NULL;
+	g_free (sink->buffer);
+	sink->buffer = NULL;
+}
+
+static void
+stream_drain_producer (SoupSoapMessagePrivate *priv,
+                       SoupSoapMessage *msg)
+{
+	SoupSoapParam *record;
+
+	if (priv->producer == NULL)
+		return;
+
+	while ((record = priv->producer (msg, priv->producer_data)) != NULL)
+		soup_soap_param_group_add (priv->body, record);
+}
+
+void
+soup_soap_message_persist (SoupSoapMessage *msg)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
+	/* Messages handed out by a SoupSoapCache have no body to write to */
+	g_return_if_fail (msg->priv->message_body != NULL);
 
-	xmlDocDumpFormatMemoryEnc (doc, &buffer, NULL, "UTF-8", 0);
+	SoupSoapMessagePersistSink sink;
+
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	gint64 wall_time = g_get_monotonic_time ();
+	gint64 cpu_time = _soup_soap_stats_get_cpu_time ();
+	SOUP_SOAP_MARK_BEGIN (mark_begin);
+
+	SOUP_SOAP_PROBE1 (message__persist__start, priv->wire_format);
+
+	persist_sink_init (priv, &sink, FALSE);
+
+	stream_drain_producer (priv, msg);
 
-	contents = (gchar *) buffer;
 	soup_message_body_truncate (priv->message_body);
-	soup_message_body_append (priv->message_body, SOUP_MEMORY_COPY,
-	                          contents, strlen (contents));
+
+	if (priv->wire_format == SOUP_SOAP_WIRE_FORMAT_BINARY)
+		persist_binary (priv, &sink);
+	else
+		persist_xml (priv, &sink);
+
 	soup_message_body_complete (priv->message_body);
 
-	xmlFree (buffer);
+	persist_sink_clear (&sink);
+
+	/* The tree may have changed since it was parsed */
+	count_tree (priv);
+	priv->stats.persist_wall_time = g_get_monotonic_time () - wall_time;
+	priv->stats.persist_cpu_time = _soup_soap_stats_get_cpu_time () - cpu_time;
+	priv->stats.output_bytes = priv->message_body->length;
+	/* An XML envelope adds Envelope, Header, Body and operation nodes */
+	priv->stats.persist_nodes = priv->wire_format == SOUP_SOAP_WIRE_FORMAT_XML ?
+		priv->stats.elements + 4 : 0;
+	priv->stats.output_chunks = sink.chunks;
+	_soup_soap_stats_add_persist (&priv->stats);
+
+	SOUP_SOAP_PROBE3 (message__persist__done, priv->stats.output_bytes,
+	                  priv->stats.elements, priv->stats.max_depth);
+	SOUP_SOAP_MARK_END (mark_begin, "persist",
+	                    "%" G_GSIZE_FORMAT " bytes, %u elements",
+	                    priv->stats.output_bytes, priv->stats.elements);
+}
+
+static void
+stream_write (SoupSoapMessageStream *stream,
+              const gchar *data)
+{
+	persist_sink_write (&stream->sink, data, strlen (data), FALSE);
+}
+
+/* Escapes text the way xmlNewTextChild() does, and quotes as well in
+ * attribute values.
+ */
+static void
+stream_write_escaped (SoupSoapMessageStream *stream,
+                      const gchar *text,
+                      gboolean attribute)
+{
+	const gchar *run = text;
+	const gchar *entity;
 
+	for (; *text; text++)
+	{
+		switch (*text)
+		{
+			case '&':
+				entity = "&amp;";
+				break;
+			case '<':
+				entity = "&lt;";
+				break;
+			case '>':
+				entity = "&gt;";
+				break;
+			case '\r':
+				entity = "&#13;";
+				break;
+			case '"':
+				if (!attribute)
+					continue;
+				entity = "&quot;";
+				break;
+			default:
+				continue;
+		}
 
-	xmlFreeDoc (doc);
+		persist_sink_write (&stream->sink, run, text - run, FALSE);
+		stream_write (stream, entity);
+		run = text + 1;
+	}
 
+	persist_sink_write (&stream->sink, run, text - run, FALSE);
+}
 
-	soup_message_headers_set_content_type (priv->message_headers,
-	                                       "text/xml", NULL);
+static void
+stream_write_tag (SoupSoapMessageStream *stream,
+                  const gchar *opening,
+                  const gchar *prefix,
+                  const gchar *name)
+{
+	stream_write (stream, opening);
+	if (prefix)
+	{
+		stream_write (stream, prefix);
+		stream_write (stream, ":");
+	}
+	stream_write (stream, name);
+}
+
+static void
+stream_write_namespace (SoupSoapMessageStream *stream,
+                        xmlNsPtr ns)
+{
+	stream_write (stream, " xmlns:");
+	stream_write (stream, (const gchar *) ns->prefix);
+	stream_write (stream, "=\"");
+	stream_write_escaped (stream, (const gchar *) ns->href, TRUE);
+	stream_write (stream, "\"");
+}
+
+/* Writes the start of param, and all of it unless it is a group with
+ * elements, which is left open on the stack.  As with the tree, an
+ * element without a namespace takes that of its parent.  A namespace
+ * missing from the envelope, as in records from a producer, is declared
+ * on the element, and stays in scope until it is closed.
+ */
+static void
+stream_open_param (SoupSoapMessageStream *stream,
+                   SoupSoapParam *param,
+                   const gchar *parent_prefix)
+{
+	const gchar *namespace_uri = soup_soap_param_get_namespace_uri (param);
+	const gchar *name = soup_soap_param_get_name (param);
+	const gchar *prefix = parent_prefix;
+	SoupSoapMessagePrivate *priv = stream->msg->priv;
+	SoupSoapMessageStreamFrame frame;
+	xmlNsPtr declared = NULL;
+	GList *elements;
+
+	if (namespace_uri)
+	{
+		xmlNsPtr ns = g_hash_table_lookup (stream->namespaces, namespace_uri);
+
+		if (ns == NULL)
+		{
+			gchar *new_prefix = g_strdup_printf ("ns%u", stream->next_prefix++);
+
+			ns = declared = xmlNewNs (NULL, BAD_CAST namespace_uri,
+			                          BAD_CAST new_prefix);
+			g_free (new_prefix);
+		}
+
+		prefix = (const gchar *) ns->prefix;
+	}
+
+	SOUP_SOAP_PROBE1 (param__serialize, name);
+
+	stream_write_tag (stream, "<", prefix, name);
+	if (declared)
+		stream_write_namespace (stream, declared);
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+	{
+		const gchar *value = soup_soap_param_get_value (param);
+
+		stream_write (stream, ">");
+		if (value)
+			stream_write_escaped (stream, value, FALSE);
+		stream_write_tag (stream, "</", prefix, name);
+		stream_write (stream, ">");
+
+		if (declared)
+			xmlFreeNs (declared);
+		return;
+	}
+
+	/* The params stay open for records even without params of their own */
+	elements = _soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (param));
+	if (elements == NULL &&
+	    (param != SOUP_SOAP_PARAM (priv->body) || priv->producer == NULL))
+	{
+		stream_write (stream, "/>");
+
+		if (declared)
+			xmlFreeNs (declared);
+		return;
+	}
+
+	stream_write (stream, ">");
+
+	if (declared)
+		g_hash_table_insert (stream->namespaces, (gpointer) declared->href, declared);
+
+	frame.param = g_object_ref (param);
+	frame.cursor = elements;
+	frame.prefix = prefix;
+	frame.declared = declared;
+	g_array_append_val (stream->frames, frame);
+}
+
+/* Drops the namespace declared on the element of frame, if any */
+static void
+stream_frame_clear (SoupSoapMessageStream *stream,
+                    SoupSoapMessageStreamFrame *frame)
+{
+	if (frame->declared)
+	{
+		g_hash_table_remove (stream->namespaces, frame->declared->href);
+		xmlFreeNs (frame->declared);
+	}
+
+	g_object_unref (frame->param);
+}
+
+static void
+stream_write_envelope_start (SoupSoapMessageStream *stream)
+{
+	xmlNsPtr ns;
+
+	stream_write (stream, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	                      "<SOAP-ENV:Envelope");
+
+	for (ns = stream->envelope_node->nsDef; ns != NULL; ns = ns->next)
+		stream_write_namespace (stream, ns);
+
+	stream_write (stream, " SOAP-ENV:encodingStyle=\"" SOAP_ENCODING_STYLE "\">");
+}
+
+/* Appends the next record from the producer to the open params
+ * element, returning FALSE once there are no more.
+ */
+static gboolean
+stream_produce_record (SoupSoapMessageStream *stream,
+                       const gchar *prefix)
+{
+	SoupSoapMessagePrivate *priv = stream->msg->priv;
+	SoupSoapParam *record;
+
+	if (priv->producer == NULL || stream->producer_done)
+		return FALSE;
+
+	record = priv->producer (stream->msg, priv->producer_data);
+	if (record == NULL)
+	{
+		stream->producer_done = TRUE;
+		return FALSE;
+	}
+
+	g_object_ref_sink (record);
+	stream_open_param (stream, record, prefix);
+	g_object_unref (record);
+
+	stream->records++;
+
+	return TRUE;
+}
+
+/* Writes until STREAM_WINDOW_CHUNKS chunks are waiting to be sent, of
+ * which chunks_written are already out, and returns TRUE once the whole
+ * envelope has been written.
+ */
+static gboolean
+stream_produce (SoupSoapMessageStream *stream,
+                guint chunks_written)
+{
+	SoupSoapMessagePrivate *priv = stream->msg->priv;
+	SoupSoapMessageStreamFrame *frame;
+	SoupSoapParam *param;
+
+	while (stream->sink.chunks - chunks_written < STREAM_WINDOW_CHUNKS)
+	{
+		if (stream->frames->len == 0)
+		{
+			if (stream->section == STREAM_BODY)
+			{
+				stream_write (stream, "</SOAP-ENV:Body></SOAP-ENV:Envelope>\n");
+				return TRUE;
+			}
+
+			stream_write (stream, "<SOAP-ENV:Body>");
+			stream->section = STREAM_BODY;
+			stream_open_param (stream, SOUP_SOAP_PARAM (priv->body), "SOAP-ENV");
+			continue;
+		}
+
+		frame = &g_array_index (stream->frames, SoupSoapMessageStreamFrame,
+		                        stream->frames->len - 1);
+
+		if (frame->cursor)
+		{
+			param = frame->cursor->data;
+			frame->cursor = g_list_next (frame->cursor);
+
+			/* May grow the stack, moving frame */
+			stream_open_param (stream, param, frame->prefix);
+		}
+		else if (stream->frames->len == 1 && stream->section == STREAM_BODY &&
+		         stream_produce_record (stream, frame->prefix))
+			continue;
+		else
+		{
+			stream_write_tag (stream, "</", frame->prefix,
+			                  soup_soap_param_get_name (frame->param));
+			stream_write (stream, ">");
+			stream_frame_clear (stream, frame);
+			g_array_set_size (stream->frames, stream->frames->len - 1);
+		}
+	}
+
+	return FALSE;
+}
+
+/* Sets up a chunked persist of msg whose output goes to body, which need
+ * not be that of msg: the server fills a body of its own from a worker
+ * thread and hands the chunks over.
+ */
+SoupSoapMessageStream *
+_soup_soap_message_stream_new (SoupSoapMessage *msg,
+                               SoupMessageBody *body)
+{
+	SoupSoapMessagePrivate *priv = msg->priv;
+	SoupSoapMessageStream *stream = g_slice_new0 (SoupSoapMessageStream);
+
+	SOUP_SOAP_PROBE1 (message__persist__start, priv->wire_format);
+
+	stream->msg = g_object_ref (msg);
+	stream->wall_time = g_get_monotonic_time ();
+	stream->frames = g_array_new (FALSE, FALSE,
+	                              sizeof (SoupSoapMessageStreamFrame));
+	stream->namespaces = g_hash_table_new (g_str_hash, g_str_equal);
+	stream->envelope_node = create_envelope_node (priv, stream->namespaces);
+	/* Numbered on from those of the envelope; see collect_namespaces() */
+	stream->next_prefix = g_hash_table_size (stream->namespaces) - 3;
+	stream->section = STREAM_HEADER;
+
+	persist_sink_init (priv, &stream->sink, TRUE);
+	stream->sink.body = body;
+
+	soup_message_body_truncate (priv->message_body);
+	soup_message_body_set_accumulate (priv->message_body, FALSE);
+	soup_message_headers_set_encoding (priv->message_headers,
+	                                   SOUP_ENCODING_CHUNKED);
+
+	if (priv->wire_format == SOUP_SOAP_WIRE_FORMAT_XML)
+	{
+		stream_write_envelope_start (stream);
+		stream_open_param (stream, SOUP_SOAP_PARAM (priv->header), "SOAP-ENV");
+	}
+
+	return stream;
+}
+
+/* Writes the next window of output, see stream_produce().  Once this
+ * returns TRUE the output is complete, but the body is left open for the
+ * caller to complete once it has every chunk.
+ */
+gboolean
+_soup_soap_message_stream_produce (SoupSoapMessageStream *stream,
+                                   guint chunks_written)
+{
+	SoupSoapMessagePrivate *priv = stream->msg->priv;
+	gint64 cpu_time = _soup_soap_stats_get_cpu_time ();
+	GByteArray *data;
+
+	if (stream->done)
+		return TRUE;
+
+	/* There is no streaming binary encoder, so records are collected
+	 * into the tree and it is encoded in one go.
+	 */
+	if (priv->wire_format == SOUP_SOAP_WIRE_FORMAT_BINARY)
+	{
+		stream_drain_producer (priv, stream->msg);
+
+		data = _soup_soap_binary_encode (priv->header, priv->body);
+		persist_sink_write (&stream->sink, (const gchar *) data->data,
+		                    data->len, FALSE);
+		g_byte_array_unref (data);
+
+		stream->done = TRUE;
+	}
+	else
+		stream->done = stream_produce (stream, chunks_written);
+
+	if (stream->done)
+		persist_sink_write (&stream->sink, NULL, 0, TRUE);
+
+	stream->cpu_time += _soup_soap_stats_get_cpu_time () - cpu_time;
+
+	if (!stream->done)
+		return FALSE;
+
+	count_tree (priv);
+	priv->stats.elements += stream->records;
+	priv->stats.persist_wall_time = g_get_monotonic_time () - stream->wall_time;
+	priv->stats.persist_cpu_time = stream->cpu_time;
+	priv->stats.output_bytes = stream->sink.bytes;
+	/* Streams write text directly, without building nodes */
+	priv->stats.persist_nodes = 0;
+	priv->stats.output_chunks = stream->sink.chunks;
+	_soup_soap_stats_add_persist (&priv->stats);
+
+	SOUP_SOAP_PROBE3 (message__persist__done, priv->stats.output_bytes,
+	                  priv->stats.elements, priv->stats.max_depth);
+
+	return TRUE;
+}
+
+void
+_soup_soap_message_stream_free (SoupSoapMessageStream *stream)
+{
+	guint i;
+
+	for (i = 0; i < stream->frames->len; i++)
+		stream_frame_clear (stream, &g_array_index (stream->frames,
+		                                            SoupSoapMessageStreamFrame, i));
+
+	persist_sink_clear (&stream->sink);
+	g_hash_table_unref (stream->namespaces);
+	xmlFreeNode (stream->envelope_node);
+	g_array_unref (stream->frames);
+	g_object_unref (stream->msg);
+	g_slice_free (SoupSoapMessageStream, stream);
+}
+
+static void
+stream_closure_free (gpointer data,
+                     GClosure *closure)
+{
+	_soup_soap_message_stream_free (data);
+}
+
+/* Produces the next window and, once done, completes the body and
+ * detaches from the message, which frees stream.
+ */
+static void
+stream_resume (SoupSoapMessageStream *stream)
+{
+	if (!_soup_soap_message_stream_produce (stream, stream->chunks_written))
+		return;
+
+	soup_message_body_complete (stream->msg->priv->message_body);
+
+	g_signal_handler_disconnect (stream->message, stream->wrote_chunk_id);
+}
+
+static void
+stream_wrote_chunk (SoupMessage *message,
+                    gpointer user_data)
+{
+	SoupSoapMessageStream *stream = user_data;
+
+	stream->chunks_written++;
+	stream_resume (stream);
+}
+
+/* Like soup_soap_message_persist(), but sends the body chunked and
+ * writes the envelope as it goes out: only a few chunks of output exist
+ * at any time, and the envelope is never built as a document.  message
+ * must be the SoupMessage whose headers and body msg uses.  As written
+ * chunks are discarded, the body cannot be sent again, so message must
+ * not be redirected or requeued.  The binary wire format is encoded in
+ * one go, then sent chunked.
+ */
+void
+soup_soap_message_persist_chunked (SoupSoapMessage *msg,
+                                   SoupMessage *message)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
+	g_return_if_fail (SOUP_IS_MESSAGE (message));
+	g_return_if_fail (msg->priv->message_body == message->request_body ||
+	                  msg->priv->message_body == message->response_body);
+
+	SoupSoapMessageStream *stream =
+		_soup_soap_message_stream_new (msg, msg->priv->message_body);
+
+	stream->message = message;
+	stream->wrote_chunk_id = g_signal_connect_data (message, "wrote-chunk",
+	                                                G_CALLBACK (stream_wrote_chunk),
+	                                                stream, stream_closure_free, 0);
+
+	stream_resume (stream);
+}
+
+/* Sets a function returning records to send after the params, one at a
+ * time and NULL at the end, so that a large result need not be held in
+ * memory.  soup_soap_message_persist_chunked() asks for records as the
+ * body is sent; soup_soap_message_persist() adds them all to the params
+ * first.  The producer is called from one thread at a time, though not
+ * always the same one.
+ */
+void
+soup_soap_message_set_producer (SoupSoapMessage *msg,
+                                SoupSoapMessageProducer producer,
+                                gpointer user_data,
+                                GDestroyNotify destroy)
+{
+	g_return_if_fail (SOUP_SOAP_IS_MESSAGE (msg));
+
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	if (priv->producer_destroy)
+		priv->producer_destroy (priv->producer_data);
+
+	priv->producer = producer;
+	priv->producer_data = user_data;
+	priv->producer_destroy = destroy;
+}
+
+gboolean
+soup_soap_message_has_producer (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), FALSE);
+
+	return msg->priv->producer != NULL;
+}
+
+/* Bytes held by the message: its param trees, the names they use once
+ * each, and the raw body.
+ */
+gsize
+soup_soap_message_get_memory_usage (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), 0);
+
+	SoupSoapMessagePrivate *priv = msg->priv;
+
+	GHashTable *names = g_hash_table_new (g_direct_hash, g_direct_equal);
+	gsize size;
+
+	size = sizeof (SoupSoapMessage) + sizeof (SoupSoapMessagePrivate) +
+	       _soup_soap_param_tree_get_memory_usage (SOUP_SOAP_PARAM (priv->header), names) +
+	       _soup_soap_param_tree_get_memory_usage (SOUP_SOAP_PARAM (priv->body), names);
+
+	g_hash_table_unref (names);
+
+	if (priv->message_body)
+		size += priv->message_body->length;
+
+	return size;
+}
+
+/* Sets the budget of messages that do not set "memory-limit", and the
+ * budget shared by all parsed messages alive at once; 0 means no limit.
+ * A parse that goes over either fails with
+ * SOUP_SOAP_MESSAGE_ERROR_TOO_LARGE.
+ */
+void
+soup_soap_message_set_memory_limits (gsize message_limit,
+                                     gsize global_limit)
+{
+	g_atomic_pointer_set (&default_memory_limit, message_limit);
+	g_atomic_pointer_set (&global_memory_limit, global_limit);
+}
+
+/* Bytes charged by the parser to messages that are still alive */
+gsize
+soup_soap_message_get_global_memory_usage (void)
+{
+	return (gsize) g_atomic_pointer_get (&global_memory_usage);
+}
+
+/* Counters of the last parse and persist of this message */
+const SoupSoapMessageStats *
+soup_soap_message_get_stats (SoupSoapMessage *msg)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_MESSAGE (msg), NULL);
+
+	return &msg->priv->stats;
 }
@@ -21,6 +21,11 @@
 #define _SOUP_SOAP_MESSAGE_H_
 
 #include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap-param-group.h>
+#include <libsoup-soap/soup-soap-path.h>
+#include <libsoup-soap/soup-soap-schema.h>
+#include <libsoup-soap/soup-soap-stats.h>
 
 G_BEGIN_DECLS
 
@@ -31,6 +36,25 @@ G_BEGIN_DECLS
 #define SOUP_SOAP_IS_MESSAGE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_MESSAGE))
 #define SOUP_SOAP_MESSAGE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_MESSAGE, SoupSoapMessageClass))
 
+typedef enum
+{
+	SOUP_SOAP_CONTENT_ENCODING_IDENTITY,
+	SOUP_SOAP_CONTENT_ENCODING_GZIP,
+	SOUP_SOAP_CONTENT_ENCODING_DEFLATE
+} SoupSoapContentEncoding;
+
+#define SOUP_SOAP_TYPE_CONTENT_ENCODING (soup_soap_content_encoding_get_type ())
+
+typedef enum
+{
+	SOUP_SOAP_WIRE_FORMAT_XML,
+	SOUP_SOAP_WIRE_FORMAT_BINARY
+} SoupSoapWireFormat;
+
+#define SOUP_SOAP_TYPE_WIRE_FORMAT (soup_soap_wire_format_get_type ())
+
+#define SOUP_SOAP_BINARY_CONTENT_TYPE "application/x-soup-soap-binary"
+
 typedef struct _SoupSoapMessagePrivate SoupSoapMessagePrivate;
 typedef struct _SoupSoapMessageClass SoupSoapMessageClass;
 typedef struct _SoupSoapMessage SoupSoapMessage;
@@ -47,15 +71,59 @@ struct _SoupSoapMessage
 	SoupSoapMessagePrivate *priv;
 };
 
+/* Returns the next record to send, or NULL when there are no more */
+typedef SoupSoapParam *(*SoupSoapMessageProducer) (SoupSoapMessage *msg,
+                                                   gpointer user_data);
+
 GType soup_soap_message_get_type (void) G_GNUC_CONST;
 SoupSoapMessage *soup_soap_message_new (SoupMessageHeaders *headers, SoupMessageBody *body);
+SoupSoapMessage *soup_soap_message_new_with_schema (SoupMessageHeaders *headers, SoupMessageBody *body, SoupSoapSchema *schema);
+SoupSoapMessage *soup_soap_message_new_selective (SoupMessageHeaders *headers, SoupMessageBody *body, SoupSoapPath **paths, guint n_paths);
 SoupSoapMessage *soup_soap_message_new_request (SoupMessage *msg);
 SoupSoapMessage *soup_soap_message_new_response (SoupMessage *msg);
+void soup_soap_message_new_async (SoupMessageHeaders *headers, SoupMessageBody *body, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void soup_soap_message_new_request_async (SoupMessage *msg, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void soup_soap_message_new_response_async (SoupMessage *msg, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+SoupSoapMessage *soup_soap_message_new_finish (GAsyncResult *result, GError **error);
+gboolean soup_soap_message_peek (SoupMessageHeaders *headers, SoupMessageBody *body, const gchar * const *header_names, gchar **operation_name, SoupSoapParamGroup **header, GError **error);
+const GError *soup_soap_message_get_parse_error (SoupSoapMessage *msg);
 const gchar *soup_soap_message_get_operation_name (SoupSoapMessage *msg);
 void soup_soap_message_set_operation_name (SoupSoapMessage *msg, const gchar *name);
+gboolean soup_soap_message_has_operation (SoupSoapMessage *msg);
 SoupSoapParamGroup *soup_soap_message_get_header (SoupSoapMessage *msg);
 SoupSoapParamGroup *soup_soap_message_get_params (SoupSoapMessage *msg);
+gchar *soup_soap_message_get_digest (SoupSoapMessage *msg);
+gboolean soup_soap_message_is_fault (SoupSoapMessage *msg);
+void soup_soap_message_set_fault (SoupSoapMessage *msg, const gchar *code, const gchar *string);
+SoupSoapContentEncoding soup_soap_message_get_content_encoding (SoupSoapMessage *msg);
+void soup_soap_message_set_content_encoding (SoupSoapMessage *msg, SoupSoapContentEncoding encoding);
+SoupSoapWireFormat soup_soap_message_get_wire_format (SoupSoapMessage *msg);
+void soup_soap_message_set_wire_format (SoupSoapMessage *msg, SoupSoapWireFormat format);
 void soup_soap_message_persist (SoupSoapMessage *msg);
+void soup_soap_message_persist_chunked (SoupSoapMessage *msg, SoupMessage *message);
+void soup_soap_message_set_producer (SoupSoapMessage *msg, SoupSoapMessageProducer producer, gpointer user_data, GDestroyNotify destroy);
+gboolean soup_soap_message_has_producer (SoupSoapMessage *msg);
+const SoupSoapMessageStats *soup_soap_message_get_stats (SoupSoapMessage *msg);
+gsize soup_soap_message_get_memory_usage (SoupSoapMessage *msg);
+void soup_soap_message_set_memory_limits (gsize message_limit, gsize global_limit);
+gsize soup_soap_message_get_global_memory_usage (void);
+GType soup_soap_content_encoding_get_type (void) G_GNUC_CONST;
+GType soup_soap_wire_format_get_type (void) G_GNUC_CONST;
+SoupSoapContentEncoding soup_soap_content_encoding_negotiate (SoupMessageHeaders *request_headers);
+
+typedef enum
+{
+	SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+	SOUP_SOAP_MESSAGE_ERROR_TOO_LARGE,
+	SOUP_SOAP_MESSAGE_ERROR_INCOMPLETE,
+	SOUP_SOAP_MESSAGE_ERROR_FAULT,
+	SOUP_SOAP_MESSAGE_ERROR_UNSUPPORTED
+} SoupSoapMessageError;
+
+#define SOUP_SOAP_MESSAGE_ERROR soup_soap_message_error_quark()
+
+GQuark soup_soap_message_error_quark (void);
+
 G_END_DECLS
 
 #endif /* _SOUP_SOAP_MESSAGE_H_ */
@@ -20,17 +20,135 @@
 #include <config.h>
 #include <glib/gi18n.h>
 
+#include <string.h>
+
 #include <libsoup/soup.h>
 #include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
 
 struct _SoupSoapParamGroupPrivate
 {
 	GList *elements;
+	/* Tail of elements, so that appending does not walk the list */
+	GList *last;
 };
 
 #define SOUP_SOAP_PARAM_GROUP_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_PARAM_GROUP, SoupSoapParamGroupPrivate))
 
 
+/* Every group holding a param is recorded on it, as its owner or as a
+ * sharer, so that params found in more than one tree are known.
+ */
+static gpointer
+element_ref (gconstpointer param,
+             gpointer group)
+{
+	_soup_soap_param_hold ((SoupSoapParam *) param, group);
+
+	return g_object_ref_sink ((gpointer) param);
+}
+
+static void
+element_unref (gpointer param,
+               gpointer group)
+{
+	_soup_soap_param_release (param, group);
+	g_object_unref (param);
+}
+
+static void
+free_elements (SoupSoapParamGroup *group)
+{
+	GList *link;
+
+	for (link = group->priv->elements; link != NULL; link = g_list_next (link))
+		element_unref (link->data, group);
+
+	g_list_free (group->priv->elements);
+}
+
+static void
+replace_element (SoupSoapParamGroup *group,
+                 SoupSoapParam *element,
+                 SoupSoapParam *replacement)
+{
+	GList *link = g_list_find (group->priv->elements, element);
+
+	link->data = element_ref (replacement, group);
+	element_unref (element, group);
+}
+
+/* Returns the element at link, an element of group, first replacing it
+ * by a copy if group only shares it.  Everything that hands elements out
+ * goes through this, so that a param reached from a group belongs to
+ * that group's tree, and changing it cannot reach another tree.
+ */
+SoupSoapParam *
+_soup_soap_param_group_adopt (SoupSoapParamGroup *group,
+                              GList *link)
+{
+	SoupSoapParam *element = link->data;
+	SoupSoapParam *copy;
+
+	if (_soup_soap_param_get_owner (element) == group)
+		return element;
+
+	copy = _soup_soap_param_copy (element);
+	link->data = element_ref (copy, group);
+	element_unref (element, group);
+
+	return copy;
+}
+
+/* Copies the params on path, which runs from a param down to one of its
+ * descendants; everything off the path stays shared.
+ */
+static SoupSoapParam *
+copy_path (GSList *path)
+{
+	SoupSoapParam *copy = _soup_soap_param_copy (path->data);
+
+	if (path->next)
+		replace_element (SOUP_SOAP_PARAM_GROUP (copy), path->next->data,
+		                 copy_path (path->next));
+
+	return copy;
+}
+
+/* Called before param is changed in place.  Every group sharing param,
+ * or sharing one of the groups that own it, is given a copy of the path
+ * down to param as it is now, so that the change is only seen by the
+ * tree owning param.
+ */
+void
+_soup_soap_param_unshare (SoupSoapParam *param)
+{
+	SoupSoapParam *node;
+	SoupSoapParamGroup *sharer;
+	GSList *path = NULL;
+
+	for (node = param; node != NULL;
+	     node = (SoupSoapParam *) _soup_soap_param_get_owner (node))
+	{
+		if (_soup_soap_param_get_sharer (node))
+			break;
+	}
+
+	if (node == NULL)
+		return;
+
+	for (node = param; node != NULL;
+	     node = (SoupSoapParam *) _soup_soap_param_get_owner (node))
+	{
+		path = g_slist_prepend (path, node);
+
+		while ((sharer = _soup_soap_param_get_sharer (node)) != NULL)
+			replace_element (sharer, node, copy_path (path));
+	}
+
+	g_slist_free (path);
+}
+
 
 G_DEFINE_TYPE (SoupSoapParamGroup, soup_soap_param_group, SOUP_SOAP_TYPE_PARAM);
 
@@ -41,6 +159,7 @@ soup_soap_param_group_init (SoupSoapParamGroup *object)
 	SoupSoapParamGroupPrivate *priv = object->priv;
 
 	priv->elements = NULL;
+	priv->last = NULL;
 }
 
 static void
@@ -49,8 +168,7 @@ soup_soap_param_group_finalize (GObject *object)
 	SoupSoapParamGroup *group = SOUP_SOAP_PARAM_GROUP (object);
 	SoupSoapParamGroupPrivate *priv = group->priv;
 
-	if (priv->elements)
-		g_list_free_full (priv->elements, g_object_unref);
+	free_elements (group);
 
 	G_OBJECT_CLASS (soup_soap_param_group_parent_class)->finalize (object);
 }
@@ -72,9 +190,55 @@ soup_soap_param_group_new (const gchar *name)
 {
 	g_return_val_if_fail (name != NULL && *name != '\0', NULL);
 
-	return g_object_new (SOUP_SOAP_TYPE_PARAM_GROUP,
-	                     "name", name,
-	                     NULL);
+	SoupSoapParamGroup *group = g_object_new (SOUP_SOAP_TYPE_PARAM_GROUP, NULL);
+
+	soup_soap_param_set_name (SOUP_SOAP_PARAM (group), name);
+
+	return group;
+}
+
+/* Returns a group with the same elements, which are shared rather than
+ * copied.  group keeps owning them and can still change them; the copy
+ * is then given its own copies of the params on the path of the change.
+ * An element is only copied into the copy once it is reached through it,
+ * see _soup_soap_param_group_adopt(), so both trees can be changed freely
+ * and each change is only seen by the tree it was made through.  A param
+ * added to more than one group belongs to the first in the same way.
+ */
+SoupSoapParamGroup *
+soup_soap_param_group_copy (SoupSoapParamGroup *group)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
+
+	SoupSoapParamGroup *copy = g_object_new (G_OBJECT_TYPE (group), NULL);
+	SoupSoapParam *param = SOUP_SOAP_PARAM (group);
+
+	_soup_soap_param_copy_name (SOUP_SOAP_PARAM (copy), param);
+
+	copy->priv->elements = g_list_copy_deep (group->priv->elements,
+	                                         element_ref, copy);
+	copy->priv->last = g_list_last (copy->priv->elements);
+
+	return copy;
+}
+
+/* Returns element, an element of group, in a form that belongs to
+ * group's tree: element itself, or the copy that replaces it in group if
+ * group only shared it.  For a param kept from before a
+ * soup_soap_param_group_copy(), this gives the one in group's tree.
+ */
+SoupSoapParam *
+soup_soap_param_group_get_writable (SoupSoapParamGroup *group,
+                                    SoupSoapParam *element)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (element), NULL);
+
+	GList *link = g_list_find (group->priv->elements, element);
+
+	g_return_val_if_fail (link != NULL, NULL);
+
+	return _soup_soap_param_group_adopt (group, link);
 }
 
 GList *
@@ -83,10 +247,98 @@ soup_soap_param_group_get_elements (SoupSoapParamGroup *group)
 	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
 
 	SoupSoapParamGroupPrivate *priv = group->priv;
+	GList *link;
+
+	for (link = priv->elements; link != NULL; link = g_list_next (link))
+		_soup_soap_param_group_adopt (group, link);
 
 	return g_list_copy (priv->elements);
 }
 
+/* Returns the element list itself, for walks that must not allocate */
+GList *
+_soup_soap_param_group_peek_elements (SoupSoapParamGroup *group)
+{
+	return group->priv->elements;
+}
+
+/* Replaces the elements with a list whose references are already owned */
+void
+_soup_soap_param_group_set_elements (SoupSoapParamGroup *group,
+                                     GList *elements)
+{
+	SoupSoapParamGroupPrivate *priv = group->priv;
+	GList *link;
+
+	_soup_soap_param_unshare (SOUP_SOAP_PARAM (group));
+	free_elements (group);
+
+	for (link = elements; link != NULL; link = g_list_next (link))
+		_soup_soap_param_hold (link->data, group);
+
+	priv->elements = elements;
+	priv->last = g_list_last (elements);
+}
+
+GList *
+_soup_soap_param_group_steal_elements (SoupSoapParamGroup *group)
+{
+	GList *elements = group->priv->elements;
+	GList *link;
+
+	_soup_soap_param_unshare (SOUP_SOAP_PARAM (group));
+
+	for (link = elements; link != NULL; link = g_list_next (link))
+		_soup_soap_param_release (link->data, group);
+
+	group->priv->elements = NULL;
+	group->priv->last = NULL;
+
+	return elements;
+}
+
+/* Bytes held by a param and everything below it.  Names are shared
+ * between params, so they are only counted, once each, when names is given.
+ */
+gsize
+_soup_soap_param_tree_get_memory_usage (SoupSoapParam *param,
+                                        GHashTable *names)
+{
+	const gchar *strings[2];
+	gsize size = _soup_soap_param_get_own_size (param);
+	GList *elements;
+	guint i;
+
+	if (names)
+	{
+		strings[0] = soup_soap_param_get_name (param);
+		strings[1] = soup_soap_param_get_namespace_uri (param);
+
+		for (i = 0; i < G_N_ELEMENTS (strings); i++)
+		{
+			if (strings[i] && !g_hash_table_contains (names, strings[i]))
+			{
+				g_hash_table_add (names, (gpointer) strings[i]);
+				size += strlen (strings[i]) + 1;
+			}
+		}
+	}
+
+	if (!SOUP_SOAP_IS_PARAM_GROUP (param))
+		return size;
+
+	size += sizeof (SoupSoapParamGroup) - sizeof (SoupSoapParam) +
+	        sizeof (SoupSoapParamGroupPrivate);
+
+	for (elements = SOUP_SOAP_PARAM_GROUP (param)->priv->elements;
+	     elements != NULL;
+	     elements = g_list_next (elements))
+		size += sizeof (GList) +
+		        _soup_soap_param_tree_get_memory_usage (elements->data, names);
+
+	return size;
+}
+
 guint
 soup_soap_param_group_get_elements_length (SoupSoapParamGroup *group)
 {
@@ -106,7 +358,31 @@ soup_soap_param_group_add (SoupSoapParamGroup *group,
 
 	SoupSoapParamGroupPrivate *priv = group->priv;
 
-	priv->elements = g_list_append (priv->elements, g_object_ref_sink (param));
+	_soup_soap_param_unshare (SOUP_SOAP_PARAM (group));
+
+	GList *link = g_list_alloc ();
+
+	link->data = element_ref (param, group);
+	link->prev = priv->last;
+
+	if (priv->last)
+		priv->last->next = link;
+	else
+		priv->elements = link;
+
+	priv->last = link;
+}
+
+void
+soup_soap_param_group_add_qualified (SoupSoapParamGroup *group,
+                                     const gchar *namespace_uri,
+                                     SoupSoapParam *param)
+{
+	g_return_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group));
+	g_return_if_fail (SOUP_SOAP_IS_PARAM (param));
+
+	soup_soap_param_set_namespace_uri (param, namespace_uri);
+	soup_soap_param_group_add (group, param);
 }
 
 void
@@ -128,18 +404,10 @@ soup_soap_param_group_add_multiple_valist (SoupSoapParamGroup *group,
 {
 	g_return_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group));
 
-	SoupSoapParamGroupPrivate *priv = group->priv;
-
 	SoupSoapParam *param;
-	GList *new_elements = NULL;
 
 	while ((param = va_arg (var_args, SoupSoapParam *)))
-	{
-		new_elements = g_list_prepend (new_elements, g_object_ref_sink (param));
-	}
-
-	new_elements = g_list_reverse (new_elements);
-	priv->elements = g_list_concat (priv->elements, new_elements);
+		soup_soap_param_group_add (group, param);
 }
 
 SoupSoapParam *
@@ -153,13 +421,15 @@ soup_soap_param_group_get (SoupSoapParamGroup *group,
 
 	SoupSoapParam *param;
 	GList *elements = priv->elements;
+	const gchar *param_name;
 
 	while (elements)
 	{
 		param = elements->data;
+		param_name = soup_soap_param_get_name (param);
 
-		if (g_strcmp0 (name, soup_soap_param_get_name (param)) == 0)
-			return param;
+		if (param_name == name || strcmp (param_name, name) == 0)
+			return _soup_soap_param_group_adopt (group, elements);
 
 		elements = g_list_next (elements);
 	}
@@ -167,6 +437,35 @@ soup_soap_param_group_get (SoupSoapParamGroup *group,
 	return NULL;
 }
 
+/* Unlike soup_soap_param_group_get(), which matches any namespace, this
+ * only matches the element name in namespace_uri (NULL for none).
+ */
+SoupSoapParam *
+soup_soap_param_group_get_qualified (SoupSoapParamGroup *group,
+                                     const gchar *namespace_uri,
+                                     const gchar *name)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
+	g_return_val_if_fail (name != NULL && *name != '\0', NULL);
+
+	SoupSoapParamGroupPrivate *priv = group->priv;
+
+	GList *elements;
+
+	if (namespace_uri && *namespace_uri == '\0')
+		namespace_uri = NULL;
+
+	for (elements = priv->elements;
+	     elements != NULL;
+	     elements = g_list_next (elements))
+	{
+		if (_soup_soap_param_has_name (elements->data, namespace_uri, name))
+			return _soup_soap_param_group_adopt (group, elements);
+	}
+
+	return NULL;
+}
+
 void
 soup_soap_param_group_get_multiple (SoupSoapParamGroup *group,
                                     ...)
@@ -196,3 +495,194 @@ soup_soap_param_group_get_multiple_valist (SoupSoapParamGroup *group,
 			*param = soup_soap_param_group_get (group, name);
 	}
 }
+
+typedef struct
+{
+	const gchar *name;
+	GVariant **values;
+	guint n_values;
+} VariantEntry;
+
+static GVariant *
+param_to_variant (SoupSoapParam *param)
+{
+	const gchar *value;
+
+	if (SOUP_SOAP_IS_PARAM_GROUP (param))
+		return soup_soap_param_group_to_variant (SOUP_SOAP_PARAM_GROUP (param));
+
+	value = soup_soap_param_get_value (param);
+
+	return g_variant_new_string (value ? value : "");
+}
+
+/* Converts the elements of group into an a{sv} dictionary.  Values are
+ * "s" for leaves, "a{sv}" for groups, and "av" for names that occur more
+ * than once, in order of first occurrence.  Leaves stay strings since the
+ * tree carries no type information.  The result is floating.
+ */
+GVariant *
+soup_soap_param_group_to_variant (SoupSoapParamGroup *group)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
+
+	SoupSoapParamGroupPrivate *priv = group->priv;
+
+	GList *curr_element;
+	GHashTable *index;
+	VariantEntry *entries;
+	GVariant **values, **children, **cursor;
+	GVariant *result;
+	guint n_elements, n_entries = 0, i;
+
+	n_elements = g_list_length (priv->elements);
+	if (n_elements == 0)
+		return g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0);
+
+	/* All values go into one block, so that each entry's values are
+	 * contiguous and can be handed to g_variant_new_array() as they are.
+	 */
+	entries = g_new (VariantEntry, n_elements);
+	values = g_new (GVariant *, n_elements);
+	index = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (curr_element = priv->elements;
+	     curr_element != NULL;
+	     curr_element = g_list_next (curr_element))
+	{
+		const gchar *name = soup_soap_param_get_name (curr_element->data);
+		VariantEntry *entry = g_hash_table_lookup (index, name);
+
+		if (entry == NULL)
+		{
+			entry = &entries[n_entries++];
+			entry->name = name;
+			entry->n_values = 0;
+			g_hash_table_insert (index, (gpointer) name, entry);
+		}
+
+		entry->n_values++;
+	}
+
+	for (i = 0, cursor = values; i < n_entries; i++)
+	{
+		entries[i].values = cursor;
+		cursor += entries[i].n_values;
+		entries[i].n_values = 0;
+	}
+
+	for (curr_element = priv->elements;
+	     curr_element != NULL;
+	     curr_element = g_list_next (curr_element))
+	{
+		VariantEntry *entry =
+			g_hash_table_lookup (index,
+			                     soup_soap_param_get_name (curr_element->data));
+		entry->values[entry->n_values++] = param_to_variant (curr_element->data);
+	}
+
+	children = g_new (GVariant *, n_entries);
+
+	for (i = 0; i < n_entries; i++)
+	{
+		VariantEntry *entry = &entries[i];
+		GVariant *value;
+		guint j;
+
+		if (entry->n_values == 1)
+			value = entry->values[0];
+		else
+		{
+			for (j = 0; j < entry->n_values; j++)
+				entry->values[j] = g_variant_new_variant (entry->values[j]);
+
+			value = g_variant_new_array (G_VARIANT_TYPE_VARIANT,
+			                             entry->values, entry->n_values);
+		}
+
+		children[i] = g_variant_new_dict_entry (g_variant_new_string (entry->name),
+		                                        g_variant_new_variant (value));
+	}
+
+	result = g_variant_new_array (G_VARIANT_TYPE ("{sv}"), children, n_entries);
+
+	g_free (children);
+	g_hash_table_unref (index);
+	g_free (values);
+	g_free (entries);
+
+	return result;
+}
+
+static SoupSoapParam *
+param_from_variant (const gchar *name,
+                    GVariant *value)
+{
+	if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+		return soup_soap_param_new_value (name,
+		                                  g_variant_get_string (value, NULL));
+
+	if (g_variant_is_of_type (value, G_VARIANT_TYPE ("a{sv}")))
+		return SOUP_SOAP_PARAM (soup_soap_param_group_from_variant (name, value));
+
+	return NULL;
+}
+
+/* The inverse of soup_soap_param_group_to_variant().  Repeated elements
+ * come back next to each other, and values of any other type are skipped.
+ */
+SoupSoapParamGroup *
+soup_soap_param_group_from_variant (const gchar *name,
+                                    GVariant *variant)
+{
+	g_return_val_if_fail (name != NULL && *name != '\0', NULL);
+	g_return_val_if_fail (variant != NULL, NULL);
+	g_return_val_if_fail (g_variant_is_of_type (variant, G_VARIANT_TYPE ("a{sv}")), NULL);
+
+	SoupSoapParamGroup *group = soup_soap_param_group_new (name);
+	SoupSoapParamGroupPrivate *priv = group->priv;
+
+	GVariantIter iter;
+	const gchar *key;
+	GVariant *value;
+	GList *new_elements = NULL;
+
+	g_variant_iter_init (&iter, variant);
+
+	while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+	{
+		SoupSoapParam *param;
+
+		if (g_variant_is_of_type (value, G_VARIANT_TYPE ("av")))
+		{
+			GVariantIter array_iter;
+			GVariant *item;
+
+			g_variant_iter_init (&array_iter, value);
+
+			while (g_variant_iter_next (&array_iter, "v", &item))
+			{
+				param = param_from_variant (key, item);
+				if (param)
+					new_elements = g_list_prepend (new_elements,
+					                               element_ref (param, group));
+				g_variant_unref (item);
+			}
+		}
+		else
+		{
+			param = param_from_variant (key, value);
+			if (param)
+				new_elements = g_list_prepend (new_elements,
+				                               element_ref (param, group));
+		}
+
+		g_variant_unref (value);
+	}
+
+	/* The first element prepended ends up last */
+	priv->last = new_elements;
+	priv->elements = g_list_reverse (new_elements);
+
+	return group;
+}
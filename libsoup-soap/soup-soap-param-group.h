@@ -21,6 +21,7 @@
 #define _SOUP_SOAP_PARAM_GROUP_H_
 
 #include <glib-object.h>
+#include <libsoup-soap/soup-soap-param.h>
 
 G_BEGIN_DECLS
 
@@ -49,14 +50,20 @@ struct _SoupSoapParamGroup
 
 GType soup_soap_param_group_get_type (void) G_GNUC_CONST;
 SoupSoapParamGroup *soup_soap_param_group_new (const gchar *name);
+SoupSoapParamGroup *soup_soap_param_group_copy (SoupSoapParamGroup *group);
+SoupSoapParam *soup_soap_param_group_get_writable (SoupSoapParamGroup *group, SoupSoapParam *element);
 GList *soup_soap_param_group_get_elements (SoupSoapParamGroup *group);
 guint soup_soap_param_group_get_elements_length (SoupSoapParamGroup *group);
 void soup_soap_param_group_add (SoupSoapParamGroup *group, SoupSoapParam *param);
+void soup_soap_param_group_add_qualified (SoupSoapParamGroup *group, const gchar *namespace_uri, SoupSoapParam *param);
 void soup_soap_param_group_add_multiple (SoupSoapParamGroup *group, ...);
 void soup_soap_param_group_add_multiple_valist (SoupSoapParamGroup *group, va_list var_args);
 SoupSoapParam *soup_soap_param_group_get (SoupSoapParamGroup *group, const gchar *name);
+SoupSoapParam *soup_soap_param_group_get_qualified (SoupSoapParamGroup *group, const gchar *namespace_uri, const gchar *name);
 void soup_soap_param_group_get_multiple (SoupSoapParamGroup *group, ...);
 void soup_soap_param_group_get_multiple_valist (SoupSoapParamGroup *group, va_list var_args);
+GVariant *soup_soap_param_group_to_variant (SoupSoapParamGroup *group);
+SoupSoapParamGroup *soup_soap_param_group_from_variant (const gchar *name, GVariant *variant);
 
 G_END_DECLS
 
@@ -22,14 +22,29 @@
 
 #include <libsoup/soup.h>
 #include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+#include <libsoup-soap/soup-soap-probes.h>
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct _SoupSoapParamPrivate
 {
-	gchar *name;
+	/* Either interned or counted copies; see counted_string_new() */
+	const gchar *name;
+	const gchar *namespace_uri;
+	gboolean name_counted;
+	gboolean namespace_counted;
 	gchar *value;
+
+	/* The first group to hold the param owns it, as many times as it
+	 * holds it; any other group holding it shares it, and is given a
+	 * copy of the old param before it is changed.
+	 */
+	SoupSoapParamGroup *owner;
+	guint owner_holds;
+	GSList *sharers;
 };
 
 #define SOUP_SOAP_PARAM_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_PARAM, SoupSoapParamPrivate))
@@ -39,9 +54,92 @@ enum
 	PROP_0,
 
 	PROP_NAME,
+	PROP_NAMESPACE_URI,
 	PROP_VALUE,
 };
 
+/* Names that are not already interned, which includes everything read
+ * from the wire, are kept in reference-counted copies instead, so that
+ * untrusted input cannot grow the process-wide intern table.
+ */
+typedef struct
+{
+	volatile gint ref_count;
+	gchar string[1];
+} CountedString;
+
+#define COUNTED_STRING(s) ((CountedString *) ((s) - G_STRUCT_OFFSET (CountedString, string)))
+
+struct _SoupSoapStringPool
+{
+	GHashTable *strings;
+};
+
+
+static const gchar *
+counted_string_new (const gchar *string)
+{
+	gsize length = strlen (string);
+	CountedString *counted = g_malloc (G_STRUCT_OFFSET (CountedString, string) + length + 1);
+
+	counted->ref_count = 1;
+	memcpy (counted->string, string, length + 1);
+
+	return counted->string;
+}
+
+static void
+counted_string_ref (const gchar *string)
+{
+	g_atomic_int_inc (&COUNTED_STRING (string)->ref_count);
+}
+
+static void
+counted_string_unref (gpointer string)
+{
+	CountedString *counted = COUNTED_STRING ((const gchar *) string);
+
+	if (g_atomic_int_dec_and_test (&counted->ref_count))
+		g_free (counted);
+}
+
+/* A string is counted when it comes from counted_string_new() */
+static void
+replace_string (const gchar **field,
+                gboolean *field_counted,
+                const gchar *string,
+                gboolean counted)
+{
+	if (counted)
+		counted_string_ref (string);
+	if (*field_counted)
+		counted_string_unref ((gpointer) *field);
+
+	*field = string;
+	*field_counted = counted;
+}
+
+/* Uses the interned copy of string when there already is one */
+static void
+replace_string_copy (const gchar **field,
+                     gboolean *field_counted,
+                     const gchar *string)
+{
+	GQuark quark = string ? g_quark_try_string (string) : 0;
+	const gchar *copy;
+
+	if (string == NULL || quark != 0)
+	{
+		replace_string (field, field_counted,
+		                quark ? g_quark_to_string (quark) : NULL, FALSE);
+		return;
+	}
+
+	copy = counted_string_new (string);
+	replace_string (field, field_counted, copy, TRUE);
+	counted_string_unref ((gpointer) copy);
+}
+
 
 /* Parts taken from GLib
  *
@@ -414,8 +512,17 @@ soup_soap_param_init (SoupSoapParam *object)
 	object->priv = SOUP_SOAP_PARAM_GET_PRIVATE (object);
 	SoupSoapParamPrivate *priv = object->priv;
 
-	priv->name = NULL;
+	/* Set here rather than through a construct property, which would
+	 * copy the default into a GValue for every param.
+	 */
+	priv->name = g_intern_static_string ("no-name-set");
+	priv->namespace_uri = NULL;
+	priv->name_counted = FALSE;
+	priv->namespace_counted = FALSE;
 	priv->value = NULL;
+	priv->owner = NULL;
+	priv->owner_holds = 0;
+	priv->sharers = NULL;
 }
 
 static void
@@ -424,8 +531,10 @@ soup_soap_param_finalize (GObject *object)
 	SoupSoapParam *param = SOUP_SOAP_PARAM (object);
 	SoupSoapParamPrivate *priv = param->priv;
 
-	g_free (priv->name);
+	replace_string (&priv->name, &priv->name_counted, NULL, FALSE);
+	replace_string (&priv->namespace_uri, &priv->namespace_counted, NULL, FALSE);
 	g_free (priv->value);
+	g_slist_free (priv->sharers);
 
 	G_OBJECT_CLASS (soup_soap_param_parent_class)->finalize (object);
 }
@@ -446,6 +555,10 @@ soup_soap_param_set_property (GObject *object,
 			soup_soap_param_set_name (param,
 			                          g_value_get_string (value));
 			break;
+		case PROP_NAMESPACE_URI:
+			soup_soap_param_set_namespace_uri (param,
+			                                   g_value_get_string (value));
+			break;
 		case PROP_VALUE:
 			soup_soap_param_set_value (param,
 			                           g_value_get_string (value));
@@ -472,6 +585,10 @@ soup_soap_param_get_property (GObject *object,
 			g_value_set_string (value,
 			                    soup_soap_param_get_name (param));
 			break;
+		case PROP_NAMESPACE_URI:
+			g_value_set_string (value,
+			                    soup_soap_param_get_namespace_uri (param));
+			break;
 		case PROP_VALUE:
 			g_value_set_string (value,
 			                    soup_soap_param_get_value (param));
@@ -500,7 +617,15 @@ soup_soap_param_class_init (SoupSoapParamClass *klass)
 	                                                      "Param name",
 	                                                      "The name of the param of a SOAP operation",
 	                                                      "no-name-set",
-	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT));
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_NAMESPACE_URI,
+	                                 g_param_spec_string ("namespace-uri",
+	                                                      "Param namespace URI",
+	                                                      "The namespace of the param, or NULL if it has none",
+	                                                      NULL,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE));
 
 	g_object_class_install_property (object_class,
 	                                 PROP_VALUE,
@@ -518,9 +643,11 @@ soup_soap_param_new (const gchar *name)
 {
 	g_return_val_if_fail (name != NULL && *name != '\0', NULL);
 
-	return g_object_new (SOUP_SOAP_TYPE_PARAM,
-	                     "name", name,
-	                     NULL);
+	SoupSoapParam *param = g_object_new (SOUP_SOAP_TYPE_PARAM, NULL);
+
+	soup_soap_param_set_name (param, name);
+
+	return param;
 }
 
 SoupSoapParam *
@@ -624,8 +751,205 @@ soup_soap_param_set_name (SoupSoapParam *param,
 
 	SoupSoapParamPrivate *priv = param->priv;
 
-	g_free (priv->name);
-	priv->name = g_strdup (name);
+	_soup_soap_param_unshare (param);
+	replace_string_copy (&priv->name, &priv->name_counted, name);
+}
+
+const gchar *
+soup_soap_param_get_namespace_uri (SoupSoapParam *param)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (param), NULL);
+
+	return param->priv->namespace_uri;
+}
+
+void
+soup_soap_param_set_namespace_uri (SoupSoapParam *param,
+                                   const gchar *namespace_uri)
+{
+	g_return_if_fail (SOUP_SOAP_IS_PARAM (param));
+
+	SoupSoapParamPrivate *priv = param->priv;
+
+	_soup_soap_param_unshare (param);
+	replace_string_copy (&priv->namespace_uri, &priv->namespace_counted,
+	                     namespace_uri && *namespace_uri ? namespace_uri : NULL);
+}
+
+/* Strings from the same pool or the intern table are equal only when
+ * they are the same pointer, which is tried first.
+ */
+gboolean
+_soup_soap_param_has_name (SoupSoapParam *param,
+                           const gchar *namespace_uri,
+                           const gchar *name)
+{
+	SoupSoapParamPrivate *priv = param->priv;
+
+	if (priv->name != name && strcmp (priv->name, name) != 0)
+		return FALSE;
+
+	return priv->namespace_uri == namespace_uri ||
+	       (priv->namespace_uri && namespace_uri &&
+	        strcmp (priv->namespace_uri, namespace_uri) == 0);
+}
+
+/* Both strings must come from a SoupSoapStringPool; namespace_uri may
+ * be NULL.
+ */
+void
+_soup_soap_param_set_pooled_name (SoupSoapParam *param,
+                                  const gchar *namespace_uri,
+                                  const gchar *name)
+{
+	SoupSoapParamPrivate *priv = param->priv;
+
+	_soup_soap_param_unshare (param);
+	replace_string (&priv->name, &priv->name_counted, name, TRUE);
+	replace_string (&priv->namespace_uri, &priv->namespace_counted,
+	                namespace_uri, namespace_uri != NULL);
+}
+
+/* Returns a new floating param of type, named from a pool */
+SoupSoapParam *
+_soup_soap_param_new_pooled (GType type,
+                             const gchar *namespace_uri,
+                             const gchar *name)
+{
+	SoupSoapParam *param = g_object_new (type, NULL);
+
+	_soup_soap_param_set_pooled_name (param, namespace_uri, name);
+
+	return param;
+}
+
+/* Gives dest the name and namespace URI of source, without copying */
+void
+_soup_soap_param_copy_name (SoupSoapParam *dest,
+                            SoupSoapParam *source)
+{
+	SoupSoapParamPrivate *priv = dest->priv;
+
+	replace_string (&priv->name, &priv->name_counted,
+	                source->priv->name, source->priv->name_counted);
+	replace_string (&priv->namespace_uri, &priv->namespace_counted,
+	                source->priv->namespace_uri, source->priv->namespace_counted);
+}
+
+SoupSoapStringPool *
+_soup_soap_string_pool_new (void)
+{
+	SoupSoapStringPool *pool = g_slice_new (SoupSoapStringPool);
+
+	pool->strings = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                       NULL, counted_string_unref);
+
+	return pool;
+}
+
+void
+_soup_soap_string_pool_free (SoupSoapStringPool *pool)
+{
+	g_hash_table_unref (pool->strings);
+	g_slice_free (SoupSoapStringPool, pool);
+}
+
+/* Returns the pooled copy of string, which params named with it keep
+ * alive after the pool itself is freed.
+ */
+const gchar *
+_soup_soap_string_pool_add (SoupSoapStringPool *pool,
+                            const gchar *string)
+{
+	const gchar *copy = g_hash_table_lookup (pool->strings, string);
+
+	if (copy == NULL)
+	{
+		copy = counted_string_new (string);
+		g_hash_table_insert (pool->strings, (gpointer) copy, (gpointer) copy);
+	}
+
+	return copy;
+}
+
+void
+_soup_soap_param_hold (SoupSoapParam *param,
+                       SoupSoapParamGroup *group)
+{
+	SoupSoapParamPrivate *priv = param->priv;
+
+	if (priv->owner == NULL || priv->owner == group)
+	{
+		priv->owner = group;
+		priv->owner_holds++;
+	}
+	else
+		priv->sharers = g_slist_prepend (priv->sharers, group);
+}
+
+void
+_soup_soap_param_release (SoupSoapParam *param,
+                          SoupSoapParamGroup *group)
+{
+	SoupSoapParamPrivate *priv = param->priv;
+
+	if (priv->owner != group)
+	{
+		priv->sharers = g_slist_remove (priv->sharers, group);
+		return;
+	}
+
+	if (--priv->owner_holds > 0)
+		return;
+
+	/* A sharer takes over, and can then change the param in place */
+	priv->owner = NULL;
+
+	if (priv->sharers)
+	{
+		_soup_soap_param_hold (param, priv->sharers->data);
+		priv->sharers = g_slist_delete_link (priv->sharers, priv->sharers);
+	}
+}
+
+SoupSoapParamGroup *
+_soup_soap_param_get_owner (SoupSoapParam *param)
+{
+	return param->priv->owner;
+}
+
+SoupSoapParamGroup *
+_soup_soap_param_get_sharer (SoupSoapParam *param)
+{
+	GSList *sharers = param->priv->sharers;
+
+	return sharers ? sharers->data : NULL;
+}
+
+/* Copies the param alone; the elements of a group are shared */
+SoupSoapParam *
+_soup_soap_param_copy (SoupSoapParam *param)
+{
+	SoupSoapParam *copy;
+
+	if (SOUP_SOAP_IS_PARAM_GROUP (param))
+		return SOUP_SOAP_PARAM (soup_soap_param_group_copy (SOUP_SOAP_PARAM_GROUP (param)));
+
+	copy = g_object_new (G_OBJECT_TYPE (param), NULL);
+	_soup_soap_param_copy_name (copy, param);
+	copy->priv->value = g_strdup (param->priv->value);
+
+	return copy;
+}
+
+/* Bytes held by the param alone: instance, private data and value */
+gsize
+_soup_soap_param_get_own_size (SoupSoapParam *param)
+{
+	const gchar *value = param->priv->value;
+
+	return sizeof (SoupSoapParam) + sizeof (SoupSoapParamPrivate) +
+	       (value ? strlen (value) + 1 : 0);
 }
 
 const gchar *
@@ -644,10 +968,23 @@ soup_soap_param_set_value (SoupSoapParam *param,
 
 	SoupSoapParamPrivate *priv = param->priv;
 
+	_soup_soap_param_unshare (param);
 	g_free (priv->value);
 	priv->value = g_strdup (value);
 }
 
+/* Like soup_soap_param_set_value(), but takes ownership of value */
+static void
+set_value_take (SoupSoapParam *param,
+                gchar *value)
+{
+	SoupSoapParamPrivate *priv = param->priv;
+
+	_soup_soap_param_unshare (param);
+	g_free (priv->value);
+	priv->value = value;
+}
+
 gchar *
 soup_soap_param_get_string (SoupSoapParam *param,
                             GError **error)
@@ -660,6 +997,8 @@ soup_soap_param_get_string (SoupSoapParam *param,
 
 	param_error = NULL;
 
+	SOUP_SOAP_PROBE2 (param__get__start, "string", param->priv->name);
+
 	value = soup_soap_param_get_value (param);
 
 	if (!g_utf8_validate (value, -1, NULL))
@@ -670,11 +1009,14 @@ soup_soap_param_get_string (SoupSoapParam *param,
 		             _("Value '%s' is not UTF-8"), value_utf8);
 		g_free (value_utf8);
 
+		SOUP_SOAP_PROBE2 (param__get__done, "string", FALSE);
 		return NULL;
 	}
 
 	string_value = parse_value_as_string (value, &param_error);
 
+	SOUP_SOAP_PROBE2 (param__get__done, "string", param_error == NULL);
+
 	if (param_error)
 	{
 		if (g_error_matches (param_error,
@@ -703,8 +1045,7 @@ soup_soap_param_set_string (SoupSoapParam *param,
 	g_return_if_fail (string != NULL);
 
 	value = parse_string_as_value (string, FALSE);
-	soup_soap_param_set_value (param, value);
-	g_free (value);
+	set_value_take (param, value);
 }
 
 gboolean
@@ -717,10 +1058,14 @@ soup_soap_param_get_boolean (SoupSoapParam *param,
 
 	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (param), FALSE);
 
+	SOUP_SOAP_PROBE2 (param__get__start, "boolean", param->priv->name);
+
 	value = soup_soap_param_get_value (param);
 
 	bool_value = parse_value_as_boolean (value, &param_error);
 
+	SOUP_SOAP_PROBE2 (param__get__done, "boolean", param_error == NULL);
+
 	if (param_error)
 	{
 		if (g_error_matches (param_error,
@@ -748,8 +1093,7 @@ soup_soap_param_set_boolean (SoupSoapParam *param,
 	g_return_if_fail (SOUP_SOAP_IS_PARAM (param));
 
 	result = parse_boolean_as_value (value);
-	soup_soap_param_set_value (param, result);
-	g_free (result);
+	set_value_take (param, result);
 }
 
 gint
@@ -764,10 +1108,14 @@ soup_soap_param_get_integer (SoupSoapParam *param,
 
 	param_error = NULL;
 
+	SOUP_SOAP_PROBE2 (param__get__start, "integer", param->priv->name);
+
 	value = soup_soap_param_get_value (param);
 
 	int_value = parse_value_as_integer (value, &param_error);
 
+	SOUP_SOAP_PROBE2 (param__get__done, "integer", param_error == NULL);
+
 	if (param_error)
 	{
 		if (g_error_matches (param_error,
@@ -795,8 +1143,7 @@ soup_soap_param_set_integer (SoupSoapParam *param,
 	g_return_if_fail (SOUP_SOAP_IS_PARAM (param));
 
 	result = g_strdup_printf ("%d", value);
-	soup_soap_param_set_value (param, result);
-	g_free (result);
+	set_value_take (param, result);
 }
 
 gdouble
@@ -811,10 +1158,14 @@ soup_soap_param_get_double (SoupSoapParam *param,
 
 	param_error = NULL;
 
+	SOUP_SOAP_PROBE2 (param__get__start, "double", param->priv->name);
+
 	value = soup_soap_param_get_value (param);
 
 	double_value = parse_value_as_double (value, &param_error);
 
+	SOUP_SOAP_PROBE2 (param__get__done, "double", param_error == NULL);
+
 	if (param_error)
 	{
 		if (g_error_matches (param_error,
@@ -845,24 +1196,28 @@ soup_soap_param_set_double (SoupSoapParam *param,
 	soup_soap_param_set_value (param, result);
 }
 
-guchar *
-soup_soap_param_get_base64_binary (SoupSoapParam *param,
-                                   gsize *value_len,
-                                   GError **error)
+/* Shared by the base64 getters, each reporting itself to probes as type */
+static guchar *
+get_base64 (SoupSoapParam *param,
+            const gchar *type,
+            gsize *value_len,
+            GError **error)
 {
 	GError *param_error;
 	const gchar *value;
 	guchar *base64_value;
 	gsize result_len = 0;
 
-	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (param), NULL);
-
 	param_error = NULL;
 
+	SOUP_SOAP_PROBE2 (param__get__start, type, param->priv->name);
+
 	value = soup_soap_param_get_value (param);
 
 	base64_value = parse_value_as_base64_binary (value, &result_len, &param_error);
 
+	SOUP_SOAP_PROBE2 (param__get__done, type, param_error == NULL);
+
 	if (param_error)
 	{
 		if (g_error_matches (param_error,
@@ -883,6 +1238,16 @@ soup_soap_param_get_base64_binary (SoupSoapParam *param,
 	return base64_value;
 }
 
+guchar *
+soup_soap_param_get_base64_binary (SoupSoapParam *param,
+                                   gsize *value_len,
+                                   GError **error)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (param), NULL);
+
+	return get_base64 (param, "base64", value_len, error);
+}
+
 void
 soup_soap_param_set_base64_binary (SoupSoapParam *param,
                                    const guchar *value,
@@ -893,15 +1258,17 @@ soup_soap_param_set_base64_binary (SoupSoapParam *param,
 	g_return_if_fail (SOUP_SOAP_IS_PARAM (param));
 
 	result = g_base64_encode (value, value_len);
-	soup_soap_param_set_value (param, result);
-	g_free (result);
+	set_value_take (param, result);
 }
 
 gchar *
 soup_soap_param_get_base64_string (SoupSoapParam *param,
                                    GError **error)
 {
-	return (gchar *) soup_soap_param_get_base64_binary (param, NULL, error);
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM (param), NULL);
+
+	/* Decoded data is followed by a NUL, which ends the string */
+	return (gchar *) get_base64 (param, "base64-string", NULL, error);
 }
 
 void
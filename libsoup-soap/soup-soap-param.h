@@ -58,6 +58,8 @@ SoupSoapParam *soup_soap_param_new_base64_binary (const gchar *name, const gucha
 SoupSoapParam *soup_soap_param_new_base64_string (const gchar *name, const gchar *value);
 const gchar *soup_soap_param_get_name (SoupSoapParam *param);
 void soup_soap_param_set_name (SoupSoapParam *param, const gchar *name);
+const gchar *soup_soap_param_get_namespace_uri (SoupSoapParam *param);
+void soup_soap_param_set_namespace_uri (SoupSoapParam *param, const gchar *namespace_uri);
 const gchar *soup_soap_param_get_value (SoupSoapParam *param);
 void soup_soap_param_set_value (SoupSoapParam *param, const gchar *value);
 gchar *soup_soap_param_get_string (SoupSoapParam *param, GError **error);
@@ -0,0 +1,318 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compiled path queries over a param tree.
+ *
+ *   path := step ('/' step)*
+ *   step := name | name '[' '*' ']' | name '[' n ']'
+ *
+ * A plain step selects the first matching child, "[*]" every matching
+ * child and "[n]" the nth one, counting from zero.  A name of "*"
+ * matches any element.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#define STEP_ALL -1
+
+struct _SoupSoapPath
+{
+	gint ref_count;
+
+	gchar *expression;
+	SoupSoapPathStep *steps;
+	guint n_steps;
+};
+
+
+
+GQuark
+soup_soap_path_error_quark (void)
+{
+	return g_quark_from_static_string ("soup-soap-path-error-quark");
+}
+
+
+G_DEFINE_BOXED_TYPE (SoupSoapPath, soup_soap_path, soup_soap_path_ref, soup_soap_path_unref);
+
+static gboolean
+parse_step (const gchar *text,
+            SoupSoapPathStep *step)
+{
+	const gchar *bracket = strchr (text, '[');
+	gchar *name;
+
+	if (bracket == NULL)
+	{
+		step->index = 0;
+		name = g_strdup (text);
+	}
+	else
+	{
+		const gchar *end = bracket + strlen (bracket) - 1;
+
+		if (*end != ']' || end == bracket + 1)
+			return FALSE;
+
+		if (end == bracket + 2 && bracket[1] == '*')
+			step->index = STEP_ALL;
+		else
+		{
+			gchar *digits_end;
+			guint64 index;
+
+			if (!g_ascii_isdigit (bracket[1]))
+				return FALSE;
+
+			index = g_ascii_strtoull (bracket + 1, &digits_end, 10);
+			if (digits_end != end || index > G_MAXINT)
+				return FALSE;
+
+			step->index = index;
+		}
+
+		name = g_strndup (text, bracket - text);
+	}
+
+	if (*name == '\0' || strchr (name, ']'))
+	{
+		g_free (name);
+		return FALSE;
+	}
+
+	if (strcmp (name, "*") == 0)
+		g_free (name);
+	else
+		step->name = name;
+
+	return TRUE;
+}
+
+SoupSoapPath *
+soup_soap_path_new (const gchar *expression,
+                    GError **error)
+{
+	SoupSoapPath *path;
+	gchar **parts;
+	guint i;
+
+	g_return_val_if_fail (expression != NULL, NULL);
+
+	/* Which would have no steps at all */
+	if (*expression == '\0')
+	{
+		g_set_error_literal (error, SOUP_SOAP_PATH_ERROR,
+		                     SOUP_SOAP_PATH_ERROR_INVALID,
+		                     _("The path is empty."));
+		return NULL;
+	}
+
+	parts = g_strsplit (expression, "/", -1);
+
+	path = g_slice_new0 (SoupSoapPath);
+	path->ref_count = 1;
+	path->expression = g_strdup (expression);
+	path->n_steps = g_strv_length (parts);
+	path->steps = g_new0 (SoupSoapPathStep, path->n_steps);
+
+	for (i = 0; i < path->n_steps; i++)
+	{
+		if (!parse_step (parts[i], &path->steps[i]))
+		{
+			g_set_error (error, SOUP_SOAP_PATH_ERROR,
+			             SOUP_SOAP_PATH_ERROR_INVALID,
+			             _("Invalid step '%s' in path '%s'."),
+			             parts[i], expression);
+			g_strfreev (parts);
+			soup_soap_path_unref (path);
+			return NULL;
+		}
+	}
+
+	g_strfreev (parts);
+
+	return path;
+}
+
+SoupSoapPath *
+soup_soap_path_ref (SoupSoapPath *path)
+{
+	g_return_val_if_fail (path != NULL, NULL);
+
+	g_atomic_int_inc (&path->ref_count);
+
+	return path;
+}
+
+void
+soup_soap_path_unref (SoupSoapPath *path)
+{
+	g_return_if_fail (path != NULL);
+
+	guint i;
+
+	if (!g_atomic_int_dec_and_test (&path->ref_count))
+		return;
+
+	for (i = 0; i < path->n_steps; i++)
+		g_free ((gchar *) path->steps[i].name);
+
+	g_free (path->expression);
+	g_free (path->steps);
+	g_slice_free (SoupSoapPath, path);
+}
+
+const gchar *
+soup_soap_path_get_expression (SoupSoapPath *path)
+{
+	g_return_val_if_fail (path != NULL, NULL);
+
+	return path->expression;
+}
+
+const SoupSoapPathStep *
+_soup_soap_path_get_steps (SoupSoapPath *path,
+                           guint *n_steps)
+{
+	*n_steps = path->n_steps;
+
+	return path->steps;
+}
+
+/* Returns the first element the path selects, or NULL */
+SoupSoapParam *
+soup_soap_path_get_first (SoupSoapPath *path,
+                          SoupSoapParamGroup *group)
+{
+	SoupSoapPathIter iter;
+	SoupSoapParam *param;
+
+	g_return_val_if_fail (path != NULL, NULL);
+	g_return_val_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group), NULL);
+
+	soup_soap_path_iter_init (&iter, path, group);
+	param = soup_soap_path_iter_next (&iter);
+	soup_soap_path_iter_clear (&iter);
+
+	return param;
+}
+
+/* The group must not be modified while the iterator is in use */
+void
+soup_soap_path_iter_init (SoupSoapPathIter *iter,
+                          SoupSoapPath *path,
+                          SoupSoapParamGroup *group)
+{
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (path != NULL);
+	g_return_if_fail (SOUP_SOAP_IS_PARAM_GROUP (group));
+
+	iter->path = path;
+	iter->frames = path->n_steps > SOUP_SOAP_PATH_ITER_INLINE_DEPTH ?
+		g_new (SoupSoapPathFrame, path->n_steps) : iter->inline_frames;
+	iter->frames[0].group = group;
+	iter->frames[0].cursor = _soup_soap_param_group_peek_elements (group);
+	iter->frames[0].seen = 0;
+	iter->depth = 0;
+}
+
+/* Depth-first walk that keeps one list cursor per step, so that finding
+ * each match allocates nothing, unless it is first reached through a
+ * soup_soap_param_group_copy().
+ */
+SoupSoapParam *
+soup_soap_path_iter_next (SoupSoapPathIter *iter)
+{
+	g_return_val_if_fail (iter != NULL, NULL);
+
+	SoupSoapPath *path = iter->path;
+
+	while (iter->depth >= 0)
+	{
+		SoupSoapPathFrame *frame = &iter->frames[iter->depth];
+		const SoupSoapPathStep *step = &path->steps[iter->depth];
+		SoupSoapParam *found = NULL;
+
+		while (frame->cursor)
+		{
+			GList *link = frame->cursor;
+			SoupSoapParam *param = link->data;
+
+			frame->cursor = g_list_next (link);
+
+			if (step->name &&
+			    strcmp (soup_soap_param_get_name (param), step->name) != 0)
+				continue;
+
+			/* Matches belong to the tree being walked, even in a copy */
+			if (step->index == STEP_ALL)
+			{
+				found = _soup_soap_param_group_adopt (frame->group, link);
+				break;
+			}
+
+			if (frame->seen++ == (guint) step->index)
+			{
+				/* Nothing else at this level can match */
+				found = _soup_soap_param_group_adopt (frame->group, link);
+				frame->cursor = NULL;
+				break;
+			}
+		}
+
+		if (found == NULL)
+		{
+			iter->depth--;
+			continue;
+		}
+
+		if ((guint) iter->depth == path->n_steps - 1)
+			return found;
+
+		if (!SOUP_SOAP_IS_PARAM_GROUP (found))
+			continue;
+
+		iter->depth++;
+		iter->frames[iter->depth].group = SOUP_SOAP_PARAM_GROUP (found);
+		iter->frames[iter->depth].cursor =
+			_soup_soap_param_group_peek_elements (SOUP_SOAP_PARAM_GROUP (found));
+		iter->frames[iter->depth].seen = 0;
+	}
+
+	return NULL;
+}
+
+void
+soup_soap_path_iter_clear (SoupSoapPathIter *iter)
+{
+	g_return_if_fail (iter != NULL);
+
+	if (iter->frames != iter->inline_frames)
+		g_free (iter->frames);
+
+	iter->frames = NULL;
+	iter->depth = -1;
+}
@@ -0,0 +1,75 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_PATH_H_
+#define _SOUP_SOAP_PATH_H_
+
+#include <glib-object.h>
+#include <libsoup-soap/soup-soap-param-group.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_PATH  (soup_soap_path_get_type ())
+
+#define SOUP_SOAP_PATH_ITER_INLINE_DEPTH 8
+
+typedef struct _SoupSoapPath SoupSoapPath;
+typedef struct _SoupSoapPathIter SoupSoapPathIter;
+typedef struct _SoupSoapPathFrame SoupSoapPathFrame;
+
+struct _SoupSoapPathFrame
+{
+	/*< private >*/
+	SoupSoapParamGroup *group;
+	GList *cursor;
+	guint seen;
+};
+
+/* Lives on the stack; only paths deeper than the inline frames allocate */
+struct _SoupSoapPathIter
+{
+	/*< private >*/
+	SoupSoapPath *path;
+	SoupSoapPathFrame *frames;
+	SoupSoapPathFrame inline_frames[SOUP_SOAP_PATH_ITER_INLINE_DEPTH];
+	gint depth;
+};
+
+GType soup_soap_path_get_type (void) G_GNUC_CONST;
+SoupSoapPath *soup_soap_path_new (const gchar *expression, GError **error);
+SoupSoapPath *soup_soap_path_ref (SoupSoapPath *path);
+void soup_soap_path_unref (SoupSoapPath *path);
+const gchar *soup_soap_path_get_expression (SoupSoapPath *path);
+SoupSoapParam *soup_soap_path_get_first (SoupSoapPath *path, SoupSoapParamGroup *group);
+void soup_soap_path_iter_init (SoupSoapPathIter *iter, SoupSoapPath *path, SoupSoapParamGroup *group);
+SoupSoapParam *soup_soap_path_iter_next (SoupSoapPathIter *iter);
+void soup_soap_path_iter_clear (SoupSoapPathIter *iter);
+
+typedef enum
+{
+	SOUP_SOAP_PATH_ERROR_INVALID
+} SoupSoapPathError;
+
+#define SOUP_SOAP_PATH_ERROR soup_soap_path_error_quark()
+
+GQuark soup_soap_path_error_quark (void);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_PATH_H_ */
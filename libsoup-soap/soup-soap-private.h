@@ -0,0 +1,130 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_PRIVATE_H_
+#define _SOUP_SOAP_PRIVATE_H_
+
+#include <glib-object.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+G_BEGIN_DECLS
+
+/* Internal helpers shared between modules, not installed */
+
+typedef struct _SoupSoapStringPool SoupSoapStringPool;
+
+SoupSoapStringPool *_soup_soap_string_pool_new (void);
+void _soup_soap_string_pool_free (SoupSoapStringPool *pool);
+const gchar *_soup_soap_string_pool_add (SoupSoapStringPool *pool, const gchar *string);
+
+gboolean _soup_soap_param_has_name (SoupSoapParam *param, const gchar *namespace_uri, const gchar *name);
+void _soup_soap_param_set_pooled_name (SoupSoapParam *param, const gchar *namespace_uri, const gchar *name);
+SoupSoapParam *_soup_soap_param_new_pooled (GType type, const gchar *namespace_uri, const gchar *name);
+void _soup_soap_param_copy_name (SoupSoapParam *dest, SoupSoapParam *source);
+gsize _soup_soap_param_get_own_size (SoupSoapParam *param);
+void _soup_soap_param_hold (SoupSoapParam *param, SoupSoapParamGroup *group);
+void _soup_soap_param_release (SoupSoapParam *param, SoupSoapParamGroup *group);
+SoupSoapParamGroup *_soup_soap_param_get_owner (SoupSoapParam *param);
+SoupSoapParamGroup *_soup_soap_param_get_sharer (SoupSoapParam *param);
+void _soup_soap_param_unshare (SoupSoapParam *param);
+SoupSoapParam *_soup_soap_param_copy (SoupSoapParam *param);
+
+GList *_soup_soap_param_group_peek_elements (SoupSoapParamGroup *group);
+SoupSoapParam *_soup_soap_param_group_adopt (SoupSoapParamGroup *group, GList *link);
+void _soup_soap_param_group_set_elements (SoupSoapParamGroup *group, GList *elements);
+GList *_soup_soap_param_group_steal_elements (SoupSoapParamGroup *group);
+gsize _soup_soap_param_tree_get_memory_usage (SoupSoapParam *param, GHashTable *names);
+
+SoupSoapMessage *_soup_soap_frozen_message_thaw (SoupSoapFrozenMessage *frozen);
+
+typedef struct _SoupSoapMessageStream SoupSoapMessageStream;
+
+SoupSoapMessageStream *_soup_soap_message_stream_new (SoupSoapMessage *msg, SoupMessageBody *body);
+gboolean _soup_soap_message_stream_produce (SoupSoapMessageStream *stream, guint chunks_written);
+void _soup_soap_message_stream_free (SoupSoapMessageStream *stream);
+
+SoupSoapMessage *_soup_soap_message_new_adopting (SoupMessageHeaders *headers, SoupMessageBody *body);
+void _soup_soap_message_detach (SoupSoapMessage *msg);
+void _soup_soap_message_new_async_full (SoupMessageHeaders *headers, SoupMessageBody *body, SoupMessage *msg, SoupSoapSchema *schema, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+GByteArray *_soup_soap_binary_encode (SoupSoapParamGroup *header, SoupSoapParamGroup *body);
+/* Returns FALSE once size more bytes would go over a memory budget */
+typedef gboolean (*SoupSoapChargeBytesFunc) (gsize size, gpointer user_data);
+
+GConverter *_soup_soap_create_decompressor (SoupMessageHeaders *headers, SoupMessageBody *body);
+gboolean _soup_soap_sax_parse_body (xmlParserCtxtPtr ctxt, SoupMessageHeaders *headers, SoupMessageBody *body, gboolean complete, SoupSoapChargeBytesFunc charge, gpointer charge_data, GCancellable *cancellable, GError **error);
+
+typedef struct
+{
+	const gchar *name;
+	const gchar *namespace_uri;
+	SoupSoapParamGroup *group;
+	gboolean capture;
+} SoupSoapSaxFrame;
+
+/* Returns FALSE to stop the parse, e.g. once a memory budget is exceeded */
+typedef gboolean (*SoupSoapSaxChargeFunc) (SoupSoapParam *param, gpointer user_data);
+
+typedef struct
+{
+	xmlParserCtxtPtr ctxt;
+	GArray *frames;
+	GString *text;
+	SoupSoapStringPool *names;
+	guint depth;
+	guint skip_depth;
+	SoupSoapSaxChargeFunc charge;
+	gpointer charge_data;
+} SoupSoapSaxBuilder;
+
+void _soup_soap_sax_builder_init (SoupSoapSaxBuilder *builder, gsize frame_size, SoupSoapStringPool *names, SoupSoapSaxChargeFunc charge, gpointer charge_data);
+void _soup_soap_sax_builder_clear (SoupSoapSaxBuilder *builder);
+SoupSoapSaxFrame *_soup_soap_sax_builder_get_frame (SoupSoapSaxBuilder *builder, guint index);
+SoupSoapSaxFrame *_soup_soap_sax_builder_top (SoupSoapSaxBuilder *builder);
+gboolean _soup_soap_sax_builder_start (SoupSoapSaxBuilder *builder);
+void _soup_soap_sax_builder_skip (SoupSoapSaxBuilder *builder);
+gboolean _soup_soap_sax_builder_end (SoupSoapSaxBuilder *builder);
+SoupSoapSaxFrame *_soup_soap_sax_builder_push (SoupSoapSaxBuilder *builder, const xmlChar *namespace_uri, const xmlChar *name, SoupSoapParamGroup *group, gboolean capture);
+SoupSoapParamGroup *_soup_soap_sax_builder_ensure_group (SoupSoapSaxBuilder *builder, guint index);
+void _soup_soap_sax_builder_pop (SoupSoapSaxBuilder *builder, gpointer frame);
+void _soup_soap_sax_builder_characters (SoupSoapSaxBuilder *builder, const xmlChar *ch, int len);
+
+gboolean _soup_soap_binary_decode (const guchar *data, gsize length, SoupSoapParamGroup *header, SoupSoapParamGroup *body, GError **error);
+
+gboolean _soup_soap_schema_validate_element (SoupSoapSchema *schema, xmlNodePtr node, GError **error);
+
+/* name is NULL to match any element; index is -1 for all */
+typedef struct
+{
+	const gchar *name;
+	gint index;
+} SoupSoapPathStep;
+
+const SoupSoapPathStep *_soup_soap_path_get_steps (SoupSoapPath *path, guint *n_steps);
+
+gint64 _soup_soap_stats_get_cpu_time (void);
+void _soup_soap_stats_add_parse (const SoupSoapMessageStats *message_stats);
+void _soup_soap_stats_add_persist (const SoupSoapMessageStats *message_stats);
+
+void _soup_soap_latency_record (const gchar *operation, const gint64 *times);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_PRIVATE_H_ */
@@ -0,0 +1,57 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_PROBES_H_
+#define _SOUP_SOAP_PROBES_H_
+
+/* Static tracepoints, compiled in with --enable-dtrace (USDT probes of
+ * provider libsoup_soap, for perf, bpftrace or SystemTap) and
+ * --enable-sysprof (capture marks).  A disabled USDT probe is a single
+ * nop, so probe arguments must stay cheap to compute.
+ */
+
+#ifdef HAVE_DTRACE
+#include <sys/sdt.h>
+
+#define SOUP_SOAP_PROBE1(name, a)        DTRACE_PROBE1 (libsoup_soap, name, a)
+#define SOUP_SOAP_PROBE2(name, a, b)     DTRACE_PROBE2 (libsoup_soap, name, a, b)
+#define SOUP_SOAP_PROBE3(name, a, b, c)  DTRACE_PROBE3 (libsoup_soap, name, a, b, c)
+#else
+#define SOUP_SOAP_PROBE1(name, a)
+#define SOUP_SOAP_PROBE2(name, a, b)
+#define SOUP_SOAP_PROBE3(name, a, b, c)
+#endif
+
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+
+#define SOUP_SOAP_MARK_BEGIN(begin) \
+	G_GNUC_UNUSED gint64 begin = SYSPROF_CAPTURE_CURRENT_TIME
+#define SOUP_SOAP_MARK_END(begin, name, ...) \
+	G_STMT_START { \
+		if (sysprof_collector_is_active ()) \
+			sysprof_collector_mark (begin, SYSPROF_CAPTURE_CURRENT_TIME - (begin), \
+			                        "libsoup-soap", name, __VA_ARGS__); \
+	} G_STMT_END
+#else
+#define SOUP_SOAP_MARK_BEGIN(begin)
+#define SOUP_SOAP_MARK_END(begin, name, ...)
+#endif
+
+#endif /* _SOUP_SOAP_PROBES_H_ */
@@ -0,0 +1,504 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+/* Input is handed to the parser in slices of at most this size, so that
+ * only the records completed within one slice are ever queued at once.
+ */
+#define READER_SLICE_SIZE 4096
+
+struct _SoupSoapRecordReaderPrivate
+{
+	SoupSoapPath *path;
+	const SoupSoapPathStep *steps;
+	guint n_steps;
+
+	xmlParserCtxtPtr ctxt;
+	GQueue pending;
+	gsize pending_offset;
+	gboolean at_end;
+	gboolean finished;
+	GError *error;
+
+	SoupSoapSaxBuilder builder;
+	guint match_depth;
+	gboolean have_envelope;
+	gboolean have_operation;
+	gboolean operation_done;
+	const gchar *operation_name;
+	guint *seen;
+
+	SoupSoapStringPool *names;
+	GQueue records;
+	SoupSoapParamGroup *current;
+};
+
+#define SOUP_SOAP_RECORD_READER_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_RECORD_READER, SoupSoapRecordReaderPrivate))
+
+enum
+{
+	PROP_0,
+
+	PROP_PATH
+};
+
+
+static void
+reader_start_element (void *ctx,
+                      const xmlChar *localname,
+                      const xmlChar *prefix,
+                      const xmlChar *URI,
+                      int nb_namespaces,
+                      const xmlChar **namespaces,
+                      int nb_attributes,
+                      int nb_defaulted,
+                      const xmlChar **attributes)
+{
+	SoupSoapRecordReaderPrivate *priv = ((xmlParserCtxtPtr) ctx)->_private;
+	SoupSoapSaxBuilder *builder = &priv->builder;
+	SoupSoapSaxFrame *frame;
+	const SoupSoapPathStep *step;
+	guint index;
+
+	if (!_soup_soap_sax_builder_start (builder))
+		return;
+
+	if (builder->frames->len > 0)
+	{
+		_soup_soap_sax_builder_ensure_group (builder, builder->frames->len - 1);
+		_soup_soap_sax_builder_push (builder, URI, localname, NULL, TRUE);
+		return;
+	}
+
+	switch (builder->depth)
+	{
+		case 1:
+			priv->have_envelope = xmlStrEqual (localname, BAD_CAST "Envelope");
+			if (!priv->have_envelope)
+				_soup_soap_sax_builder_skip (builder);
+			return;
+		case 2:
+			if (!xmlStrEqual (localname, BAD_CAST "Body"))
+				_soup_soap_sax_builder_skip (builder);
+			return;
+		case 3:
+			/* Only the first element of the body is the operation */
+			if (priv->have_operation)
+				_soup_soap_sax_builder_skip (builder);
+			else
+			{
+				priv->have_operation = TRUE;
+				priv->operation_name =
+					_soup_soap_string_pool_add (priv->names,
+					                            (const gchar *) localname);
+				priv->match_depth = builder->depth;
+				priv->seen[0] = 0;
+			}
+			return;
+	}
+
+	/* Elements below the operation take one step each, and only the
+	 * children of a matched element are looked at.
+	 */
+	if (priv->match_depth != builder->depth - 1)
+	{
+		_soup_soap_sax_builder_skip (builder);
+		return;
+	}
+
+	index = builder->depth - 4;
+	step = &priv->steps[index];
+
+	if ((step->name && strcmp (step->name, (const gchar *) localname) != 0) ||
+	    (step->index != -1 && priv->seen[index]++ != (guint) step->index))
+	{
+		_soup_soap_sax_builder_skip (builder);
+		return;
+	}
+
+	if (index < priv->n_steps - 1)
+	{
+		priv->match_depth = builder->depth;
+		priv->seen[index + 1] = 0;
+		return;
+	}
+
+	/* The element completes the path: build it as a record, which is
+	 * the one frame that starts out with its group.
+	 */
+	frame = _soup_soap_sax_builder_push (builder, URI, localname, NULL, TRUE);
+	frame->group = SOUP_SOAP_PARAM_GROUP (
+		_soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM_GROUP,
+		                             frame->namespace_uri, frame->name));
+}
+
+static void
+reader_end_element (void *ctx,
+                    const xmlChar *localname,
+                    const xmlChar *prefix,
+                    const xmlChar *URI)
+{
+	SoupSoapRecordReaderPrivate *priv = ((xmlParserCtxtPtr) ctx)->_private;
+	SoupSoapSaxBuilder *builder = &priv->builder;
+	SoupSoapSaxFrame frame;
+
+	if (!_soup_soap_sax_builder_end (builder))
+		return;
+
+	if (builder->frames->len > 0)
+	{
+		_soup_soap_sax_builder_pop (builder, &frame);
+
+		if (builder->frames->len == 0)
+			g_queue_push_tail (&priv->records, g_object_ref_sink (frame.group));
+	}
+	else if (builder->depth + 1 == priv->match_depth)
+	{
+		if (priv->match_depth == 3)
+			priv->operation_done = TRUE;
+
+		priv->match_depth--;
+	}
+}
+
+static void
+reader_characters (void *ctx,
+                   const xmlChar *ch,
+                   int len)
+{
+	SoupSoapRecordReaderPrivate *priv = ((xmlParserCtxtPtr) ctx)->_private;
+
+	_soup_soap_sax_builder_characters (&priv->builder, ch, len);
+}
+
+
+G_DEFINE_TYPE (SoupSoapRecordReader, soup_soap_record_reader, G_TYPE_OBJECT);
+
+static void
+soup_soap_record_reader_init (SoupSoapRecordReader *object)
+{
+	object->priv = SOUP_SOAP_RECORD_READER_GET_PRIVATE (object);
+	SoupSoapRecordReaderPrivate *priv = object->priv;
+
+	xmlSAXHandler sax;
+
+	memset (&sax, 0, sizeof (sax));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = reader_start_element;
+	sax.endElementNs = reader_end_element;
+	sax.characters = reader_characters;
+	sax.cdataBlock = reader_characters;
+
+	priv->ctxt = xmlCreatePushParserCtxt (&sax, NULL, NULL, 0, NULL);
+	priv->ctxt->_private = priv;
+
+	g_queue_init (&priv->pending);
+	g_queue_init (&priv->records);
+	priv->names = _soup_soap_string_pool_new ();
+	_soup_soap_sax_builder_init (&priv->builder, sizeof (SoupSoapSaxFrame),
+	                             priv->names, NULL, NULL);
+	priv->builder.ctxt = priv->ctxt;
+}
+
+static void
+soup_soap_record_reader_constructed (GObject *object)
+{
+	SoupSoapRecordReader *reader = SOUP_SOAP_RECORD_READER (object);
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	priv->steps = _soup_soap_path_get_steps (priv->path, &priv->n_steps);
+	priv->seen = g_new0 (guint, priv->n_steps);
+
+	G_OBJECT_CLASS (soup_soap_record_reader_parent_class)->constructed (object);
+}
+
+static void
+soup_soap_record_reader_finalize (GObject *object)
+{
+	SoupSoapRecordReader *reader = SOUP_SOAP_RECORD_READER (object);
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+	SoupSoapSaxFrame *frame;
+
+	xmlFreeParserCtxt (priv->ctxt);
+
+	g_queue_foreach (&priv->pending, (GFunc) soup_buffer_free, NULL);
+	g_queue_clear (&priv->pending);
+	g_queue_foreach (&priv->records, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&priv->records);
+
+	/* A record still being built is only held by its frame */
+	if (priv->builder.frames->len > 0)
+	{
+		frame = _soup_soap_sax_builder_get_frame (&priv->builder, 0);
+		g_object_unref (g_object_ref_sink (frame->group));
+	}
+	_soup_soap_sax_builder_clear (&priv->builder);
+	_soup_soap_string_pool_free (priv->names);
+
+	if (priv->current)
+		g_object_unref (priv->current);
+
+	if (priv->error)
+		g_error_free (priv->error);
+
+	g_free (priv->seen);
+	soup_soap_path_unref (priv->path);
+
+	G_OBJECT_CLASS (soup_soap_record_reader_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_record_reader_set_property (GObject *object,
+                                      guint prop_id,
+                                      const GValue *value,
+                                      GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_RECORD_READER (object));
+
+	SoupSoapRecordReader *reader = SOUP_SOAP_RECORD_READER (object);
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			priv->path = g_value_dup_boxed (value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_record_reader_get_property (GObject *object,
+                                      guint prop_id,
+                                      GValue *value,
+                                      GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_RECORD_READER (object));
+
+	SoupSoapRecordReader *reader = SOUP_SOAP_RECORD_READER (object);
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	switch (prop_id)
+	{
+		case PROP_PATH:
+			g_value_set_boxed (value, priv->path);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_record_reader_class_init (SoupSoapRecordReaderClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (SoupSoapRecordReaderPrivate));
+
+	object_class->constructed = soup_soap_record_reader_constructed;
+	object_class->finalize = soup_soap_record_reader_finalize;
+	object_class->set_property = soup_soap_record_reader_set_property;
+	object_class->get_property = soup_soap_record_reader_get_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_PATH,
+	                                 g_param_spec_boxed ("path",
+	                                                     "Path",
+	                                                     "The path of the repeated element below the operation",
+	                                                     SOUP_SOAP_TYPE_PATH,
+	                                                     G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	xmlInitParser ();
+}
+
+
+/* Each element path selects below the operation element becomes one
+ * record, e.g. "Result/Row[*]".  A reader is not thread-safe.
+ */
+SoupSoapRecordReader *
+soup_soap_record_reader_new (SoupSoapPath *path)
+{
+	g_return_val_if_fail (path != NULL, NULL);
+
+	return g_object_new (SOUP_SOAP_TYPE_RECORD_READER,
+	                     "path", path,
+	                     NULL);
+}
+
+SoupSoapPath *
+soup_soap_record_reader_get_path (SoupSoapRecordReader *reader)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_RECORD_READER (reader), NULL);
+
+	return reader->priv->path;
+}
+
+/* Queues a chunk of the raw XML body, for instance from SoupMessage's
+ * "got-chunk".  Nothing is parsed until soup_soap_record_reader_next().
+ */
+void
+soup_soap_record_reader_feed (SoupSoapRecordReader *reader,
+                              SoupBuffer *chunk)
+{
+	g_return_if_fail (SOUP_SOAP_IS_RECORD_READER (reader));
+	g_return_if_fail (chunk != NULL);
+
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	g_return_if_fail (!priv->at_end);
+
+	if (chunk->length > 0)
+		g_queue_push_tail (&priv->pending, soup_buffer_copy (chunk));
+}
+
+void
+soup_soap_record_reader_feed_end (SoupSoapRecordReader *reader)
+{
+	g_return_if_fail (SOUP_SOAP_IS_RECORD_READER (reader));
+
+	reader->priv->at_end = TRUE;
+}
+
+static void
+set_invalid (SoupSoapRecordReaderPrivate *priv)
+{
+	if (priv->error == NULL)
+		g_set_error_literal (&priv->error, SOUP_SOAP_MESSAGE_ERROR,
+		                     SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,
+		                     _("Message body is not a SOAP envelope"));
+}
+
+/* Parses one slice of pending input; returns FALSE if there is none */
+static gboolean
+parse_slice (SoupSoapRecordReaderPrivate *priv)
+{
+	SoupBuffer *chunk = g_queue_peek_head (&priv->pending);
+	gsize length;
+
+	if (chunk == NULL)
+	{
+		if (!priv->at_end)
+			return FALSE;
+
+		xmlParseChunk (priv->ctxt, NULL, 0, 1);
+		if (!priv->ctxt->wellFormed || !priv->have_envelope)
+			set_invalid (priv);
+
+		priv->finished = TRUE;
+		return TRUE;
+	}
+
+	length = MIN (chunk->length - priv->pending_offset, READER_SLICE_SIZE);
+
+	if (xmlParseChunk (priv->ctxt, chunk->data + priv->pending_offset,
+	                   length, 0) != 0 &&
+	    !priv->ctxt->wellFormed)
+		set_invalid (priv);
+
+	priv->pending_offset += length;
+	if (priv->pending_offset == chunk->length)
+	{
+		soup_buffer_free (g_queue_pop_head (&priv->pending));
+		priv->pending_offset = 0;
+	}
+
+	return TRUE;
+}
+
+/* Returns the next record, which stays valid until the next call; take a
+ * reference to keep it longer.  NULL without an error means either that
+ * more input must be fed or, if soup_soap_record_reader_is_finished(),
+ * that there are no more records.
+ */
+SoupSoapParamGroup *
+soup_soap_record_reader_next (SoupSoapRecordReader *reader,
+                              GError **error)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_RECORD_READER (reader), NULL);
+
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	if (priv->current)
+	{
+		g_object_unref (priv->current);
+		priv->current = NULL;
+	}
+
+	while (g_queue_is_empty (&priv->records) &&
+	       priv->error == NULL && !priv->finished)
+	{
+		/* The rest of the envelope cannot hold more records */
+		if (priv->operation_done)
+		{
+			priv->finished = TRUE;
+			break;
+		}
+
+		if (!parse_slice (priv))
+			return NULL;
+	}
+
+	if (!g_queue_is_empty (&priv->records))
+	{
+		priv->current = g_queue_pop_head (&priv->records);
+		return priv->current;
+	}
+
+	if (priv->error)
+	{
+		g_propagate_error (error, priv->error);
+		priv->error = NULL;
+		priv->finished = TRUE;
+	}
+
+	return NULL;
+}
+
+gboolean
+soup_soap_record_reader_is_finished (SoupSoapRecordReader *reader)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_RECORD_READER (reader), FALSE);
+
+	SoupSoapRecordReaderPrivate *priv = reader->priv;
+
+	return priv->finished && g_queue_is_empty (&priv->records);
+}
+
+/* NULL until the operation element has been parsed */
+const gchar *
+soup_soap_record_reader_get_operation_name (SoupSoapRecordReader *reader)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_RECORD_READER (reader), NULL);
+
+	return reader->priv->operation_name;
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_RECORD_READER_H_
+#define _SOUP_SOAP_RECORD_READER_H_
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap-param-group.h>
+#include <libsoup-soap/soup-soap-path.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_RECORD_READER             (soup_soap_record_reader_get_type ())
+#define SOUP_SOAP_RECORD_READER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_RECORD_READER, SoupSoapRecordReader))
+#define SOUP_SOAP_RECORD_READER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_RECORD_READER, SoupSoapRecordReaderClass))
+#define SOUP_SOAP_IS_RECORD_READER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_RECORD_READER))
+#define SOUP_SOAP_IS_RECORD_READER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_RECORD_READER))
+#define SOUP_SOAP_RECORD_READER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_RECORD_READER, SoupSoapRecordReaderClass))
+
+typedef struct _SoupSoapRecordReaderPrivate SoupSoapRecordReaderPrivate;
+typedef struct _SoupSoapRecordReaderClass SoupSoapRecordReaderClass;
+typedef struct _SoupSoapRecordReader SoupSoapRecordReader;
+
+struct _SoupSoapRecordReaderClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapRecordReader
+{
+	GObject parent_instance;
+
+	SoupSoapRecordReaderPrivate *priv;
+};
+
+GType soup_soap_record_reader_get_type (void) G_GNUC_CONST;
+SoupSoapRecordReader *soup_soap_record_reader_new (SoupSoapPath *path);
+SoupSoapPath *soup_soap_record_reader_get_path (SoupSoapRecordReader *reader);
+void soup_soap_record_reader_feed (SoupSoapRecordReader *reader, SoupBuffer *chunk);
+void soup_soap_record_reader_feed_end (SoupSoapRecordReader *reader);
+SoupSoapParamGroup *soup_soap_record_reader_next (SoupSoapRecordReader *reader, GError **error);
+gboolean soup_soap_record_reader_is_finished (SoupSoapRecordReader *reader);
+const gchar *soup_soap_record_reader_get_operation_name (SoupSoapRecordReader *reader);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_RECORD_READER_H_ */
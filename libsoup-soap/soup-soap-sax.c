@@ -0,0 +1,380 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pieces shared by the streaming parsers: feeding a message body to a
+ * push parser, and building params from SAX events.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#define CONVERT_BUFFER_SIZE 16384
+
+
+GConverter *
+_soup_soap_create_decompressor (SoupMessageHeaders *headers,
+                                SoupMessageBody *body)
+{
+	const gchar *encoding;
+	SoupBuffer *chunk;
+	guchar data[2];
+	gsize length = 0, n;
+	goffset offset = 0;
+	GConverter *converter = NULL;
+
+	encoding = soup_message_headers_get_one (headers, "Content-Encoding");
+	if (encoding == NULL)
+		return NULL;
+
+	/* A SoupContentDecoder may already have inflated the body while
+	 * leaving the header in place, so trust the header only when the
+	 * data actually starts with the matching stream header.  That may
+	 * well straddle chunks.
+	 */
+	while (length < sizeof (data) &&
+	       (chunk = soup_message_body_get_chunk (body, offset)) != NULL)
+	{
+		n = MIN (chunk->length, sizeof (data) - length);
+		memcpy (data + length, chunk->data, n);
+		length += n;
+		offset += chunk->length;
+		soup_buffer_free (chunk);
+	}
+
+	if (length < sizeof (data))
+		return NULL;
+
+	if ((g_ascii_strcasecmp (encoding, "gzip") == 0 ||
+	     g_ascii_strcasecmp (encoding, "x-gzip") == 0) &&
+	    data[0] == 0x1f && data[1] == 0x8b)
+	{
+		converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	}
+	else if (g_ascii_strcasecmp (encoding, "deflate") == 0 &&
+	         (data[0] & 0x0f) == 8 && ((data[0] << 8) | data[1]) % 31 == 0)
+	{
+		converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+	}
+
+	return converter;
+}
+
+static gboolean
+parse_feed (xmlParserCtxtPtr ctxt,
+            GConverter *converter,
+            const gchar *data,
+            gsize length,
+            gboolean at_end,
+            SoupSoapChargeBytesFunc charge,
+            gpointer charge_data)
+{
+	gchar buffer[CONVERT_BUFFER_SIZE];
+	gsize bytes_read, bytes_written;
+	GConverterResult result;
+
+	if (converter == NULL)
+		return xmlParseChunk (ctxt, data, length, at_end) == 0 ||
+		       ctxt->wellFormed;
+
+	if (length == 0 && !at_end)
+		return TRUE;
+
+	do
+	{
+		result = g_converter_convert (converter, data, length,
+		                              buffer, sizeof (buffer),
+		                              at_end ? G_CONVERTER_INPUT_AT_END : 0,
+		                              &bytes_read, &bytes_written,
+		                              NULL);
+		if (result == G_CONVERTER_ERROR)
+			return FALSE;
+
+		data += bytes_read;
+		length -= bytes_read;
+
+		/* Inflated data is charged before the parser ever sees it */
+		if (charge && bytes_written > 0 && !charge (bytes_written, charge_data))
+			return FALSE;
+
+		if (bytes_written > 0 &&
+		    xmlParseChunk (ctxt, buffer, bytes_written, 0) != 0 &&
+		    !ctxt->wellFormed)
+			return FALSE;
+	} while (result != G_CONVERTER_FINISHED && (length > 0 || at_end) &&
+	         !ctxt->disableSAX);
+
+	if (at_end)
+		xmlParseChunk (ctxt, NULL, 0, 1);
+
+	return ctxt->wellFormed;
+}
+
+/* Feeds body to ctxt chunk by chunk, inflating it on the way when the
+ * headers say it is compressed, so that neither the raw nor the inflated
+ * document ever has to exist as one contiguous copy.  Feeding stops as
+ * soon as a callback calls xmlStopParser(), and the document is only
+ * ended if complete is TRUE.  If charge is given, every slice of inflated
+ * data is passed to it first, and feeding fails once it returns FALSE.
+ * Returns FALSE if the body is not well-formed, over budget, or if
+ * cancellable was cancelled in between chunks, in which case error is set.
+ */
+gboolean
+_soup_soap_sax_parse_body (xmlParserCtxtPtr ctxt,
+                           SoupMessageHeaders *headers,
+                           SoupMessageBody *body,
+                           gboolean complete,
+                           SoupSoapChargeBytesFunc charge,
+                           gpointer charge_data,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	GConverter *converter;
+	SoupBuffer *chunk;
+	goffset offset = 0;
+	gboolean success = TRUE;
+
+	converter = _soup_soap_create_decompressor (headers, body);
+
+	while (success && !ctxt->disableSAX &&
+	       !g_cancellable_set_error_if_cancelled (cancellable, error) &&
+	       (chunk = soup_message_body_get_chunk (body, offset)) != NULL)
+	{
+		success = parse_feed (ctxt, converter,
+		                      chunk->data, chunk->length, FALSE,
+		                      charge, charge_data);
+		offset += chunk->length;
+		soup_buffer_free (chunk);
+	}
+
+	if (g_cancellable_is_cancelled (cancellable))
+		success = FALSE;
+	else if (success && !ctxt->disableSAX && complete)
+		success = parse_feed (ctxt, converter, NULL, 0, TRUE,
+		                      charge, charge_data);
+
+	if (converter)
+		g_object_unref (converter);
+
+	return success;
+}
+
+
+/* The builder keeps one frame per open element it is interested in.
+ * Callers may extend SoupSoapSaxFrame by putting it first in a larger
+ * struct and passing the size of that to the builder.
+ */
+void
+_soup_soap_sax_builder_init (SoupSoapSaxBuilder *builder,
+                             gsize frame_size,
+                             SoupSoapStringPool *names,
+                             SoupSoapSaxChargeFunc charge,
+                             gpointer charge_data)
+{
+	builder->ctxt = NULL;
+	builder->frames = g_array_new (FALSE, FALSE, frame_size);
+	builder->text = g_string_new (NULL);
+	builder->names = names;
+	builder->depth = 0;
+	builder->skip_depth = 0;
+	builder->charge = charge;
+	builder->charge_data = charge_data;
+}
+
+void
+_soup_soap_sax_builder_clear (SoupSoapSaxBuilder *builder)
+{
+	g_array_unref (builder->frames);
+	g_string_free (builder->text, TRUE);
+}
+
+SoupSoapSaxFrame *
+_soup_soap_sax_builder_get_frame (SoupSoapSaxBuilder *builder,
+                                  guint index)
+{
+	return (SoupSoapSaxFrame *) (builder->frames->data +
+	                             index * g_array_get_element_size (builder->frames));
+}
+
+/* NULL while no frame is open */
+SoupSoapSaxFrame *
+_soup_soap_sax_builder_top (SoupSoapSaxBuilder *builder)
+{
+	if (builder->frames->len == 0)
+		return NULL;
+
+	return _soup_soap_sax_builder_get_frame (builder, builder->frames->len - 1);
+}
+
+/* Called first from a start element callback; returns FALSE while inside
+ * a skipped element, which the callback should then ignore.
+ */
+gboolean
+_soup_soap_sax_builder_start (SoupSoapSaxBuilder *builder)
+{
+	builder->depth++;
+
+	return builder->skip_depth == 0;
+}
+
+/* Skips the element just started, along with everything inside it */
+void
+_soup_soap_sax_builder_skip (SoupSoapSaxBuilder *builder)
+{
+	builder->skip_depth = builder->depth;
+}
+
+/* Called first from an end element callback, after which depth is that
+ * of the parent; returns FALSE if the element was skipped.
+ */
+gboolean
+_soup_soap_sax_builder_end (SoupSoapSaxBuilder *builder)
+{
+	gboolean skipped = builder->skip_depth != 0;
+
+	if (builder->skip_depth == builder->depth)
+		builder->skip_depth = 0;
+
+	builder->depth--;
+
+	return !skipped;
+}
+
+static gboolean
+builder_charge (SoupSoapSaxBuilder *builder,
+                SoupSoapParam *param)
+{
+	if (builder->charge && !builder->charge (param, builder->charge_data))
+	{
+		xmlStopParser (builder->ctxt);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Opens a frame for the element just started.  name is NULL for frames
+ * that only stand for group, such as the Header or Body, and a frame
+ * that does not capture is only kept for its children.
+ */
+SoupSoapSaxFrame *
+_soup_soap_sax_builder_push (SoupSoapSaxBuilder *builder,
+                             const xmlChar *namespace_uri,
+                             const xmlChar *name,
+                             SoupSoapParamGroup *group,
+                             gboolean capture)
+{
+	SoupSoapSaxFrame *frame;
+
+	g_array_set_size (builder->frames, builder->frames->len + 1);
+	frame = _soup_soap_sax_builder_top (builder);
+
+	frame->name = name ?
+		_soup_soap_string_pool_add (builder->names, (const gchar *) name) : NULL;
+	frame->namespace_uri = namespace_uri && *namespace_uri ?
+		_soup_soap_string_pool_add (builder->names, (const gchar *) namespace_uri) : NULL;
+	frame->group = group;
+	frame->capture = capture;
+
+	g_string_truncate (builder->text, 0);
+
+	return frame;
+}
+
+/* Creates the group of a frame and of its ancestors on first use */
+SoupSoapParamGroup *
+_soup_soap_sax_builder_ensure_group (SoupSoapSaxBuilder *builder,
+                                     guint index)
+{
+	SoupSoapSaxFrame *frame = _soup_soap_sax_builder_get_frame (builder, index);
+	SoupSoapParamGroup *parent;
+
+	if (frame->group == NULL)
+	{
+		parent = _soup_soap_sax_builder_ensure_group (builder, index - 1);
+
+		frame->group = SOUP_SOAP_PARAM_GROUP (
+			_soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM_GROUP,
+			                             frame->namespace_uri, frame->name));
+		soup_soap_param_group_add (parent, SOUP_SOAP_PARAM (frame->group));
+
+		builder_charge (builder, SOUP_SOAP_PARAM (frame->group));
+	}
+
+	return frame->group;
+}
+
+/* Closes the top frame, copying it to frame if that is not NULL.  A
+ * capturing frame that never got a group becomes a value of its parent.
+ */
+void
+_soup_soap_sax_builder_pop (SoupSoapSaxBuilder *builder,
+                            gpointer frame)
+{
+	SoupSoapSaxFrame *top = _soup_soap_sax_builder_top (builder);
+	gboolean make_value;
+	const gchar *name, *namespace_uri;
+
+	make_value = top->capture && top->group == NULL && top->name;
+	name = top->name;
+	namespace_uri = top->namespace_uri;
+
+	if (frame)
+		memcpy (frame, top, g_array_get_element_size (builder->frames));
+	g_array_set_size (builder->frames, builder->frames->len - 1);
+
+	if (make_value && builder->frames->len > 0)
+	{
+		SoupSoapParam *param = _soup_soap_param_new_pooled (SOUP_SOAP_TYPE_PARAM,
+		                                                    namespace_uri, name);
+
+		soup_soap_param_set_value (param, builder->text->str);
+		soup_soap_param_group_add (_soup_soap_sax_builder_ensure_group (builder,
+		                                                                builder->frames->len - 1),
+		                           param);
+
+		builder_charge (builder, param);
+	}
+
+	g_string_truncate (builder->text, 0);
+}
+
+/* Collects the text of a capturing frame that may still become a value */
+void
+_soup_soap_sax_builder_characters (SoupSoapSaxBuilder *builder,
+                                   const xmlChar *ch,
+                                   int len)
+{
+	SoupSoapSaxFrame *top;
+
+	if (builder->skip_depth)
+		return;
+
+	top = _soup_soap_sax_builder_top (builder);
+	if (top && top->capture && top->group == NULL)
+		g_string_append_len (builder->text, (const gchar *) ch, len);
+}
@@ -0,0 +1,226 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#include <libxml/xmlschemas.h>
+
+struct _SoupSoapSchemaPrivate
+{
+	xmlSchemaPtr schema;
+};
+
+#define SOUP_SOAP_SCHEMA_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_SCHEMA, SoupSoapSchemaPrivate))
+
+/* Compiled schemas are immutable, so one instance per file is shared by
+ * every thread for the life of the process.
+ */
+static GMutex schema_cache_lock;
+static GHashTable *schema_cache = NULL;
+
+
+/* libxml2 2.12 made the error const; the casts where the handler is set
+ * keep older versions building as well.
+ */
+static void
+schema_error_handler (void *user_data,
+                      const xmlError *xml_error)
+{
+	GError **error = user_data;
+	gchar *message;
+
+	/* Only the first violation is reported */
+	if (*error != NULL || xml_error->level < XML_ERR_ERROR)
+		return;
+
+	message = g_strstrip (g_strdup (xml_error->message ? xml_error->message : ""));
+	g_set_error (error, SOUP_SOAP_SCHEMA_ERROR,
+	             SOUP_SOAP_SCHEMA_ERROR_INVALID,
+	             _("Line %d: %s"), xml_error->line, message);
+	g_free (message);
+}
+
+static SoupSoapSchema *
+schema_new (xmlSchemaParserCtxtPtr ctxt,
+            GError **error)
+{
+	SoupSoapSchema *schema;
+	xmlSchemaPtr xml_schema;
+	GError *parse_error = NULL;
+
+	if (ctxt == NULL)
+	{
+		g_set_error_literal (error, SOUP_SOAP_SCHEMA_ERROR,
+		                     SOUP_SOAP_SCHEMA_ERROR_PARSE,
+		                     _("Cannot create schema parser"));
+		return NULL;
+	}
+
+	xmlSchemaSetParserStructuredErrors (ctxt,
+	                                    (xmlStructuredErrorFunc) schema_error_handler,
+	                                    &parse_error);
+	xml_schema = xmlSchemaParse (ctxt);
+	xmlSchemaFreeParserCtxt (ctxt);
+
+	if (xml_schema == NULL)
+	{
+		if (parse_error)
+		{
+			parse_error->code = SOUP_SOAP_SCHEMA_ERROR_PARSE;
+			g_propagate_error (error, parse_error);
+		}
+		else
+			g_set_error_literal (error, SOUP_SOAP_SCHEMA_ERROR,
+			                     SOUP_SOAP_SCHEMA_ERROR_PARSE,
+			                     _("Cannot compile schema"));
+		return NULL;
+	}
+
+	schema = g_object_new (SOUP_SOAP_TYPE_SCHEMA, NULL);
+	schema->priv->schema = xml_schema;
+
+	return schema;
+}
+
+
+GQuark
+soup_soap_schema_error_quark (void)
+{
+	return g_quark_from_static_string ("soup-soap-schema-error-quark");
+}
+
+
+G_DEFINE_TYPE (SoupSoapSchema, soup_soap_schema, G_TYPE_OBJECT);
+
+static void
+soup_soap_schema_init (SoupSoapSchema *object)
+{
+	object->priv = SOUP_SOAP_SCHEMA_GET_PRIVATE (object);
+	SoupSoapSchemaPrivate *priv = object->priv;
+
+	priv->schema = NULL;
+}
+
+static void
+soup_soap_schema_finalize (GObject *object)
+{
+	SoupSoapSchema *schema = SOUP_SOAP_SCHEMA (object);
+	SoupSoapSchemaPrivate *priv = schema->priv;
+
+	if (priv->schema)
+		xmlSchemaFree (priv->schema);
+
+	G_OBJECT_CLASS (soup_soap_schema_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_schema_class_init (SoupSoapSchemaClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (SoupSoapSchemaPrivate));
+
+	object_class->finalize = soup_soap_schema_finalize;
+
+	xmlInitParser ();
+}
+
+
+/* Compiles the schema at filename, or returns a new reference to the one
+ * compiled earlier from the same file.
+ */
+SoupSoapSchema *
+soup_soap_schema_new_from_file (const gchar *filename,
+                                GError **error)
+{
+	SoupSoapSchema *schema;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	g_mutex_lock (&schema_cache_lock);
+
+	if (schema_cache == NULL)
+		schema_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                      g_free, g_object_unref);
+
+	schema = g_hash_table_lookup (schema_cache, filename);
+
+	if (schema == NULL)
+	{
+		schema = schema_new (xmlSchemaNewParserCtxt (filename), error);
+		if (schema)
+			g_hash_table_insert (schema_cache, g_strdup (filename), schema);
+	}
+
+	if (schema)
+		g_object_ref (schema);
+
+	g_mutex_unlock (&schema_cache_lock);
+
+	return schema;
+}
+
+SoupSoapSchema *
+soup_soap_schema_new_from_data (const gchar *data,
+                                gsize length,
+                                GError **error)
+{
+	g_return_val_if_fail (data != NULL, NULL);
+
+	return schema_new (xmlSchemaNewMemParserCtxt (data, length), error);
+}
+
+/* Validates one element and its subtree.  The compiled schema is only
+ * read, so each call takes a validation context of its own and any
+ * number of threads may validate against the same schema at once.
+ */
+gboolean
+_soup_soap_schema_validate_element (SoupSoapSchema *schema,
+                                    xmlNodePtr node,
+                                    GError **error)
+{
+	xmlSchemaValidCtxtPtr ctxt;
+	GError *valid_error = NULL;
+	int result;
+
+	ctxt = xmlSchemaNewValidCtxt (schema->priv->schema);
+	xmlSchemaSetValidStructuredErrors (ctxt,
+	                                   (xmlStructuredErrorFunc) schema_error_handler,
+	                                   &valid_error);
+
+	result = xmlSchemaValidateOneElement (ctxt, node);
+	xmlSchemaFreeValidCtxt (ctxt);
+
+	if (result == 0)
+		return TRUE;
+
+	if (valid_error == NULL)
+		g_set_error_literal (&valid_error, SOUP_SOAP_SCHEMA_ERROR,
+		                     SOUP_SOAP_SCHEMA_ERROR_INVALID,
+		                     _("Element does not match the schema"));
+
+	g_propagate_error (error, valid_error);
+
+	return FALSE;
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_SCHEMA_H_
+#define _SOUP_SOAP_SCHEMA_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_SCHEMA             (soup_soap_schema_get_type ())
+#define SOUP_SOAP_SCHEMA(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_SCHEMA, SoupSoapSchema))
+#define SOUP_SOAP_SCHEMA_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_SCHEMA, SoupSoapSchemaClass))
+#define SOUP_SOAP_IS_SCHEMA(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_SCHEMA))
+#define SOUP_SOAP_IS_SCHEMA_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_SCHEMA))
+#define SOUP_SOAP_SCHEMA_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_SCHEMA, SoupSoapSchemaClass))
+
+typedef struct _SoupSoapSchemaPrivate SoupSoapSchemaPrivate;
+typedef struct _SoupSoapSchemaClass SoupSoapSchemaClass;
+typedef struct _SoupSoapSchema SoupSoapSchema;
+
+struct _SoupSoapSchemaClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapSchema
+{
+	GObject parent_instance;
+
+	SoupSoapSchemaPrivate *priv;
+};
+
+GType soup_soap_schema_get_type (void) G_GNUC_CONST;
+SoupSoapSchema *soup_soap_schema_new_from_file (const gchar *filename, GError **error);
+SoupSoapSchema *soup_soap_schema_new_from_data (const gchar *data, gsize length, GError **error);
+
+typedef enum
+{
+	SOUP_SOAP_SCHEMA_ERROR_PARSE,
+	SOUP_SOAP_SCHEMA_ERROR_INVALID
+} SoupSoapSchemaError;
+
+#define SOUP_SOAP_SCHEMA_ERROR soup_soap_schema_error_quark()
+
+GQuark soup_soap_schema_error_quark (void);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_SCHEMA_H_ */
@@ -0,0 +1,635 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+#include <libxml/parser.h>
+
+struct _SoupSoapServerPrivate
+{
+	SoupServer *server;
+	gchar *path;
+	GMainContext *context;
+	GThreadPool *pool;
+
+	GMutex handlers_lock;
+	GHashTable *handlers;
+};
+
+#define SOUP_SOAP_SERVER_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), SOUP_SOAP_TYPE_SERVER, SoupSoapServerPrivate))
+
+enum
+{
+	PROP_0,
+
+	PROP_SERVER,
+	PROP_PATH,
+	PROP_MAX_THREADS
+};
+
+typedef struct
+{
+	volatile gint ref_count;
+	SoupSoapServerCallback callback;
+	gpointer user_data;
+	GDestroyNotify destroy;
+} SoupSoapServerHandler;
+
+/* Responses with a producer are written by workers a window at a time
+ * into chunks, which the main context moves to the message.  The worker
+ * owns stream and chunks while producing is set, the main context
+ * otherwise.
+ */
+typedef struct
+{
+	SoupSoapServer *server;
+	SoupMessage *msg;
+	guint status;
+
+	/* libsoup counts references to these without atomics, so they are
+	 * taken and dropped on the server context, never by a worker.
+	 */
+	SoupMessageHeaders *request_headers;
+	SoupMessageBody *request_body;
+	SoupMessageHeaders *response_headers;
+	SoupMessageBody *response_body;
+
+	SoupSoapMessageStream *stream;
+	SoupMessageBody *chunks;
+	gboolean producing;
+	gboolean produced;
+	gboolean started;
+	gboolean aborted;
+	guint chunks_queued;
+	guint chunks_written;
+	guint chunks_written_seen;  /* chunks_written when production began */
+	gulong wrote_chunk_id;
+	gulong finished_id;
+} SoupSoapServerJob;
+
+
+static SoupSoapServerHandler *
+handler_ref (SoupSoapServerHandler *handler)
+{
+	g_atomic_int_inc (&handler->ref_count);
+
+	return handler;
+}
+
+static void
+handler_unref (SoupSoapServerHandler *handler)
+{
+	if (!g_atomic_int_dec_and_test (&handler->ref_count))
+		return;
+
+	if (handler->destroy)
+		handler->destroy (handler->user_data);
+
+	g_slice_free (SoupSoapServerHandler, handler);
+}
+
+static gboolean soup_soap_server_send_chunks (gpointer data);
+
+static void
+soup_soap_server_job_free (SoupSoapServerJob *job)
+{
+	if (job->wrote_chunk_id)
+		g_signal_handler_disconnect (job->msg, job->wrote_chunk_id);
+	if (job->finished_id)
+		g_signal_handler_disconnect (job->msg, job->finished_id);
+	if (job->stream)
+		_soup_soap_message_stream_free (job->stream);
+	if (job->chunks)
+		soup_message_body_free (job->chunks);
+
+	soup_message_headers_free (job->request_headers);
+	soup_message_body_free (job->request_body);
+	soup_message_headers_free (job->response_headers);
+	soup_message_body_free (job->response_body);
+
+	g_object_unref (job->msg);
+	g_object_unref (job->server);
+	g_slice_free (SoupSoapServerJob, job);
+}
+
+static void
+soup_soap_server_produce (SoupSoapServerJob *job)
+{
+	job->produced = _soup_soap_message_stream_produce (job->stream,
+	                                                   job->chunks_written_seen);
+
+	g_main_context_invoke (job->server->priv->context,
+	                       soup_soap_server_send_chunks, job);
+}
+
+static void
+soup_soap_server_wrote_chunk (SoupMessage *msg,
+                              gpointer user_data)
+{
+	SoupSoapServerJob *job = user_data;
+
+	job->chunks_written++;
+
+	if (job->producing || job->produced)
+		return;
+
+	job->producing = TRUE;
+	job->chunks_written_seen = job->chunks_written;
+	g_thread_pool_push (job->server->priv->pool, job, NULL);
+}
+
+static void
+soup_soap_server_finished (SoupMessage *msg,
+                           gpointer user_data)
+{
+	SoupSoapServerJob *job = user_data;
+
+	/* The client went away before the body was complete */
+	job->aborted = TRUE;
+
+	if (!job->producing)
+		soup_soap_server_job_free (job);
+}
+
+/* Hands the chunks written so far to the message, starting the response
+ * the first time.
+ */
+static gboolean
+soup_soap_server_send_chunks (gpointer data)
+{
+	SoupSoapServerJob *job = data;
+	SoupSoapServerPrivate *priv = job->server->priv;
+	SoupBuffer *chunk;
+	goffset offset = 0;
+
+	job->producing = FALSE;
+
+	if (job->aborted)
+	{
+		soup_soap_server_job_free (job);
+		return FALSE;
+	}
+
+	if (!job->started)
+	{
+		soup_message_set_status (job->msg, job->status);
+		job->wrote_chunk_id = g_signal_connect (job->msg, "wrote-chunk",
+		                                        G_CALLBACK (soup_soap_server_wrote_chunk),
+		                                        job);
+		job->finished_id = g_signal_connect (job->msg, "finished",
+		                                     G_CALLBACK (soup_soap_server_finished),
+		                                     job);
+		job->started = TRUE;
+	}
+
+	while ((chunk = soup_message_body_get_chunk (job->chunks, offset)) != NULL)
+	{
+		offset += chunk->length;
+		soup_message_body_append_buffer (job->msg->response_body, chunk);
+		soup_buffer_free (chunk);
+		job->chunks_queued++;
+	}
+	soup_message_body_truncate (job->chunks);
+
+	if (job->produced)
+		soup_message_body_complete (job->msg->response_body);
+
+	soup_server_unpause_message (priv->server, job->msg);
+
+	if (job->produced)
+		soup_soap_server_job_free (job);
+
+	return FALSE;
+}
+
+static gboolean
+soup_soap_server_complete (gpointer data)
+{
+	SoupSoapServerJob *job = data;
+
+	soup_message_set_status (job->msg, job->status);
+	soup_server_unpause_message (job->server->priv->server, job->msg);
+
+	soup_soap_server_job_free (job);
+
+	return FALSE;
+}
+
+static void
+soup_soap_server_dispatch (gpointer data,
+                           gpointer user_data)
+{
+	SoupSoapServerJob *job = data;
+	SoupSoapServer *server = job->server;
+	SoupSoapServerPrivate *priv = server->priv;
+	SoupMessage *msg = job->msg;
+
+	SoupSoapServerHandler *handler;
+	SoupSoapMessage *request, *response;
+	const gchar *operation;
+	gchar *name;
+
+	if (job->stream)
+	{
+		soup_soap_server_produce (job);
+		return;
+	}
+
+	/* Both messages use the references the job holds; they are detached
+	 * before they are dropped, as a handler may keep them.
+	 */
+	request = _soup_soap_message_new_adopting (job->request_headers,
+	                                           job->request_body);
+	response = _soup_soap_message_new_adopting (job->response_headers,
+	                                            job->response_body);
+	soup_soap_message_set_content_encoding (response,
+	                                        soup_soap_content_encoding_negotiate (msg->request_headers));
+	/* Caches must not hand a compressed response to other clients */
+	soup_message_headers_append (msg->response_headers,
+	                             "Vary", "Accept-Encoding");
+	soup_soap_message_set_wire_format (response,
+	                                   soup_soap_message_get_wire_format (request));
+
+	operation = soup_soap_message_get_operation_name (request);
+
+	/* A request that failed to parse, or whose Body is empty, leaves
+	 * the group with its own name, which must not be taken for an
+	 * operation.
+	 */
+	if (soup_soap_message_get_parse_error (request) ||
+	    !soup_soap_message_has_operation (request))
+		operation = NULL;
+
+	g_mutex_lock (&priv->handlers_lock);
+	handler = operation ? g_hash_table_lookup (priv->handlers, operation) : NULL;
+	if (handler)
+		handler_ref (handler);
+	g_mutex_unlock (&priv->handlers_lock);
+
+	if (operation == NULL)
+	{
+		const GError *error = soup_soap_message_get_parse_error (request);
+
+		soup_soap_message_set_fault (response, "SOAP-ENV:Client",
+		                             error ? error->message :
+		                             _("The request does not name an operation"));
+	}
+	else if (handler)
+	{
+		name = g_strconcat (operation, "Response", NULL);
+		soup_soap_message_set_operation_name (response, name);
+		g_free (name);
+		soup_soap_param_set_namespace_uri (SOUP_SOAP_PARAM (soup_soap_message_get_params (response)),
+		                                   soup_soap_param_get_namespace_uri (SOUP_SOAP_PARAM (soup_soap_message_get_params (request))));
+
+		handler->callback (server, request, response, handler->user_data);
+		handler_unref (handler);
+	}
+	else
+	{
+		name = g_strdup_printf (_("Operation '%s' is not supported"),
+		                        operation);
+		soup_soap_message_set_fault (response, "SOAP-ENV:Client", name);
+		g_free (name);
+	}
+
+	/* SOAP 1.1 requires faults to be reported with a 500 status */
+	if (soup_soap_message_is_fault (response))
+		job->status = SOUP_STATUS_INTERNAL_SERVER_ERROR;
+	else
+		job->status = SOUP_STATUS_OK;
+
+	/* Stream records from the producer as the connection drains */
+	if (soup_soap_message_has_producer (response) &&
+	    !soup_soap_message_is_fault (response))
+	{
+		job->chunks = soup_message_body_new ();
+		job->stream = _soup_soap_message_stream_new (response, job->chunks);
+		job->producing = TRUE;
+
+		_soup_soap_message_detach (response);
+		_soup_soap_message_detach (request);
+		g_object_unref (response);
+		g_object_unref (request);
+
+		soup_soap_server_produce (job);
+		return;
+	}
+
+	soup_soap_message_persist (response);
+
+	_soup_soap_message_detach (response);
+	_soup_soap_message_detach (request);
+	g_object_unref (response);
+	g_object_unref (request);
+
+	g_main_context_invoke (priv->context, soup_soap_server_complete, job);
+}
+
+static void
+soup_soap_server_callback (SoupServer *soup_server,
+                           SoupMessage *msg,
+                           const char *path,
+                           GHashTable *query,
+                           SoupClientContext *client,
+                           gpointer user_data)
+{
+	SoupSoapServer *server = SOUP_SOAP_SERVER (user_data);
+	SoupSoapServerJob *job;
+
+	if (msg->method != SOUP_METHOD_POST)
+	{
+		soup_message_set_status (msg, SOUP_STATUS_NOT_IMPLEMENTED);
+		return;
+	}
+
+	job = g_slice_new0 (SoupSoapServerJob);
+	job->server = g_object_ref (server);
+	job->msg = g_object_ref (msg);
+	job->status = SOUP_STATUS_INTERNAL_SERVER_ERROR;
+	job->request_headers = g_boxed_copy (SOUP_TYPE_MESSAGE_HEADERS,
+	                                     msg->request_headers);
+	job->request_body = g_boxed_copy (SOUP_TYPE_MESSAGE_BODY,
+	                                  msg->request_body);
+	job->response_headers = g_boxed_copy (SOUP_TYPE_MESSAGE_HEADERS,
+	                                      msg->response_headers);
+	job->response_body = g_boxed_copy (SOUP_TYPE_MESSAGE_BODY,
+	                                   msg->response_body);
+
+	/* Keep the connection quiet until the worker has built the response */
+	soup_server_pause_message (soup_server, msg);
+
+	g_thread_pool_push (server->priv->pool, job, NULL);
+}
+
+
+G_DEFINE_TYPE (SoupSoapServer, soup_soap_server, G_TYPE_OBJECT);
+
+static void
+soup_soap_server_init (SoupSoapServer *object)
+{
+	object->priv = SOUP_SOAP_SERVER_GET_PRIVATE (object);
+	SoupSoapServerPrivate *priv = object->priv;
+
+	priv->server = NULL;
+	priv->path = NULL;
+	priv->context = g_main_context_ref_thread_default ();
+	priv->pool = g_thread_pool_new (soup_soap_server_dispatch, object,
+	                                g_get_num_processors (), FALSE,
+	                                NULL);
+
+	g_mutex_init (&priv->handlers_lock);
+	priv->handlers = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                        g_free,
+	                                        (GDestroyNotify) handler_unref);
+}
+
+static void
+soup_soap_server_constructed (GObject *object)
+{
+	SoupSoapServer *server = SOUP_SOAP_SERVER (object);
+	SoupSoapServerPrivate *priv = server->priv;
+
+	soup_server_add_handler (priv->server, priv->path,
+	                         soup_soap_server_callback,
+	                         server, NULL);
+
+	G_OBJECT_CLASS (soup_soap_server_parent_class)->constructed (object);
+}
+
+static void
+soup_soap_server_dispose (GObject *object)
+{
+	SoupSoapServer *server = SOUP_SOAP_SERVER (object);
+	SoupSoapServerPrivate *priv = server->priv;
+
+	if (priv->server)
+	{
+		soup_server_remove_handler (priv->server, priv->path);
+		g_object_unref (priv->server);
+		priv->server = NULL;
+	}
+
+	G_OBJECT_CLASS (soup_soap_server_parent_class)->dispose (object);
+}
+
+static void
+soup_soap_server_finalize (GObject *object)
+{
+	SoupSoapServer *server = SOUP_SOAP_SERVER (object);
+	SoupSoapServerPrivate *priv = server->priv;
+
+	g_thread_pool_free (priv->pool, FALSE, TRUE);
+	g_hash_table_unref (priv->handlers);
+	g_mutex_clear (&priv->handlers_lock);
+	g_main_context_unref (priv->context);
+	g_free (priv->path);
+
+	G_OBJECT_CLASS (soup_soap_server_parent_class)->finalize (object);
+}
+
+static void
+soup_soap_server_set_property (GObject *object,
+                               guint prop_id,
+                               const GValue *value,
+                               GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_SERVER (object));
+
+	SoupSoapServer *server = SOUP_SOAP_SERVER (object);
+	SoupSoapServerPrivate *priv = server->priv;
+
+	switch (prop_id)
+	{
+		case PROP_SERVER:
+			priv->server = g_value_dup_object (value);
+			break;
+		case PROP_PATH:
+			priv->path = g_value_dup_string (value);
+			break;
+		case PROP_MAX_THREADS:
+			soup_soap_server_set_max_threads (server,
+			                                  g_value_get_int (value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_server_get_property (GObject *object,
+                               guint prop_id,
+                               GValue *value,
+                               GParamSpec *pspec)
+{
+	g_return_if_fail (SOUP_SOAP_IS_SERVER (object));
+
+	SoupSoapServer *server = SOUP_SOAP_SERVER (object);
+	SoupSoapServerPrivate *priv = server->priv;
+
+	switch (prop_id)
+	{
+		case PROP_SERVER:
+			g_value_set_object (value, priv->server);
+			break;
+		case PROP_PATH:
+			g_value_set_string (value, priv->path);
+			break;
+		case PROP_MAX_THREADS:
+			g_value_set_int (value,
+			                 soup_soap_server_get_max_threads (server));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+soup_soap_server_class_init (SoupSoapServerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	/*GObjectClass *parent_class = G_OBJECT_CLASS (klass);*/
+
+	g_type_class_add_private (klass, sizeof (SoupSoapServerPrivate));
+
+	object_class->constructed = soup_soap_server_constructed;
+	object_class->dispose = soup_soap_server_dispose;
+	object_class->finalize = soup_soap_server_finalize;
+	object_class->set_property = soup_soap_server_set_property;
+	object_class->get_property = soup_soap_server_get_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_SERVER,
+	                                 g_param_spec_object ("server",
+	                                                      "Server",
+	                                                      "The server receiving the SOAP requests",
+	                                                      SOUP_TYPE_SERVER,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_PATH,
+	                                 g_param_spec_string ("path",
+	                                                      "Path",
+	                                                      "The path where the SOAP endpoint is registered",
+	                                                      NULL,
+	                                                      G_PARAM_READABLE | G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_MAX_THREADS,
+	                                 g_param_spec_int ("max-threads",
+	                                                   "Maximum threads",
+	                                                   "The maximum number of threads handling requests",
+	                                                   -1, G_MAXINT, g_get_num_processors (),
+	                                                   G_PARAM_READABLE | G_PARAM_WRITABLE));
+
+	/* libxml2 must be initialized before parsing from several threads */
+	xmlInitParser ();
+}
+
+
+SoupSoapServer *
+soup_soap_server_new (SoupServer *server,
+                      const gchar *path)
+{
+	g_return_val_if_fail (SOUP_IS_SERVER (server), NULL);
+
+	return g_object_new (SOUP_SOAP_TYPE_SERVER,
+	                     "server", server,
+	                     "path", path,
+	                     NULL);
+}
+
+SoupServer *
+soup_soap_server_get_server (SoupSoapServer *server)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_SERVER (server), NULL);
+
+	return server->priv->server;
+}
+
+const gchar *
+soup_soap_server_get_path (SoupSoapServer *server)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_SERVER (server), NULL);
+
+	return server->priv->path;
+}
+
+gint
+soup_soap_server_get_max_threads (SoupSoapServer *server)
+{
+	g_return_val_if_fail (SOUP_SOAP_IS_SERVER (server), 0);
+
+	return g_thread_pool_get_max_threads (server->priv->pool);
+}
+
+void
+soup_soap_server_set_max_threads (SoupSoapServer *server,
+                                  gint max_threads)
+{
+	g_return_if_fail (SOUP_SOAP_IS_SERVER (server));
+	g_return_if_fail (max_threads != 0);
+
+	g_thread_pool_set_max_threads (server->priv->pool, max_threads, NULL);
+}
+
+void
+soup_soap_server_add_handler (SoupSoapServer *server,
+                              const gchar *operation,
+                              SoupSoapServerCallback callback,
+                              gpointer user_data,
+                              GDestroyNotify destroy)
+{
+	g_return_if_fail (SOUP_SOAP_IS_SERVER (server));
+	g_return_if_fail (operation != NULL && *operation != '\0');
+	g_return_if_fail (callback != NULL);
+
+	SoupSoapServerPrivate *priv = server->priv;
+	SoupSoapServerHandler *handler = g_slice_new (SoupSoapServerHandler);
+
+	handler->ref_count = 1;
+	handler->callback = callback;
+	handler->user_data = user_data;
+	handler->destroy = destroy;
+
+	g_mutex_lock (&priv->handlers_lock);
+	g_hash_table_replace (priv->handlers, g_strdup (operation), handler);
+	g_mutex_unlock (&priv->handlers_lock);
+}
+
+void
+soup_soap_server_remove_handler (SoupSoapServer *server,
+                                 const gchar *operation)
+{
+	g_return_if_fail (SOUP_SOAP_IS_SERVER (server));
+	g_return_if_fail (operation != NULL);
+
+	SoupSoapServerPrivate *priv = server->priv;
+
+	g_mutex_lock (&priv->handlers_lock);
+	g_hash_table_remove (priv->handlers, operation);
+	g_mutex_unlock (&priv->handlers_lock);
+}
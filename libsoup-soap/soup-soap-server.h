@@ -0,0 +1,73 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_SERVER_H_
+#define _SOUP_SOAP_SERVER_H_
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap-message.h>
+
+G_BEGIN_DECLS
+
+#define SOUP_SOAP_TYPE_SERVER             (soup_soap_server_get_type ())
+#define SOUP_SOAP_SERVER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SOUP_SOAP_TYPE_SERVER, SoupSoapServer))
+#define SOUP_SOAP_SERVER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SOUP_SOAP_TYPE_SERVER, SoupSoapServerClass))
+#define SOUP_SOAP_IS_SERVER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SOUP_SOAP_TYPE_SERVER))
+#define SOUP_SOAP_IS_SERVER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SOUP_SOAP_TYPE_SERVER))
+#define SOUP_SOAP_SERVER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SOUP_SOAP_TYPE_SERVER, SoupSoapServerClass))
+
+typedef struct _SoupSoapServerPrivate SoupSoapServerPrivate;
+typedef struct _SoupSoapServerClass SoupSoapServerClass;
+typedef struct _SoupSoapServer SoupSoapServer;
+
+struct _SoupSoapServerClass
+{
+	GObjectClass parent_class;
+};
+
+struct _SoupSoapServer
+{
+	GObject parent_instance;
+
+	SoupSoapServerPrivate *priv;
+};
+
+/* Handlers are invoked from a worker thread, never from the main loop.
+ * A handler may give the response a producer instead of building every
+ * record; records are then asked for, from worker threads, as the
+ * connection drains.
+ */
+typedef void (*SoupSoapServerCallback) (SoupSoapServer *server,
+                                        SoupSoapMessage *request,
+                                        SoupSoapMessage *response,
+                                        gpointer user_data);
+
+GType soup_soap_server_get_type (void) G_GNUC_CONST;
+SoupSoapServer *soup_soap_server_new (SoupServer *server, const gchar *path);
+SoupServer *soup_soap_server_get_server (SoupSoapServer *server);
+const gchar *soup_soap_server_get_path (SoupSoapServer *server);
+gint soup_soap_server_get_max_threads (SoupSoapServer *server);
+void soup_soap_server_set_max_threads (SoupSoapServer *server, gint max_threads);
+void soup_soap_server_add_handler (SoupSoapServer *server, const gchar *operation, SoupSoapServerCallback callback, gpointer user_data, GDestroyNotify destroy);
+void soup_soap_server_remove_handler (SoupSoapServer *server, const gchar *operation);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_SERVER_H_ */
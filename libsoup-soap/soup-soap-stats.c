@@ -0,0 +1,191 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Process-wide counters.  Each thread adds to its own slot, guarded by a
+ * sequence count instead of a lock, so recording never contends; only
+ * snapshots and thread start and exit take the registry lock.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <time.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+#include <libsoup-soap/soup-soap-private.h>
+
+typedef struct
+{
+	volatile gint sequence;
+	SoupSoapStats stats;
+} StatsSlot;
+
+static GMutex stats_lock;
+static GSList *stats_slots = NULL;
+static SoupSoapStats stats_retired;
+
+static void stats_slot_free (gpointer data);
+
+static GPrivate stats_slot = G_PRIVATE_INIT (stats_slot_free);
+
+
+static void
+stats_merge (SoupSoapStats *total,
+             const SoupSoapStats *stats)
+{
+	total->messages_parsed += stats->messages_parsed;
+	total->messages_persisted += stats->messages_persisted;
+	total->parse_wall_time += stats->parse_wall_time;
+	total->parse_cpu_time += stats->parse_cpu_time;
+	total->persist_wall_time += stats->persist_wall_time;
+	total->persist_cpu_time += stats->persist_cpu_time;
+	total->input_bytes += stats->input_bytes;
+	total->output_bytes += stats->output_bytes;
+	total->elements += stats->elements;
+	total->parse_params += stats->parse_params;
+	total->persist_nodes += stats->persist_nodes;
+	total->output_chunks += stats->output_chunks;
+	total->max_depth = MAX (total->max_depth, stats->max_depth);
+}
+
+/* Folds the counters of an exiting thread into the retired totals */
+static void
+stats_slot_free (gpointer data)
+{
+	StatsSlot *slot = data;
+
+	g_mutex_lock (&stats_lock);
+	stats_slots = g_slist_remove (stats_slots, slot);
+	stats_merge (&stats_retired, &slot->stats);
+	g_mutex_unlock (&stats_lock);
+
+	g_slice_free (StatsSlot, slot);
+}
+
+static StatsSlot *
+stats_get_slot (void)
+{
+	StatsSlot *slot = g_private_get (&stats_slot);
+
+	if (slot == NULL)
+	{
+		slot = g_slice_new0 (StatsSlot);
+		g_private_set (&stats_slot, slot);
+
+		g_mutex_lock (&stats_lock);
+		stats_slots = g_slist_prepend (stats_slots, slot);
+		g_mutex_unlock (&stats_lock);
+	}
+
+	return slot;
+}
+
+/* Only the owning thread writes a slot; an odd sequence tells readers
+ * that an update is in progress.
+ */
+static void
+stats_begin (StatsSlot *slot)
+{
+	g_atomic_int_inc (&slot->sequence);
+}
+
+static void
+stats_end (StatsSlot *slot)
+{
+	g_atomic_int_inc (&slot->sequence);
+}
+
+gint64
+_soup_soap_stats_get_cpu_time (void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+
+	if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#endif
+
+	return 0;
+}
+
+void
+_soup_soap_stats_add_parse (const SoupSoapMessageStats *message_stats)
+{
+	StatsSlot *slot = stats_get_slot ();
+
+	stats_begin (slot);
+	slot->stats.messages_parsed++;
+	slot->stats.parse_wall_time += message_stats->parse_wall_time;
+	slot->stats.parse_cpu_time += message_stats->parse_cpu_time;
+	slot->stats.input_bytes += message_stats->input_bytes;
+	slot->stats.elements += message_stats->elements;
+	slot->stats.parse_params += message_stats->parse_params;
+	slot->stats.max_depth = MAX (slot->stats.max_depth, message_stats->max_depth);
+	stats_end (slot);
+}
+
+void
+_soup_soap_stats_add_persist (const SoupSoapMessageStats *message_stats)
+{
+	StatsSlot *slot = stats_get_slot ();
+
+	stats_begin (slot);
+	slot->stats.messages_persisted++;
+	slot->stats.persist_wall_time += message_stats->persist_wall_time;
+	slot->stats.persist_cpu_time += message_stats->persist_cpu_time;
+	slot->stats.output_bytes += message_stats->output_bytes;
+	slot->stats.persist_nodes += message_stats->persist_nodes;
+	slot->stats.output_chunks += message_stats->output_chunks;
+	slot->stats.max_depth = MAX (slot->stats.max_depth, message_stats->max_depth);
+	stats_end (slot);
+}
+
+/* Fills stats with the totals so far.  Counters only grow; take the
+ * difference of two snapshots for a rate.
+ */
+void
+soup_soap_stats_snapshot (SoupSoapStats *stats)
+{
+	GSList *slots;
+
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&stats_lock);
+
+	*stats = stats_retired;
+
+	for (slots = stats_slots; slots != NULL; slots = g_slist_next (slots))
+	{
+		StatsSlot *slot = slots->data;
+		SoupSoapStats copy;
+		gint sequence;
+
+		do
+		{
+			sequence = g_atomic_int_get (&slot->sequence);
+			copy = slot->stats;
+		} while ((sequence & 1) ||
+		         sequence != g_atomic_int_get (&slot->sequence));
+
+		stats_merge (stats, &copy);
+	}
+
+	g_mutex_unlock (&stats_lock);
+}
@@ -0,0 +1,68 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOUP_SOAP_STATS_H_
+#define _SOUP_SOAP_STATS_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _SoupSoapMessageStats SoupSoapMessageStats;
+typedef struct _SoupSoapStats SoupSoapStats;
+
+/* Times are in microseconds; CPU time is that of the calling thread */
+struct _SoupSoapMessageStats
+{
+	gint64 parse_wall_time;
+	gint64 parse_cpu_time;
+	gint64 persist_wall_time;
+	gint64 persist_cpu_time;
+	gsize input_bytes;          /* body as received, still compressed */
+	gsize output_bytes;         /* body as persisted, compressed */
+	guint elements;             /* params below the header and body */
+	guint max_depth;
+	guint parse_params;         /* params created by the parser */
+	guint persist_nodes;        /* libxml2 nodes built to persist */
+	guint output_chunks;        /* chunks appended to the body */
+};
+
+/* Totals over every message of the process */
+struct _SoupSoapStats
+{
+	guint64 messages_parsed;
+	guint64 messages_persisted;
+	guint64 parse_wall_time;
+	guint64 parse_cpu_time;
+	guint64 persist_wall_time;
+	guint64 persist_cpu_time;
+	guint64 input_bytes;
+	guint64 output_bytes;
+	guint64 elements;
+	guint64 parse_params;
+	guint64 persist_nodes;
+	guint64 output_chunks;
+	guint max_depth;
+};
+
+void soup_soap_stats_snapshot (SoupSoapStats *stats);
+
+G_END_DECLS
+
+#endif /* _SOUP_SOAP_STATS_H_ */
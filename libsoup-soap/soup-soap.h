@@ -18,4 +18,15 @@
 
 #include <libsoup-soap/soup-soap-param.h>
 #include <libsoup-soap/soup-soap-param-group.h>
+#include <libsoup-soap/soup-soap-path.h>
+#include <libsoup-soap/soup-soap-schema.h>
+#include <libsoup-soap/soup-soap-stats.h>
+#include <libsoup-soap/soup-soap-latency.h>
 #include <libsoup-soap/soup-soap-message.h>
+#include <libsoup-soap/soup-soap-frozen-message.h>
+#include <libsoup-soap/soup-soap-server.h>
+#include <libsoup-soap/soup-soap-cache.h>
+#include <libsoup-soap/soup-soap-client.h>
+#include <libsoup-soap/soup-soap-binding.h>
+#include <libsoup-soap/soup-soap-record-reader.h>
+#include <libsoup-soap/soup-soap-json-transcoder.h>
@@ -0,0 +1,119 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The counter interposes malloc() and friends for the whole test program,
+ * libxml2 and GLib included, and hands every call on to the C library.
+ * This needs the __libc_ entry points of glibc; elsewhere the tests that
+ * use it are skipped.
+ */
+
+#include <config.h>
+
+#include <stddef.h>
+
+#include "alloc-counter.h"
+
+#ifdef __GLIBC__
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+/* Only the thread under test counts, not GLib's worker threads */
+static __thread gboolean counting;
+static __thread AllocCount current;
+
+static inline void
+count_allocation (size_t size)
+{
+	if (counting)
+	{
+		current.allocations++;
+		current.bytes += size;
+	}
+}
+
+void *
+malloc (size_t size)
+{
+	count_allocation (size);
+
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+	count_allocation (n_members * size);
+
+	return __libc_calloc (n_members, size);
+}
+
+/* A realloc() counts as a new allocation of the new size */
+void *
+realloc (void *ptr,
+         size_t size)
+{
+	if (size > 0)
+		count_allocation (size);
+
+	return __libc_realloc (ptr, size);
+}
+
+void
+free (void *ptr)
+{
+	__libc_free (ptr);
+}
+
+gboolean
+alloc_counter_is_available (void)
+{
+	return TRUE;
+}
+
+#else /* !__GLIBC__ */
+
+static gboolean counting;
+static AllocCount current;
+
+gboolean
+alloc_counter_is_available (void)
+{
+	return FALSE;
+}
+
+#endif /* __GLIBC__ */
+
+void
+alloc_counter_start (void)
+{
+	current.allocations = 0;
+	current.bytes = 0;
+	counting = TRUE;
+}
+
+void
+alloc_counter_stop (AllocCount *count)
+{
+	counting = FALSE;
+	*count = current;
+}
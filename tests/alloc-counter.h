@@ -0,0 +1,42 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ALLOC_COUNTER_H_
+#define _ALLOC_COUNTER_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+	gsize allocations;
+	gsize bytes;
+} AllocCount;
+
+/* Counts the calls to malloc(), calloc() and realloc() made by the
+ * calling thread between start and stop, and the bytes they asked for.
+ */
+gboolean alloc_counter_is_available (void);
+void alloc_counter_start (void);
+void alloc_counter_stop (AllocCount *count);
+
+G_END_DECLS
+
+#endif /* _ALLOC_COUNTER_H_ */
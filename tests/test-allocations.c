@@ -0,0 +1,404 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Allocation ceilings for the core operations over fixed corpora.  A
+ * change that adds an allocation per element, such as one more copy of
+ * each value, pushes an operation over its ceiling and fails the build.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <libsoup/soup.h>
+#include <libsoup-soap/soup-soap.h>
+
+#include "alloc-counter.h"
+
+/* Parsing and persisting a corpus are held to the counts recorded for
+ * them in BASELINE_FILE, plus this margin in percent for differences
+ * between versions of libxml2 and GLib.  Running the tests with
+ * ALLOC_BASELINE_UPDATE set records the counts measured instead, and
+ * operations without a recorded count are not run.
+ */
+#define BASELINE_MARGIN  10
+
+/* Typed setters format the value into one new string, which the C
+ * library may build in a scratch buffer first.
+ */
+#define SET_NUMBER_ALLOCATIONS  2
+#define SET_NUMBER_BYTES        256
+
+static GKeyFile *baseline;
+static gboolean updating_baseline;
+
+static const gchar *corpora[] = {
+	"wide",
+	"deep",
+	"numeric",
+	"base64"
+};
+
+
+static void
+load_corpus (const gchar *name,
+             SoupMessageHeaders **headers,
+             SoupMessageBody **body)
+{
+	gchar *filename, *path, *data;
+	gsize length;
+	GError *error = NULL;
+
+	filename = g_strconcat (name, ".xml", NULL);
+	path = g_build_filename (CORPUS_DIR, filename, NULL);
+	g_file_get_contents (path, &data, &length, &error);
+	g_assert_no_error (error);
+	g_free (path);
+	g_free (filename);
+
+	*headers = soup_message_headers_new (SOUP_MESSAGE_HEADERS_REQUEST);
+	soup_message_headers_set_content_type (*headers, "text/xml", NULL);
+
+	*body = soup_message_body_new ();
+	soup_message_body_append (*body, SOUP_MEMORY_TAKE, data, length);
+}
+
+/* The first message parsed and persisted sets up types, quarks and
+ * libxml2 for the process, which is not a cost of any one message.
+ */
+static SoupSoapMessage *
+new_message (const gchar *name)
+{
+	SoupMessageHeaders *headers;
+	SoupMessageBody *body;
+	SoupSoapMessage *msg;
+
+	load_corpus (name, &headers, &body);
+	msg = soup_soap_message_new (headers, body);
+	g_assert (soup_soap_message_get_parse_error (msg) == NULL);
+
+	soup_message_headers_free (headers);
+	soup_message_body_free (body);
+
+	return msg;
+}
+
+static void
+assert_within (const gchar *operation,
+               const AllocCount *count,
+               gsize max_allocations,
+               gsize max_bytes)
+{
+	if (g_test_verbose ())
+		g_print ("%s: %" G_GSIZE_FORMAT " allocations (at most %" G_GSIZE_FORMAT "), "
+		         "%" G_GSIZE_FORMAT " bytes (at most %" G_GSIZE_FORMAT ")\n",
+		         operation, count->allocations, max_allocations,
+		         count->bytes, max_bytes);
+
+	g_assert_cmpuint (count->allocations, <=, max_allocations);
+	g_assert_cmpuint (count->bytes, <=, max_bytes);
+}
+
+static void
+assert_within_baseline (const gchar *operation,
+                        const gchar *corpus,
+                        const AllocCount *count)
+{
+	gchar *group = g_strconcat (operation, "/", corpus, NULL);
+	guint64 allocations, bytes;
+
+	if (updating_baseline)
+	{
+		g_key_file_set_uint64 (baseline, group, "allocations", count->allocations);
+		g_key_file_set_uint64 (baseline, group, "bytes", count->bytes);
+		g_free (group);
+		return;
+	}
+
+	allocations = g_key_file_get_uint64 (baseline, group, "allocations", NULL);
+	bytes = g_key_file_get_uint64 (baseline, group, "bytes", NULL);
+
+	assert_within (group, count,
+	               allocations + allocations * BASELINE_MARGIN / 100,
+	               bytes + bytes * BASELINE_MARGIN / 100);
+
+	g_free (group);
+}
+
+static void
+test_parse (gconstpointer data)
+{
+	const gchar *name = data;
+	SoupMessageHeaders *headers;
+	SoupMessageBody *body;
+	SoupSoapMessage *msg;
+	AllocCount count;
+
+	g_object_unref (new_message (name));
+
+	load_corpus (name, &headers, &body);
+
+	alloc_counter_start ();
+	msg = soup_soap_message_new (headers, body);
+	alloc_counter_stop (&count);
+
+	g_assert (soup_soap_message_get_parse_error (msg) == NULL);
+	g_assert_cmpuint (soup_soap_message_get_stats (msg)->elements, >, 0);
+
+	assert_within_baseline ("parse", name, &count);
+
+	g_object_unref (msg);
+	soup_message_headers_free (headers);
+	soup_message_body_free (body);
+}
+
+static void
+test_persist (gconstpointer data)
+{
+	const gchar *name = data;
+	SoupSoapMessage *msg = new_message (name);
+	AllocCount count;
+
+	soup_soap_message_persist (msg);
+
+	alloc_counter_start ();
+	soup_soap_message_persist (msg);
+	alloc_counter_stop (&count);
+
+	assert_within_baseline ("persist", name, &count);
+
+	g_object_unref (msg);
+}
+
+/* Looking up every element of the operation by a name of its own, which
+ * is compared rather than matched by pointer, allocates nothing.
+ */
+static void
+test_lookup (gconstpointer data)
+{
+	const gchar *name = data;
+	SoupSoapMessage *msg = new_message (name);
+	SoupSoapParamGroup *params = soup_soap_message_get_params (msg);
+	GList *elements, *link;
+	GPtrArray *names;
+	AllocCount count;
+	guint i;
+
+	elements = soup_soap_param_group_get_elements (params);
+	names = g_ptr_array_new_with_free_func (g_free);
+	for (link = elements; link != NULL; link = g_list_next (link))
+		g_ptr_array_add (names, g_strdup (soup_soap_param_get_name (link->data)));
+
+	alloc_counter_start ();
+	for (i = 0; i < names->len; i++)
+	{
+		if (soup_soap_param_group_get (params, g_ptr_array_index (names, i)) == NULL)
+			break;
+	}
+	alloc_counter_stop (&count);
+
+	g_assert_cmpuint (i, ==, names->len);
+	assert_within ("lookup", &count, 0, 0);
+
+	g_ptr_array_unref (names);
+	g_list_free (elements);
+	g_object_unref (msg);
+}
+
+/* Reading a number allocates nothing; writing one allocates its text */
+static void
+test_numbers (void)
+{
+	SoupSoapMessage *msg = new_message ("numeric");
+	GList *elements, *link;
+	GArray *values;
+	AllocCount count;
+	GError *error = NULL;
+	guint i;
+
+	elements = soup_soap_param_group_get_elements (soup_soap_message_get_params (msg));
+	values = g_array_sized_new (FALSE, FALSE, sizeof (gdouble),
+	                            g_list_length (elements));
+
+	alloc_counter_start ();
+	for (link = elements; link != NULL && error == NULL; link = g_list_next (link))
+	{
+		gdouble value;
+
+		if (g_str_has_prefix (soup_soap_param_get_name (link->data), "int"))
+			value = soup_soap_param_get_integer (link->data, &error);
+		else
+			value = soup_soap_param_get_double (link->data, &error);
+
+		g_array_append_val (values, value);
+	}
+	alloc_counter_stop (&count);
+
+	g_assert_no_error (error);
+	assert_within ("get number", &count, 0, 0);
+
+	alloc_counter_start ();
+	for (link = elements, i = 0; link != NULL; link = g_list_next (link), i++)
+	{
+		gdouble value = g_array_index (values, gdouble, i);
+
+		if (g_str_has_prefix (soup_soap_param_get_name (link->data), "int"))
+			soup_soap_param_set_integer (link->data, (gint) value);
+		else
+			soup_soap_param_set_double (link->data, value);
+	}
+	alloc_counter_stop (&count);
+
+	assert_within ("set number", &count,
+	               SET_NUMBER_ALLOCATIONS * values->len,
+	               SET_NUMBER_BYTES * values->len);
+
+	g_array_unref (values);
+	g_list_free (elements);
+	g_object_unref (msg);
+}
+
+/* Decoding and encoding base64 take one buffer each, no larger than the
+ * encoded value and its terminator.
+ */
+static void
+test_base64 (void)
+{
+	SoupSoapMessage *msg = new_message ("base64");
+	GList *elements, *link;
+	GPtrArray *decoded;
+	GArray *lengths;
+	AllocCount count;
+	GError *error = NULL;
+	gsize encoded_bytes = 0;
+	guint i;
+
+	elements = soup_soap_param_group_get_elements (soup_soap_message_get_params (msg));
+	decoded = g_ptr_array_new_with_free_func (g_free);
+	lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+	for (link = elements; link != NULL; link = g_list_next (link))
+		encoded_bytes += strlen (soup_soap_param_get_value (link->data)) + 1;
+
+	/* Room for both results, made before counting */
+	g_ptr_array_set_size (decoded, g_list_length (elements));
+	g_ptr_array_set_size (decoded, 0);
+	g_array_set_size (lengths, g_list_length (elements));
+	g_array_set_size (lengths, 0);
+
+	alloc_counter_start ();
+	for (link = elements; link != NULL && error == NULL; link = g_list_next (link))
+	{
+		gsize length = 0;
+
+		g_ptr_array_add (decoded,
+		                 soup_soap_param_get_base64_binary (link->data, &length, &error));
+		g_array_append_val (lengths, length);
+	}
+	alloc_counter_stop (&count);
+
+	g_assert_no_error (error);
+	assert_within ("get base64", &count, decoded->len, encoded_bytes);
+
+	alloc_counter_start ();
+	for (link = elements, i = 0; link != NULL; link = g_list_next (link), i++)
+		soup_soap_param_set_base64_binary (link->data,
+		                                   g_ptr_array_index (decoded, i),
+		                                   g_array_index (lengths, gsize, i));
+	alloc_counter_stop (&count);
+
+	/* Padding can make the encoding a few bytes longer than the input */
+	assert_within ("set base64", &count, decoded->len,
+	               encoded_bytes + 8 * decoded->len);
+
+	g_array_unref (lengths);
+	g_ptr_array_unref (decoded);
+	g_list_free (elements);
+	g_object_unref (msg);
+}
+
+/* Operations without a recorded count are only run to record one */
+static void
+add_baseline_test (const gchar *operation,
+                   const gchar *corpus,
+                   GTestDataFunc func)
+{
+	gchar *group = g_strconcat (operation, "/", corpus, NULL);
+	gchar *path = g_strconcat ("/allocations/", group, NULL);
+
+	if (updating_baseline || g_key_file_has_group (baseline, group))
+		g_test_add_data_func (path, corpus, func);
+	else
+		g_printerr ("%s: no count in the baseline, not run\n", path);
+
+	g_free (path);
+	g_free (group);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	GError *error = NULL;
+	gchar *data;
+	gsize length;
+	gint result;
+	guint i;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* Tell automake the test was skipped */
+	if (!alloc_counter_is_available ())
+		return 77;
+
+	updating_baseline = g_getenv ("ALLOC_BASELINE_UPDATE") != NULL;
+	baseline = g_key_file_new ();
+	g_key_file_load_from_file (baseline, BASELINE_FILE,
+	                           G_KEY_FILE_KEEP_COMMENTS, &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < G_N_ELEMENTS (corpora); i++)
+	{
+		gchar *path;
+
+		add_baseline_test ("parse", corpora[i], test_parse);
+		add_baseline_test ("persist", corpora[i], test_persist);
+
+		path = g_strdup_printf ("/allocations/lookup/%s", corpora[i]);
+		g_test_add_data_func (path, corpora[i], test_lookup);
+		g_free (path);
+	}
+
+	g_test_add_func ("/allocations/numbers", test_numbers);
+	g_test_add_func ("/allocations/base64", test_base64);
+
+	result = g_test_run ();
+
+	if (updating_baseline && result == 0)
+	{
+		data = g_key_file_to_data (baseline, &length, NULL);
+		g_file_set_contents (BASELINE_FILE, data, length, &error);
+		g_assert_no_error (error);
+		g_free (data);
+	}
+
+	g_key_file_free (baseline);
+
+	return result;
+}
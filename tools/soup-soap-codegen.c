@@ -0,0 +1,1560 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * LibSoup-SOAP - SOAP Support for LibSoup
+ * Copyright (C) 2011  Arnel A. Borja <kyoushuu@yahoo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Reads a document/literal WSDL 1.1 description and writes a C header and
+ * source pair with one struct per XSD complex type, plus straight-line
+ * parse and serialize functions per operation.  The generated code reads
+ * the envelope with an xmlTextReader and writes it into a GString, so no
+ * SoupSoapParamGroup tree is ever built.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#define XSD_NAMESPACE "http://www.w3.org/2001/XMLSchema"
+#define WSDL_NAMESPACE "http://schemas.xmlsoap.org/wsdl/"
+#define WSDL_SOAP_NAMESPACE "http://schemas.xmlsoap.org/wsdl/soap/"
+
+typedef enum
+{
+	FIELD_STRING,
+	FIELD_INT,
+	FIELD_LONG,
+	FIELD_BOOLEAN,
+	FIELD_DOUBLE,
+	FIELD_BASE64,
+	FIELD_COMPLEX
+} FieldKind;
+
+typedef struct _CodegenType CodegenType;
+
+typedef struct
+{
+	gchar *name;
+	gchar *c_name;
+	FieldKind kind;
+	gchar *type_name;
+	CodegenType *type;
+	gboolean repeated;
+} CodegenField;
+
+struct _CodegenType
+{
+	gchar *name;
+	gchar *struct_name;
+	gchar *func_name;
+	GPtrArray *fields;
+};
+
+typedef struct
+{
+	gchar *name;
+	gchar *type_name;
+	CodegenType *type;
+} CodegenElement;
+
+typedef struct
+{
+	gchar *name;
+	gchar *func_name;
+	gchar *input;
+	gchar *output;
+	gchar *soap_action;
+	CodegenElement *input_element;
+	CodegenElement *output_element;
+} CodegenOperation;
+
+typedef struct
+{
+	gchar *prefix;
+	gchar *type_prefix;
+	gchar *target_namespace;
+	gboolean qualified;
+
+	GHashTable *types;
+	GHashTable *simple_types;
+	GHashTable *elements;
+	GHashTable *messages;
+	GPtrArray *type_list;
+	GPtrArray *operations;
+	GHashTable *loaded_files;
+
+	GString *header;
+	GString *source;
+} CodegenContext;
+
+
+static const gchar *c_keywords[] = {
+	"auto", "break", "case", "char", "const", "continue", "default", "do",
+	"double", "else", "enum", "extern", "float", "for", "goto", "if",
+	"int", "long", "register", "return", "short", "signed", "sizeof",
+	"static", "struct", "switch", "typedef", "union", "unsigned", "void",
+	"volatile", "while", "inline", "restrict", NULL
+};
+
+static gchar *
+to_snake_case (const gchar *name)
+{
+	GString *result = g_string_new (NULL);
+	const gchar *p;
+	guint i;
+
+	for (p = name; *p; p++)
+	{
+		if (g_ascii_isupper (*p))
+		{
+			if (p != name &&
+			    (g_ascii_islower (p[-1]) ||
+			     (g_ascii_isupper (p[-1]) && g_ascii_islower (p[1]))))
+				g_string_append_c (result, '_');
+			g_string_append_c (result, g_ascii_tolower (*p));
+		}
+		else if (g_ascii_isalnum (*p))
+			g_string_append_c (result, *p);
+		else
+			g_string_append_c (result, '_');
+	}
+
+	for (i = 0; c_keywords[i]; i++)
+		if (strcmp (c_keywords[i], result->str) == 0)
+		{
+			g_string_append_c (result, '_');
+			break;
+		}
+
+	return g_string_free (result, FALSE);
+}
+
+static gchar *
+to_camel_case (const gchar *name)
+{
+	GString *result = g_string_new (NULL);
+	gboolean upper = TRUE;
+	const gchar *p;
+
+	for (p = name; *p; p++)
+	{
+		if (!g_ascii_isalnum (*p))
+		{
+			upper = TRUE;
+			continue;
+		}
+
+		g_string_append_c (result, upper ? g_ascii_toupper (*p) : *p);
+		upper = FALSE;
+	}
+
+	return g_string_free (result, FALSE);
+}
+
+static gboolean
+is_named (xmlNodePtr node,
+          const gchar *ns,
+          const gchar *name)
+{
+	return node->type == XML_ELEMENT_NODE &&
+	       node->ns != NULL &&
+	       xmlStrEqual (node->ns->href, BAD_CAST ns) &&
+	       xmlStrEqual (node->name, BAD_CAST name);
+}
+
+static gchar *
+get_prop (xmlNodePtr node,
+          const gchar *name)
+{
+	xmlChar *value = xmlGetProp (node, BAD_CAST name);
+	gchar *result = g_strdup ((gchar *) value);
+
+	xmlFree (value);
+
+	return result;
+}
+
+/* Splits a QName attribute value, returning the local part and whether
+ * the prefix resolves to the XML Schema namespace.
+ */
+static gchar *
+resolve_qname (xmlNodePtr node,
+               const gchar *qname,
+               gboolean *is_xsd)
+{
+	const gchar *colon = strchr (qname, ':');
+	gchar *prefix = colon ? g_strndup (qname, colon - qname) : NULL;
+	xmlNsPtr ns = xmlSearchNs (node->doc, node, BAD_CAST prefix);
+
+	*is_xsd = ns != NULL && xmlStrEqual (ns->href, BAD_CAST XSD_NAMESPACE);
+
+	g_free (prefix);
+
+	return g_strdup (colon ? colon + 1 : qname);
+}
+
+static FieldKind
+builtin_kind (const gchar *name)
+{
+	static const struct
+	{
+		const gchar *name;
+		FieldKind kind;
+	} builtins[] = {
+		{ "int", FIELD_INT },
+		{ "short", FIELD_INT },
+		{ "byte", FIELD_INT },
+		{ "unsignedShort", FIELD_INT },
+		{ "unsignedByte", FIELD_INT },
+		{ "integer", FIELD_LONG },
+		{ "long", FIELD_LONG },
+		{ "unsignedInt", FIELD_LONG },
+		{ "unsignedLong", FIELD_LONG },
+		{ "nonNegativeInteger", FIELD_LONG },
+		{ "positiveInteger", FIELD_LONG },
+		{ "negativeInteger", FIELD_LONG },
+		{ "nonPositiveInteger", FIELD_LONG },
+		{ "boolean", FIELD_BOOLEAN },
+		{ "double", FIELD_DOUBLE },
+		{ "float", FIELD_DOUBLE },
+		{ "base64Binary", FIELD_BASE64 }
+	};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (builtins); i++)
+		if (strcmp (builtins[i].name, name) == 0)
+			return builtins[i].kind;
+
+	/* Everything else, decimals and dates included, stays textual */
+	return FIELD_STRING;
+}
+
+static CodegenType *
+type_new (CodegenContext *ctx,
+          const gchar *name)
+{
+	CodegenType *type = g_new0 (CodegenType, 1);
+	gchar *camel = to_camel_case (name);
+	gchar *snake;
+
+	type->name = g_strdup (name);
+	type->struct_name = g_strconcat (ctx->type_prefix, camel, NULL);
+	snake = to_snake_case (camel);
+	type->func_name = g_strconcat (ctx->prefix, "_", snake, NULL);
+	type->fields = g_ptr_array_new ();
+
+	g_free (snake);
+	g_free (camel);
+
+	g_ptr_array_add (ctx->type_list, type);
+
+	return type;
+}
+
+static void parse_particles (CodegenContext *ctx, CodegenType *type, xmlNodePtr node);
+
+static CodegenType *
+parse_complex_type (CodegenContext *ctx,
+                    xmlNodePtr node,
+                    const gchar *name)
+{
+	CodegenType *type = type_new (ctx, name);
+
+	parse_particles (ctx, type, node);
+
+	return type;
+}
+
+static void
+parse_field (CodegenContext *ctx,
+             CodegenType *type,
+             xmlNodePtr node)
+{
+	CodegenField *field = g_new0 (CodegenField, 1);
+	gchar *name = get_prop (node, "name");
+	gchar *ref = get_prop (node, "ref");
+	gchar *type_attr = get_prop (node, "type");
+	gchar *max_occurs = get_prop (node, "maxOccurs");
+	gboolean is_xsd = FALSE;
+	xmlNodePtr child;
+
+	if (name == NULL && ref != NULL)
+	{
+		/* The referenced global element supplies both name and type */
+		name = resolve_qname (node, ref, &is_xsd);
+		field->kind = FIELD_COMPLEX;
+		field->type_name = g_strconcat ("element:", name, NULL);
+	}
+	else if (type_attr != NULL)
+	{
+		gchar *local = resolve_qname (node, type_attr, &is_xsd);
+
+		if (is_xsd)
+		{
+			field->kind = builtin_kind (local);
+			g_free (local);
+		}
+		else
+		{
+			field->kind = FIELD_COMPLEX;
+			field->type_name = local;
+		}
+	}
+	else
+	{
+		field->kind = FIELD_STRING;
+
+		for (child = node->children; child; child = child->next)
+		{
+			if (is_named (child, XSD_NAMESPACE, "complexType"))
+			{
+				gchar *nested = g_strconcat (type->name, "_", name, NULL);
+
+				field->kind = FIELD_COMPLEX;
+				field->type = parse_complex_type (ctx, child, nested);
+				g_free (nested);
+			}
+		}
+	}
+
+	field->name = name;
+	field->c_name = to_snake_case (name);
+	field->repeated = max_occurs != NULL &&
+	                  (strcmp (max_occurs, "unbounded") == 0 ||
+	                   atoi (max_occurs) > 1);
+
+	g_ptr_array_add (type->fields, field);
+
+	g_free (max_occurs);
+	g_free (type_attr);
+	g_free (ref);
+}
+
+static void
+parse_particles (CodegenContext *ctx,
+                 CodegenType *type,
+                 xmlNodePtr node)
+{
+	xmlNodePtr child;
+
+	for (child = node->children; child; child = child->next)
+	{
+		if (child->type != XML_ELEMENT_NODE)
+			continue;
+
+		if (is_named (child, XSD_NAMESPACE, "element"))
+			parse_field (ctx, type, child);
+		else if (is_named (child, XSD_NAMESPACE, "sequence") ||
+		         is_named (child, XSD_NAMESPACE, "all") ||
+		         is_named (child, XSD_NAMESPACE, "choice"))
+			parse_particles (ctx, type, child);
+		else if (!is_named (child, XSD_NAMESPACE, "annotation"))
+			g_printerr (_("Warning: ignoring unsupported <%s> in type '%s'\n"),
+			            (gchar *) child->name, type->name);
+	}
+}
+
+static FieldKind
+parse_simple_type (xmlNodePtr node)
+{
+	xmlNodePtr child;
+	gboolean is_xsd;
+	FieldKind kind = FIELD_STRING;
+
+	for (child = node->children; child; child = child->next)
+	{
+		if (is_named (child, XSD_NAMESPACE, "restriction"))
+		{
+			gchar *base = get_prop (child, "base");
+
+			if (base)
+			{
+				gchar *local = resolve_qname (child, base, &is_xsd);
+
+				if (is_xsd)
+					kind = builtin_kind (local);
+
+				g_free (local);
+				g_free (base);
+			}
+		}
+	}
+
+	return kind;
+}
+
+static void load_schema_file (CodegenContext *ctx, const gchar *path);
+
+static void
+load_schema (CodegenContext *ctx,
+             xmlNodePtr schema,
+             const gchar *base_path)
+{
+	xmlNodePtr child;
+	gchar *form = get_prop (schema, "elementFormDefault");
+	gchar *target = get_prop (schema, "targetNamespace");
+
+	if (g_strcmp0 (target, ctx->target_namespace) == 0 || ctx->target_namespace == NULL)
+	{
+		ctx->qualified = g_strcmp0 (form, "qualified") == 0;
+		if (ctx->target_namespace == NULL)
+			ctx->target_namespace = g_strdup (target);
+	}
+
+	for (child = schema->children; child; child = child->next)
+	{
+		gchar *name;
+
+		if (child->type != XML_ELEMENT_NODE)
+			continue;
+
+		name = get_prop (child, "name");
+
+		if (is_named (child, XSD_NAMESPACE, "complexType") && name)
+		{
+			g_hash_table_insert (ctx->types, g_strdup (name),
+			                     parse_complex_type (ctx, child, name));
+		}
+		else if (is_named (child, XSD_NAMESPACE, "simpleType") && name)
+		{
+			g_hash_table_insert (ctx->simple_types, g_strdup (name),
+			                     GUINT_TO_POINTER (parse_simple_type (child)));
+		}
+		else if (is_named (child, XSD_NAMESPACE, "element") && name)
+		{
+			CodegenElement *element = g_new0 (CodegenElement, 1);
+			gchar *type_attr = get_prop (child, "type");
+			xmlNodePtr inline_type;
+
+			element->name = g_strdup (name);
+
+			if (type_attr)
+			{
+				gboolean is_xsd;
+
+				element->type_name = resolve_qname (child, type_attr, &is_xsd);
+				g_free (type_attr);
+			}
+
+			for (inline_type = child->children; inline_type; inline_type = inline_type->next)
+				if (is_named (inline_type, XSD_NAMESPACE, "complexType"))
+					element->type = parse_complex_type (ctx, inline_type, name);
+
+			g_hash_table_insert (ctx->elements, g_strdup (name), element);
+		}
+		else if (is_named (child, XSD_NAMESPACE, "import") ||
+		         is_named (child, XSD_NAMESPACE, "include"))
+		{
+			gchar *location = get_prop (child, "schemaLocation");
+
+			if (location)
+			{
+				gchar *path = g_path_is_absolute (location) ?
+					g_strdup (location) :
+					g_build_filename (base_path, location, NULL);
+
+				load_schema_file (ctx, path);
+
+				g_free (path);
+				g_free (location);
+			}
+		}
+
+		g_free (name);
+	}
+
+	g_free (target);
+	g_free (form);
+}
+
+static void
+load_schema_file (CodegenContext *ctx,
+                  const gchar *path)
+{
+	xmlDocPtr doc;
+	xmlNodePtr root;
+	gchar *base_path;
+
+	if (g_hash_table_contains (ctx->loaded_files, path))
+		return;
+	g_hash_table_add (ctx->loaded_files, g_strdup (path));
+
+	doc = xmlParseFile (path);
+	if (doc == NULL)
+	{
+		g_printerr (_("Warning: cannot load schema '%s'\n"), path);
+		return;
+	}
+
+	root = xmlDocGetRootElement (doc);
+	base_path = g_path_get_dirname (path);
+
+	if (root && is_named (root, XSD_NAMESPACE, "schema"))
+		load_schema (ctx, root, base_path);
+
+	g_free (base_path);
+	xmlFreeDoc (doc);
+}
+
+static gboolean
+load_wsdl (CodegenContext *ctx,
+           const gchar *path)
+{
+	xmlDocPtr doc;
+	xmlNodePtr root, child, node;
+	gchar *base_path;
+	GHashTable *actions;
+	guint i;
+
+	doc = xmlParseFile (path);
+	if (doc == NULL)
+		return FALSE;
+
+	root = xmlDocGetRootElement (doc);
+	if (root == NULL || !is_named (root, WSDL_NAMESPACE, "definitions"))
+	{
+		xmlFreeDoc (doc);
+		return FALSE;
+	}
+
+	g_hash_table_add (ctx->loaded_files, g_strdup (path));
+	base_path = g_path_get_dirname (path);
+	actions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	for (child = root->children; child; child = child->next)
+	{
+		if (is_named (child, WSDL_NAMESPACE, "types"))
+		{
+			for (node = child->children; node; node = node->next)
+				if (is_named (node, XSD_NAMESPACE, "schema"))
+					load_schema (ctx, node, base_path);
+		}
+		else if (is_named (child, WSDL_NAMESPACE, "message"))
+		{
+			gchar *name = get_prop (child, "name");
+
+			for (node = child->children; node; node = node->next)
+			{
+				gchar *element;
+				gboolean is_xsd;
+
+				if (!is_named (node, WSDL_NAMESPACE, "part"))
+					continue;
+
+				element = get_prop (node, "element");
+				if (element == NULL)
+				{
+					g_printerr (_("Warning: message '%s' is not document/literal\n"), name);
+					break;
+				}
+
+				g_hash_table_insert (ctx->messages, g_strdup (name),
+				                     resolve_qname (node, element, &is_xsd));
+				g_free (element);
+				break;
+			}
+
+			g_free (name);
+		}
+		else if (is_named (child, WSDL_NAMESPACE, "portType"))
+		{
+			for (node = child->children; node; node = node->next)
+			{
+				CodegenOperation *operation;
+				xmlNodePtr io;
+				gchar *snake;
+
+				if (!is_named (node, WSDL_NAMESPACE, "operation"))
+					continue;
+
+				operation = g_new0 (CodegenOperation, 1);
+				operation->name = get_prop (node, "name");
+				snake = to_snake_case (operation->name);
+				operation->func_name = g_strconcat (ctx->prefix, "_", snake, NULL);
+				g_free (snake);
+
+				for (io = node->children; io; io = io->next)
+				{
+					gchar *message = get_prop (io, "message");
+					gboolean is_xsd;
+
+					if (message == NULL)
+						continue;
+
+					if (is_named (io, WSDL_NAMESPACE, "input"))
+						operation->input = resolve_qname (io, message, &is_xsd);
+					else if (is_named (io, WSDL_NAMESPACE, "output"))
+						operation->output = resolve_qname (io, message, &is_xsd);
+
+					g_free (message);
+				}
+
+				g_ptr_array_add (ctx->operations, operation);
+			}
+		}
+		else if (is_named (child, WSDL_NAMESPACE, "binding"))
+		{
+			for (node = child->children; node; node = node->next)
+			{
+				xmlNodePtr soap_op;
+
+				if (!is_named (node, WSDL_NAMESPACE, "operation"))
+					continue;
+
+				for (soap_op = node->children; soap_op; soap_op = soap_op->next)
+					if (is_named (soap_op, WSDL_SOAP_NAMESPACE, "operation"))
+						g_hash_table_insert (actions,
+						                     get_prop (node, "name"),
+						                     get_prop (soap_op, "soapAction"));
+			}
+		}
+	}
+
+	for (i = 0; i < ctx->operations->len; i++)
+	{
+		CodegenOperation *operation = g_ptr_array_index (ctx->operations, i);
+
+		operation->soap_action = g_strdup (g_hash_table_lookup (actions, operation->name));
+	}
+
+	g_hash_table_unref (actions);
+	g_free (base_path);
+	xmlFreeDoc (doc);
+
+	return TRUE;
+}
+
+static CodegenType *
+resolve_element_type (CodegenContext *ctx,
+                      CodegenElement *element)
+{
+	if (element->type == NULL && element->type_name)
+		element->type = g_hash_table_lookup (ctx->types, element->type_name);
+
+	return element->type;
+}
+
+static void
+resolve (CodegenContext *ctx)
+{
+	guint i, j;
+
+	for (i = 0; i < ctx->type_list->len; i++)
+	{
+		CodegenType *type = g_ptr_array_index (ctx->type_list, i);
+
+		for (j = 0; j < type->fields->len; j++)
+		{
+			CodegenField *field = g_ptr_array_index (type->fields, j);
+			gpointer simple_kind;
+
+			if (field->kind != FIELD_COMPLEX || field->type)
+				continue;
+
+			if (g_str_has_prefix (field->type_name, "element:"))
+			{
+				CodegenElement *element =
+					g_hash_table_lookup (ctx->elements,
+					                     field->type_name + strlen ("element:"));
+
+				if (element)
+					field->type = resolve_element_type (ctx, element);
+			}
+			else if (g_hash_table_lookup_extended (ctx->simple_types,
+			                                       field->type_name,
+			                                       NULL, &simple_kind))
+				field->kind = GPOINTER_TO_UINT (simple_kind);
+			else
+				field->type = g_hash_table_lookup (ctx->types, field->type_name);
+
+			if (field->kind == FIELD_COMPLEX && field->type == NULL)
+			{
+				g_printerr (_("Warning: unknown type '%s', using a string\n"),
+				            field->type_name);
+				field->kind = FIELD_STRING;
+			}
+		}
+	}
+
+	for (i = 0; i < ctx->operations->len; i++)
+	{
+		CodegenOperation *operation = g_ptr_array_index (ctx->operations, i);
+		const gchar *element_name;
+
+		element_name = operation->input ?
+			g_hash_table_lookup (ctx->messages, operation->input) : NULL;
+		if (element_name)
+			operation->input_element = g_hash_table_lookup (ctx->elements, element_name);
+
+		element_name = operation->output ?
+			g_hash_table_lookup (ctx->messages, operation->output) : NULL;
+		if (element_name)
+			operation->output_element = g_hash_table_lookup (ctx->elements, element_name);
+
+		if (operation->input_element)
+			resolve_element_type (ctx, operation->input_element);
+		if (operation->output_element)
+			resolve_element_type (ctx, operation->output_element);
+	}
+}
+
+
+static const gchar *
+field_c_type (CodegenField *field)
+{
+	if (field->repeated)
+	{
+		switch (field->kind)
+		{
+			case FIELD_STRING:
+			case FIELD_BASE64:
+			case FIELD_COMPLEX:
+				return "GPtrArray *";
+			default:
+				return "GArray *";
+		}
+	}
+
+	switch (field->kind)
+	{
+		case FIELD_STRING:
+			return "gchar *";
+		case FIELD_INT:
+			return "gint ";
+		case FIELD_LONG:
+			return "gint64 ";
+		case FIELD_BOOLEAN:
+			return "gboolean ";
+		case FIELD_DOUBLE:
+			return "gdouble ";
+		case FIELD_BASE64:
+			return "GBytes *";
+		default:
+			return NULL;
+	}
+}
+
+static const gchar *
+field_element_c_type (CodegenField *field)
+{
+	switch (field->kind)
+	{
+		case FIELD_INT:
+			return "gint";
+		case FIELD_LONG:
+			return "gint64";
+		case FIELD_BOOLEAN:
+			return "gboolean";
+		default:
+			return "gdouble";
+	}
+}
+
+static const gchar *
+field_free_func (CodegenField *field)
+{
+	switch (field->kind)
+	{
+		case FIELD_STRING:
+			return "g_free";
+		case FIELD_BASE64:
+			return "(GDestroyNotify) g_bytes_unref";
+		default:
+			return NULL;
+	}
+}
+
+static void
+emit_type_declarations (CodegenContext *ctx,
+                        CodegenType *type)
+{
+	guint i;
+
+	g_string_append_printf (ctx->header, "struct _%s\n{\n", type->struct_name);
+
+	for (i = 0; i < type->fields->len; i++)
+	{
+		CodegenField *field = g_ptr_array_index (type->fields, i);
+
+		if (field->kind == FIELD_COMPLEX && !field->repeated)
+			g_string_append_printf (ctx->header, "\t%s *%s;\n",
+			                        field->type->struct_name, field->c_name);
+		else if (field->kind == FIELD_COMPLEX)
+			g_string_append_printf (ctx->header, "\tGPtrArray *%s; /* %s */\n",
+			                        field->c_name, field->type->struct_name);
+		else
+			g_string_append_printf (ctx->header, "\t%s%s;\n",
+			                        field_c_type (field), field->c_name);
+	}
+
+	if (type->fields->len == 0)
+		g_string_append (ctx->header, "\tgpointer reserved;\n");
+
+	g_string_append (ctx->header, "};\n\n");
+}
+
+static void
+emit_type_functions (CodegenContext *ctx,
+                     CodegenType *type)
+{
+	GString *out = ctx->source;
+	guint i;
+
+	/* new */
+	g_string_append_printf (out,
+	                        "%s *\n%s_new (void)\n{\n"
+	                        "\t%s *value = g_slice_new0 (%s);\n\n",
+	                        type->struct_name, type->func_name,
+	                        type->struct_name, type->struct_name);
+
+	for (i = 0; i < type->fields->len; i++)
+	{
+		CodegenField *field = g_ptr_array_index (type->fields, i);
+
+		if (!field->repeated)
+			continue;
+
+		if (field->kind == FIELD_COMPLEX)
+			g_string_append_printf (out,
+			                        "\tvalue->%s = g_ptr_array_new_with_free_func ((GDestroyNotify) %s_free);\n",
+			                        field->c_name, field->type->func_name);
+		else if (field_free_func (field))
+			g_string_append_printf (out,
+			                        "\tvalue->%s = g_ptr_array_new_with_free_func (%s);\n",
+			                        field->c_name, field_free_func (field));
+		else
+			g_string_append_printf (out,
+			                        "\tvalue->%s = g_array_new (FALSE, FALSE, sizeof (%s));\n",
+			                        field->c_name, field_element_c_type (field));
+	}
+
+	g_string_append (out, "\n\treturn value;\n}\n\n");
+
+	/* free */
+	g_string_append_printf (out,
+	                        "void\n%s_free (%s *value)\n{\n"
+	                        "\tif (value == NULL)\n\t\treturn;\n\n",
+	                        type->func_name, type->struct_name);
+
+	for (i = 0; i < type->fields->len; i++)
+	{
+		CodegenField *field = g_ptr_array_index (type->fields, i);
+
+		if (field->repeated && field->kind == FIELD_COMPLEX)
+			g_string_append_printf (out, "\tg_ptr_array_unref (value->%s);\n",
+			                        field->c_name);
+		else if (field->repeated && field_free_func (field))
+			g_string_append_printf (out, "\tg_ptr_array_unref (value->%s);\n",
+			                        field->c_name);
+		else if (field->repeated)
+			g_string_append_printf (out, "\tg_array_unref (value->%s);\n",
+			                        field->c_name);
+		else if (field->kind == FIELD_COMPLEX)
+			g_string_append_printf (out, "\t%s_free (value->%s);\n",
+			                        field->type->func_name, field->c_name);
+		else if (field->kind == FIELD_STRING)
+			g_string_append_printf (out, "\tg_free (value->%s);\n",
+			                        field->c_name);
+		else if (field->kind == FIELD_BASE64)
+			g_string_append_printf (out,
+			                        "\tif (value->%s)\n\t\tg_bytes_unref (value->%s);\n",
+			                        field->c_name, field->c_name);
+	}
+
+	g_string_append_printf (out, "\n\tg_slice_free (%s, value);\n}\n\n",
+	                        type->struct_name);
+}
+
+static void
+emit_serialize_value (GString *out,
+                      CodegenField *field,
+                      const gchar *value,
+                      const gchar *indent)
+{
+	switch (field->kind)
+	{
+		case FIELD_STRING:
+			g_string_append_printf (out,
+			                        "%sif (%s)\n%s{\n"
+			                        "%s\tg_string_append (out, \"<%s>\");\n"
+			                        "%s\tappend_escaped (out, %s);\n"
+			                        "%s\tg_string_append (out, \"</%s>\");\n"
+			                        "%s}\n",
+			                        indent, value, indent,
+			                        indent, field->name,
+			                        indent, value,
+			                        indent, field->name,
+			                        indent);
+			break;
+		case FIELD_INT:
+			g_string_append_printf (out,
+			                        "%sg_string_append_printf (out, \"<%s>%%d</%s>\", %s);\n",
+			                        indent, field->name, field->name, value);
+			break;
+		case FIELD_LONG:
+			g_string_append_printf (out,
+			                        "%sg_string_append_printf (out, \"<%s>%%\" G_GINT64_FORMAT \"</%s>\", %s);\n",
+			                        indent, field->name, field->name, value);
+			break;
+		case FIELD_BOOLEAN:
+			g_string_append_printf (out,
+			                        "%sg_string_append (out, %s ? \"<%s>true</%s>\" : \"<%s>false</%s>\");\n",
+			                        indent, value,
+			                        field->name, field->name,
+			                        field->name, field->name);
+			break;
+		case FIELD_DOUBLE:
+			g_string_append_printf (out,
+			                        "%sappend_double (out, \"%s\", %s);\n",
+			                        indent, field->name, value);
+			break;
+		case FIELD_BASE64:
+			g_string_append_printf (out,
+			                        "%sif (%s)\n%s\tappend_base64 (out, \"%s\", %s);\n",
+			                        indent, value, indent, field->name, value);
+			break;
+		case FIELD_COMPLEX:
+			g_string_append_printf (out,
+			                        "%sif (%s)\n%s\t%s_serialize (%s, \"%s\", \"\", out);\n",
+			                        indent, value, indent,
+			                        field->type->func_name, value, field->name);
+			break;
+	}
+}
+
+static void
+emit_serialize (CodegenContext *ctx,
+                CodegenType *type)
+{
+	GString *out = ctx->source;
+	gboolean has_repeated = FALSE;
+	guint i;
+
+	for (i = 0; i < type->fields->len; i++)
+		if (((CodegenField *) g_ptr_array_index (type->fields, i))->repeated)
+			has_repeated = TRUE;
+
+	g_string_append_printf (out,
+	                        "static void\n%s_serialize (const %s *value,\n"
+	                        "\tconst gchar *element,\n"
+	                        "\tconst gchar *attributes,\n"
+	                        "\tGString *out)\n{\n"
+	                        "%s"
+	                        "\tg_string_append_printf (out, \"<%%s%%s>\", element, attributes);\n\n",
+	                        type->func_name, type->struct_name,
+	                        has_repeated ? "\tguint i;\n\n" : "");
+
+	for (i = 0; i < type->fields->len; i++)
+	{
+		CodegenField *field = g_ptr_array_index (type->fields, i);
+		gchar *value;
+
+		if (!field->repeated)
+		{
+			value = g_strconcat ("value->", field->c_name, NULL);
+			emit_serialize_value (out, field, value, "\t");
+			g_free (value);
+			continue;
+		}
+
+		g_string_append_printf (out, "\tfor (i = 0; i < value->%s->len; i++)\n\t{\n",
+		                        field->c_name);
+
+		if (field->kind == FIELD_COMPLEX)
+			value = g_strdup_printf ("((const %s *) g_ptr_array_index (value->%s, i))",
+			                         field->type->struct_name, field->c_name);
+		else if (field_free_func (field))
+			value = g_strdup_printf ("g_ptr_array_index (value->%s, i)",
+			                         field->c_name);
+		else
+			value = g_strdup_printf ("g_array_index (value->%s, %s, i)",
+			                         field->c_name, field_element_c_type (field));
+
+		emit_serialize_value (out, field, value, "\t\t");
+		g_string_append (out, "\t}\n");
+
+		g_free (value);
+	}
+
+	g_string_append (out, "\n\tg_string_append_printf (out, \"</%s>\", element);\n}\n\n");
+}
+
+static void
+emit_parse_value (GString *out,
+                  CodegenField *field)
+{
+	const gchar *target;
+	gchar *lvalue;
+
+	if (field->kind == FIELD_COMPLEX)
+	{
+		if (field->repeated)
+			g_string_append_printf (out,
+			                        "\t\t\t\t%s *item = %s_new ();\n\n"
+			                        "\t\t\t\tg_ptr_array_add (value->%s, item);\n"
+			                        "\t\t\t\tret = %s_parse (reader, item);\n",
+			                        field->type->struct_name, field->type->func_name,
+			                        field->c_name, field->type->func_name);
+		else
+			g_string_append_printf (out,
+			                        "\t\t\t\t%s_free (value->%s);\n"
+			                        "\t\t\t\tvalue->%s = %s_new ();\n"
+			                        "\t\t\t\tret = %s_parse (reader, value->%s);\n",
+			                        field->type->func_name, field->c_name,
+			                        field->c_name, field->type->func_name,
+			                        field->type->func_name, field->c_name);
+		return;
+	}
+
+	g_string_append (out,
+	                 "\t\t\t\txmlChar *text = xmlTextReaderReadString (reader);\n"
+	                 "\t\t\t\tconst gchar *string = text ? (const gchar *) text : \"\";\n");
+
+	/* Values that do not parse make the whole envelope invalid */
+	if (field->kind == FIELD_INT || field->kind == FIELD_LONG ||
+	    field->kind == FIELD_BOOLEAN || field->kind == FIELD_DOUBLE)
+		g_string_append (out, "\t\t\t\tgboolean valid;\n");
+	if (field->kind == FIELD_INT)
+		g_string_append (out, "\t\t\t\tgint64 number;\n");
+
+	if (field->repeated && field_free_func (field))
+		target = "item";
+	else if (field->repeated)
+	{
+		g_string_append_printf (out, "\t\t\t\t%s item;\n", field_element_c_type (field));
+		target = "item";
+	}
+	else
+		target = NULL;
+
+	if (target)
+	{
+		if (field->kind == FIELD_STRING)
+			g_string_append (out, "\t\t\t\tgchar *item;\n");
+		else if (field->kind == FIELD_BASE64)
+			g_string_append (out, "\t\t\t\tGBytes *item;\n");
+		lvalue = g_strdup (target);
+	}
+	else
+		lvalue = g_strconcat ("value->", field->c_name, NULL);
+
+	g_string_append (out, "\n");
+
+	switch (field->kind)
+	{
+		case FIELD_STRING:
+			if (!field->repeated)
+				g_string_append_printf (out, "\t\t\t\tg_free (%s);\n", lvalue);
+			g_string_append_printf (out, "\t\t\t\t%s = g_strdup (string);\n", lvalue);
+			break;
+		case FIELD_INT:
+			g_string_append_printf (out,
+			                        "\t\t\t\tvalid = parse_integer (string, G_MININT, G_MAXINT, &number);\n"
+			                        "\t\t\t\t%s = (gint) number;\n",
+			                        lvalue);
+			break;
+		case FIELD_LONG:
+			g_string_append_printf (out,
+			                        "\t\t\t\tvalid = parse_integer (string, G_MININT64, G_MAXINT64, &%s);\n",
+			                        lvalue);
+			break;
+		case FIELD_BOOLEAN:
+			g_string_append_printf (out,
+			                        "\t\t\t\tvalid = parse_boolean (string, &%s);\n",
+			                        lvalue);
+			break;
+		case FIELD_DOUBLE:
+			g_string_append_printf (out,
+			                        "\t\t\t\tvalid = parse_double (string, &%s);\n",
+			                        lvalue);
+			break;
+		case FIELD_BASE64:
+			if (!field->repeated)
+				g_string_append_printf (out,
+				                        "\t\t\t\tif (%s)\n\t\t\t\t\tg_bytes_unref (%s);\n",
+				                        lvalue, lvalue);
+			g_string_append_printf (out,
+			                        "\t\t\t\t%s = decode_base64 (string);\n",
+			                        lvalue);
+			break;
+		default:
+			break;
+	}
+
+	if (field->repeated && field_free_func (field))
+		g_string_append_printf (out, "\t\t\t\tg_ptr_array_add (value->%s, item);\n",
+		                        field->c_name);
+	else if (field->repeated)
+		g_string_append_printf (out, "\t\t\t\tg_array_append_val (value->%s, item);\n",
+		                        field->c_name);
+
+	g_string_append (out, "\n\t\t\t\txmlFree (text);\n");
+	if (field->kind == FIELD_INT || field->kind == FIELD_LONG ||
+	    field->kind == FIELD_BOOLEAN || field->kind == FIELD_DOUBLE)
+		g_string_append (out, "\t\t\t\tret = valid ? xmlTextReaderNext (reader) : -1;\n");
+	else
+		g_string_append (out, "\t\t\t\tret = xmlTextReaderNext (reader);\n");
+
+	g_free (lvalue);
+}
+
+static void
+emit_parse (CodegenContext *ctx,
+            CodegenType *type)
+{
+	GString *out = ctx->source;
+	guint i;
+
+	/* The reader sits on the start tag when called, and is left on the
+	 * node following the end tag on success.
+	 */
+	g_string_append_printf (out,
+	                        "static int\n%s_parse (xmlTextReaderPtr reader,\n"
+	                        "\t%s *value)\n{\n"
+	                        "\tint depth = xmlTextReaderDepth (reader);\n"
+	                        "\tint ret;\n\n"
+	                        "\tif (xmlTextReaderIsEmptyElement (reader))\n"
+	                        "\t\treturn xmlTextReaderRead (reader) < 0 ? -1 : 1;\n\n"
+	                        "\tret = xmlTextReaderRead (reader);\n\n"
+	                        "\twhile (ret == 1)\n\t{\n"
+	                        "\t\tint node_type = xmlTextReaderNodeType (reader);\n"
+	                        "\t\tconst xmlChar *name;\n\n"
+	                        "\t\tif (node_type == XML_READER_TYPE_END_ELEMENT &&\n"
+	                        "\t\t    xmlTextReaderDepth (reader) == depth)\n"
+	                        "\t\t\treturn xmlTextReaderRead (reader) < 0 ? -1 : 1;\n\n"
+	                        "\t\tif (node_type != XML_READER_TYPE_ELEMENT)\n\t\t{\n"
+	                        "\t\t\tret = xmlTextReaderRead (reader);\n"
+	                        "\t\t\tcontinue;\n\t\t}\n\n"
+	                        "\t\tname = xmlTextReaderConstLocalName (reader);\n\n",
+	                        type->func_name, type->struct_name);
+
+	for (i = 0; i < type->fields->len; i++)
+	{
+		CodegenField *field = g_ptr_array_index (type->fields, i);
+
+		g_string_append_printf (out,
+		                        "\t\t%sif (xmlStrEqual (name, BAD_CAST \"%s\"))\n"
+		                        "\t\t{\n\t\t\t{\n",
+		                        i > 0 ? "else " : "", field->name);
+		emit_parse_value (out, field);
+		g_string_append (out, "\t\t\t}\n\t\t}\n");
+	}
+
+	g_string_append_printf (out,
+	                        "\t\t%s\n"
+	                        "\t\t\tret = xmlTextReaderNext (reader);\n"
+	                        "\t}\n\n"
+	                        "\treturn -1;\n}\n\n",
+	                        type->fields->len > 0 ? "else" : "");
+}
+
+static void
+emit_operation (CodegenContext *ctx,
+                CodegenOperation *operation)
+{
+	CodegenType *input = operation->input_element->type;
+	CodegenType *output = operation->output_element->type;
+	const gchar *names[] = { "request", "response" };
+	CodegenType *types[] = { input, output };
+	CodegenElement *elements[] = { operation->input_element, operation->output_element };
+	guint i;
+
+	for (i = 0; i < 2; i++)
+	{
+		g_string_append_printf (ctx->header,
+		                        "void %s_serialize_%s (const %s *%s, SoupMessageBody *body);\n"
+		                        "gboolean %s_parse_%s (SoupMessageBody *body, %s **%s, GError **error);\n",
+		                        operation->func_name, names[i], types[i]->struct_name, names[i],
+		                        operation->func_name, names[i], types[i]->struct_name, names[i]);
+
+		g_string_append_printf (ctx->source,
+		                        "void\n%s_serialize_%s (const %s *%s,\n"
+		                        "\tSoupMessageBody *body)\n{\n"
+		                        "\tGString *out = g_string_sized_new (1024);\n\n"
+		                        "\tg_string_append (out, ENVELOPE_START);\n"
+		                        "\t%s_serialize (%s, ELEMENT_NAME (\"%s\"), ELEMENT_ATTRIBUTES, out);\n"
+		                        "\tg_string_append (out, ENVELOPE_END);\n\n"
+		                        "\tsoup_message_body_truncate (body);\n"
+		                        "\tsoup_message_body_append (body, SOUP_MEMORY_TAKE, out->str, out->len);\n"
+		                        "\tsoup_message_body_complete (body);\n"
+		                        "\tg_string_free (out, FALSE);\n}\n\n",
+		                        operation->func_name, names[i], types[i]->struct_name, names[i],
+		                        types[i]->func_name, names[i], elements[i]->name);
+
+		g_string_append_printf (ctx->source,
+		                        "gboolean\n%s_parse_%s (SoupMessageBody *body,\n"
+		                        "\t%s **%s,\n"
+		                        "\tGError **error)\n{\n"
+		                        "\tSoupBuffer *buffer = soup_message_body_flatten (body);\n"
+		                        "\txmlTextReaderPtr reader;\n"
+		                        "\t%s *value = NULL;\n"
+		                        "\tint ret;\n\n"
+		                        "\treader = xmlReaderForMemory (buffer->data, buffer->length, NULL, NULL, 0);\n"
+		                        "\tret = reader ? reader_enter_body (reader) : -1;\n\n"
+		                        "\tif (ret == 1 && xmlStrEqual (xmlTextReaderConstLocalName (reader), BAD_CAST \"%s\"))\n"
+		                        "\t{\n"
+		                        "\t\tvalue = %s_new ();\n"
+		                        "\t\tret = %s_parse (reader, value);\n"
+		                        "\t}\n"
+		                        "\telse\n"
+		                        "\t\tret = -1;\n\n"
+		                        "\tif (reader)\n\t\txmlFreeTextReader (reader);\n"
+		                        "\tsoup_buffer_free (buffer);\n\n"
+		                        "\tif (ret < 0)\n\t{\n"
+		                        "\t\t%s_free (value);\n"
+		                        "\t\tg_set_error (error, SOUP_SOAP_MESSAGE_ERROR,\n"
+		                        "\t\t             SOUP_SOAP_MESSAGE_ERROR_INVALID_ENVELOPE,\n"
+		                        "\t\t             \"Invalid %s envelope\");\n"
+		                        "\t\treturn FALSE;\n\t}\n\n"
+		                        "\t*%s = value;\n\n"
+		                        "\treturn TRUE;\n}\n\n",
+		                        operation->func_name, names[i],
+		                        types[i]->struct_name, names[i],
+		                        types[i]->struct_name,
+		                        elements[i]->name,
+		                        types[i]->func_name,
+		                        types[i]->func_name,
+		                        types[i]->func_name,
+		                        operation->name,
+		                        names[i]);
+	}
+
+	g_string_append_printf (ctx->header,
+	                        "gboolean %s_call (SoupSession *session, const gchar *uri, const %s *request, %s **response, GError **error);\n\n",
+	                        operation->func_name, input->struct_name, output->struct_name);
+
+	g_string_append_printf (ctx->source,
+	                        "gboolean\n%s_call (SoupSession *session,\n"
+	                        "\tconst gchar *uri,\n"
+	                        "\tconst %s *request,\n"
+	                        "\t%s **response,\n"
+	                        "\tGError **error)\n{\n"
+	                        "\tSoupMessage *msg = soup_message_new (SOUP_METHOD_POST, uri);\n"
+	                        "\tgboolean result;\n\n"
+	                        "\t%s_serialize_request (request, msg->request_body);\n"
+	                        "\tsoup_message_headers_set_content_type (msg->request_headers, \"text/xml\", NULL);\n"
+	                        "\tsoup_message_headers_replace (msg->request_headers, \"SOAPAction\", \"\\\"%s\\\"\");\n\n"
+	                        "\tsoup_session_send_message (session, msg);\n\n"
+	                        "\tif (!check_response (msg, error))\n\t{\n"
+	                        "\t\tg_object_unref (msg);\n"
+	                        "\t\treturn FALSE;\n\t}\n\n"
+	                        "\tresult = %s_parse_response (msg->response_body, response, error);\n"
+	                        "\tg_object_unref (msg);\n\n"
+	                        "\treturn result;\n}\n\n",
+	                        operation->func_name,
+	                        input->struct_name, output->struct_name,
+	                        operation->func_name,
+	                        operation->soap_action ? operation->soap_action : "",
+	                        operation->func_name);
+}
+
+static void
+emit (CodegenContext *ctx,
+      const gchar *basename)
+{
+	gchar *guard, *include;
+	guint i;
+
+	guard = g_ascii_strup (ctx->prefix, -1);
+	include = g_path_get_basename (basename);
+
+	g_string_append_printf (ctx->header,
+	                        "/* Generated by soup-soap-codegen, do not edit. */\n\n"
+	                        "#ifndef _%s_H_\n#define _%s_H_\n\n"
+	                        "#include <libsoup/soup.h>\n\n"
+	                        "G_BEGIN_DECLS\n\n",
+	                        guard, guard);
+
+	g_string_append_printf (ctx->source,
+	                        "/* Generated by soup-soap-codegen, do not edit. */\n\n"
+	                        "#include <errno.h>\n"
+	                        "#include <math.h>\n"
+	                        "#include <string.h>\n\n"
+	                        "#include <libsoup/soup.h>\n"
+	                        "#include <libsoup-soap/soup-soap.h>\n"
+	                        "#include <libxml/xmlreader.h>\n\n"
+	                        "#include \"%s.h\"\n\n"
+	                        "#define ENVELOPE_START \\\n"
+	                        "\t\"<?xml version=\\\"1.0\\\" encoding=\\\"UTF-8\\\"?>\\n\" \\\n"
+	                        "\t\"<SOAP-ENV:Envelope xmlns:SOAP-ENV=\\\"http://schemas.xmlsoap.org/soap/envelope/\\\">\" \\\n"
+	                        "\t\"<SOAP-ENV:Body>\"\n"
+	                        "#define ENVELOPE_END \"</SOAP-ENV:Body></SOAP-ENV:Envelope>\"\n\n"
+	                        "#define SOAP_ENV_NAMESPACE \"http://schemas.xmlsoap.org/soap/envelope/\"\n\n"
+	                        "/* The whitespace XML Schema allows around numbers and booleans */\n"
+	                        "#define XSD_SPACE \" \\t\\n\\r\"\n\n",
+	                        include);
+
+	/* Qualified schemas put every element in the target namespace, which
+	 * a default namespace declaration on the operation element achieves.
+	 */
+	if (ctx->qualified)
+		g_string_append_printf (ctx->source,
+		                        "#define ELEMENT_NAME(name) name\n"
+		                        "#define ELEMENT_ATTRIBUTES \" xmlns=\\\"%s\\\"\"\n\n",
+		                        ctx->target_namespace ? ctx->target_namespace : "");
+	else
+		g_string_append_printf (ctx->source,
+		                        "#define ELEMENT_NAME(name) \"tns:\" name\n"
+		                        "#define ELEMENT_ATTRIBUTES \" xmlns:tns=\\\"%s\\\"\"\n\n",
+		                        ctx->target_namespace ? ctx->target_namespace : "");
+
+	g_string_append (ctx->source,
+	                 "static G_GNUC_UNUSED void\nappend_escaped (GString *out,\n\tconst gchar *text)\n{\n"
+	                 "\tconst gchar *p;\n\n"
+	                 "\tfor (p = text; *p; p++)\n\t{\n"
+	                 "\t\tswitch (*p)\n\t\t{\n"
+	                 "\t\t\tcase '&':\n\t\t\t\tg_string_append (out, \"&amp;\");\n\t\t\t\tbreak;\n"
+	                 "\t\t\tcase '<':\n\t\t\t\tg_string_append (out, \"&lt;\");\n\t\t\t\tbreak;\n"
+	                 "\t\t\tcase '>':\n\t\t\t\tg_string_append (out, \"&gt;\");\n\t\t\t\tbreak;\n"
+	                 "\t\t\tdefault:\n\t\t\t\tg_string_append_c (out, *p);\n\t\t\t\tbreak;\n"
+	                 "\t\t}\n\t}\n}\n\n"
+	                 "static G_GNUC_UNUSED void\nappend_double (GString *out,\n\tconst gchar *element,\n\tgdouble value)\n{\n"
+	                 "\tgchar buffer[G_ASCII_DTOSTR_BUF_SIZE];\n\n"
+	                 "\tg_string_append_printf (out, \"<%s>%s</%s>\", element,\n"
+	                 "\t                        g_ascii_dtostr (buffer, sizeof (buffer), value),\n"
+	                 "\t                        element);\n}\n\n"
+	                 "static G_GNUC_UNUSED void\nappend_base64 (GString *out,\n\tconst gchar *element,\n\tGBytes *value)\n{\n"
+	                 "\tgsize length;\n"
+	                 "\tgconstpointer data = g_bytes_get_data (value, &length);\n"
+	                 "\tgchar *encoded = g_base64_encode (data, length);\n\n"
+	                 "\tg_string_append_printf (out, \"<%s>%s</%s>\", element, encoded, element);\n"
+	                 "\tg_free (encoded);\n}\n\n"
+	                 "static G_GNUC_UNUSED GBytes *\ndecode_base64 (const gchar *text)\n{\n"
+	                 "\tgsize length;\n"
+	                 "\tguchar *data = g_base64_decode (text, &length);\n\n"
+	                 "\treturn g_bytes_new_take (data, length);\n}\n\n"
+	                 "/* Whether text, less the whitespace around it, is nothing but what\n"
+	                 " * was parsed up to end\n */\n"
+	                 "static G_GNUC_UNUSED gboolean\nparsed_whole (const gchar *text,\n\tconst gchar *end)\n{\n"
+	                 "\treturn end != text && !g_ascii_isspace (*text) &&\n"
+	                 "\t       end[strspn (end, XSD_SPACE)] == '\\0';\n}\n\n"
+	                 "static G_GNUC_UNUSED gboolean\nparse_integer (const gchar *text,\n\tgint64 min,\n\tgint64 max,\n\tgint64 *value)\n{\n"
+	                 "\tgchar *end;\n\n"
+	                 "\ttext += strspn (text, XSD_SPACE);\n"
+	                 "\terrno = 0;\n"
+	                 "\t*value = g_ascii_strtoll (text, &end, 10);\n\n"
+	                 "\treturn parsed_whole (text, end) && errno == 0 &&\n"
+	                 "\t       *value >= min && *value <= max;\n}\n\n"
+	                 "static G_GNUC_UNUSED gboolean\nparse_double (const gchar *text,\n\tgdouble *value)\n{\n"
+	                 "\tgchar *end;\n\n"
+	                 "\ttext += strspn (text, XSD_SPACE);\n"
+	                 "\terrno = 0;\n"
+	                 "\t*value = g_ascii_strtod (text, &end);\n\n"
+	                 "\t/* Values too small to represent are rounded, not refused */\n"
+	                 "\treturn parsed_whole (text, end) &&\n"
+	                 "\t       (errno != ERANGE ||\n"
+	                 "\t        (*value != HUGE_VAL && *value != -HUGE_VAL));\n}\n\n"
+	                 "static G_GNUC_UNUSED gboolean\nparse_boolean (const gchar *text,\n\tgboolean *value)\n{\n"
+	                 "\tgsize length;\n\n"
+	                 "\ttext += strspn (text, XSD_SPACE);\n"
+	                 "\tlength = strlen (text);\n"
+	                 "\twhile (length > 0 && strchr (XSD_SPACE, text[length - 1]))\n"
+	                 "\t\tlength--;\n\n"
+	                 "\tif ((length == 4 && strncmp (text, \"true\", 4) == 0) ||\n"
+	                 "\t    (length == 1 && *text == '1'))\n"
+	                 "\t\t*value = TRUE;\n"
+	                 "\telse if ((length == 5 && strncmp (text, \"false\", 5) == 0) ||\n"
+	                 "\t         (length == 1 && *text == '0'))\n"
+	                 "\t\t*value = FALSE;\n"
+	                 "\telse\n"
+	                 "\t\treturn FALSE;\n\n"
+	                 "\treturn TRUE;\n}\n\n"
+	                 "/* Moves the reader to the first element inside the SOAP Body */\n"
+	                 "static int\nreader_enter_body (xmlTextReaderPtr reader)\n{\n"
+	                 "\tgboolean in_body = FALSE;\n"
+	                 "\tint ret;\n\n"
+	                 "\twhile ((ret = xmlTextReaderRead (reader)) == 1)\n\t{\n"
+	                 "\t\tif (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)\n"
+	                 "\t\t\tcontinue;\n\n"
+	                 "\t\tif (in_body)\n\t\t\treturn 1;\n\n"
+	                 "\t\tif (xmlStrEqual (xmlTextReaderConstLocalName (reader), BAD_CAST \"Body\") &&\n"
+	                 "\t\t    xmlStrEqual (xmlTextReaderConstNamespaceUri (reader), BAD_CAST SOAP_ENV_NAMESPACE))\n"
+	                 "\t\t\tin_body = TRUE;\n\t}\n\n"
+	                 "\treturn ret == 0 ? -1 : ret;\n}\n\n"
+	                 "/* Reports faults, and any other unsuccessful status, as errors */\n"
+	                 "static G_GNUC_UNUSED gboolean\ncheck_response (SoupMessage *msg,\n\tGError **error)\n{\n"
+	                 "\tSoupSoapMessage *response;\n"
+	                 "\tSoupSoapParamGroup *params;\n"
+	                 "\tSoupSoapParam *code, *string;\n\n"
+	                 "\tif (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))\n\t\treturn TRUE;\n\n"
+	                 "\tif (msg->status_code == SOUP_STATUS_INTERNAL_SERVER_ERROR)\n\t{\n"
+	                 "\t\tresponse = soup_soap_message_new_response (msg);\n\n"
+	                 "\t\tif (soup_soap_message_is_fault (response))\n\t\t{\n"
+	                 "\t\t\tparams = soup_soap_message_get_params (response);\n"
+	                 "\t\t\tcode = soup_soap_param_group_get (params, \"faultcode\");\n"
+	                 "\t\t\tstring = soup_soap_param_group_get (params, \"faultstring\");\n\n"
+	                 "\t\t\tg_set_error (error, SOUP_SOAP_MESSAGE_ERROR,\n"
+	                 "\t\t\t             SOUP_SOAP_MESSAGE_ERROR_FAULT, \"%s: %s\",\n"
+	                 "\t\t\t             code ? soup_soap_param_get_value (code) : \"\",\n"
+	                 "\t\t\t             string ? soup_soap_param_get_value (string) : \"\");\n"
+	                 "\t\t\tg_object_unref (response);\n\n"
+	                 "\t\t\treturn FALSE;\n\t\t}\n\n"
+	                 "\t\tg_object_unref (response);\n\t}\n\n"
+	                 "\tg_set_error_literal (error, SOUP_HTTP_ERROR, msg->status_code, msg->reason_phrase);\n\n"
+	                 "\treturn FALSE;\n}\n\n");
+
+	for (i = 0; i < ctx->type_list->len; i++)
+	{
+		CodegenType *type = g_ptr_array_index (ctx->type_list, i);
+
+		g_string_append_printf (ctx->header, "typedef struct _%s %s;\n",
+		                        type->struct_name, type->struct_name);
+		g_string_append_printf (ctx->source,
+		                        "static void %s_serialize (const %s *value, const gchar *element, const gchar *attributes, GString *out);\n"
+		                        "static int %s_parse (xmlTextReaderPtr reader, %s *value);\n",
+		                        type->func_name, type->struct_name,
+		                        type->func_name, type->struct_name);
+	}
+
+	g_string_append (ctx->header, "\n");
+	g_string_append (ctx->source, "\n");
+
+	for (i = 0; i < ctx->type_list->len; i++)
+	{
+		CodegenType *type = g_ptr_array_index (ctx->type_list, i);
+
+		emit_type_declarations (ctx, type);
+		g_string_append_printf (ctx->header,
+		                        "%s *%s_new (void);\n"
+		                        "void %s_free (%s *value);\n\n",
+		                        type->struct_name, type->func_name,
+		                        type->func_name, type->struct_name);
+
+		emit_type_functions (ctx, type);
+		emit_serialize (ctx, type);
+		emit_parse (ctx, type);
+	}
+
+	for (i = 0; i < ctx->operations->len; i++)
+	{
+		CodegenOperation *operation = g_ptr_array_index (ctx->operations, i);
+
+		if (operation->input_element == NULL || operation->input_element->type == NULL ||
+		    operation->output_element == NULL || operation->output_element->type == NULL)
+		{
+			g_printerr (_("Warning: skipping operation '%s', its messages "
+			              "are not document/literal complex types\n"),
+			            operation->name);
+			continue;
+		}
+
+		emit_operation (ctx, operation);
+	}
+
+	g_string_append_printf (ctx->header, "G_END_DECLS\n\n#endif /* _%s_H_ */\n",
+	                        guard);
+
+	g_free (include);
+	g_free (guard);
+}
+
+
+int
+main (int argc,
+      char *argv[])
+{
+	gchar *prefix = NULL;
+	gchar *output = NULL;
+	gchar **inputs = NULL;
+	GOptionEntry entries[] = {
+		{ "prefix", 'p', 0, G_OPTION_ARG_STRING, &prefix,
+		  N_("Prefix of generated functions, e.g. my_service"), N_("PREFIX") },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+		  N_("Base name of the generated .h and .c files"), N_("FILE") },
+		{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &inputs,
+		  NULL, N_("WSDL") },
+		{ NULL }
+	};
+	GOptionContext *option_context;
+	GError *error = NULL;
+	CodegenContext ctx;
+	gchar *path;
+	int status = EXIT_SUCCESS;
+
+	setlocale (LC_ALL, "");
+	bindtextdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	option_context = g_option_context_new (_("- generate C bindings from a WSDL"));
+	g_option_context_add_main_entries (option_context, entries, GETTEXT_PACKAGE);
+
+	if (!g_option_context_parse (option_context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	if (inputs == NULL || inputs[0] == NULL || inputs[1] != NULL ||
+	    prefix == NULL || output == NULL)
+	{
+		gchar *help = g_option_context_get_help (option_context, TRUE, NULL);
+
+		g_printerr ("%s", help);
+		g_free (help);
+		return EXIT_FAILURE;
+	}
+
+	memset (&ctx, 0, sizeof (ctx));
+	ctx.prefix = prefix;
+	ctx.type_prefix = to_camel_case (prefix);
+	ctx.types = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx.simple_types = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx.elements = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx.messages = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx.loaded_files = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx.type_list = g_ptr_array_new ();
+	ctx.operations = g_ptr_array_new ();
+	ctx.header = g_string_new (NULL);
+	ctx.source = g_string_new (NULL);
+
+	if (!load_wsdl (&ctx, inputs[0]))
+	{
+		g_printerr (_("Cannot read WSDL definitions from '%s'\n"), inputs[0]);
+		return EXIT_FAILURE;
+	}
+
+	resolve (&ctx);
+	emit (&ctx, output);
+
+	path = g_strconcat (output, ".h", NULL);
+	if (!g_file_set_contents (path, ctx.header->str, ctx.header->len, &error))
+		status = EXIT_FAILURE;
+	g_free (path);
+
+	path = g_strconcat (output, ".c", NULL);
+	if (status == EXIT_SUCCESS &&
+	    !g_file_set_contents (path, ctx.source->str, ctx.source->len, &error))
+		status = EXIT_FAILURE;
+	g_free (path);
+
+	if (error)
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+	}
+
+	/* The process exits right away, so the model is left to the OS */
+	g_option_context_free (option_context);
+
+	return status;
+}